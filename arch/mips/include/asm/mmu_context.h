@@ -31,7 +31,7 @@ do {									\
 
 #define TLBMISS_HANDLER_SETUP_PGD(pgd)					\
 do {									\
-	extern void tlbmiss_handler_setup_pgd(unsigned long);		\
+	extern void __uasm_func tlbmiss_handler_setup_pgd(unsigned long); \
 	tlbmiss_handler_setup_pgd((unsigned long)(pgd));		\
 	htw_set_pwbase((unsigned long)pgd);				\
 } while (0)
@@ -82,8 +82,18 @@ extern void build_copy_page(void);
  */
 #define ARCH_PFN_OFFSET		PFN_UP(PHYS_OFFSET)
 
-extern void clear_page(void * page);
-extern void copy_page(void * to, void * from);
+/*
+ * clear_page, copy_page and the TLB handlers are generated at boot. An XIP
+ * kernel keeps them in RAM, out of the reach of a jal from flash.
+ */
+#ifdef CONFIG_XIP_KERNEL
+#define __uasm_func	__attribute__((long_call))
+#else
+#define __uasm_func
+#endif
+
+extern void __uasm_func clear_page(void * page);
+extern void __uasm_func copy_page(void * to, void * from);
 
 extern unsigned long shm_align_mask;
 
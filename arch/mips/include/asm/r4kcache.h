@@ -68,6 +68,8 @@ extern void (*r4k_blast_icache)(void);
 
 #define __inv_dflush_prologue __dflush_prologue
 #define __inv_dflush_epilogue __dflush_epilogue
+#define __wb_dflush_prologue __dflush_prologue
+#define __wb_dflush_epilogue __dflush_epilogue
 #define __sflush_prologue {
 #define __sflush_epilogue }
 #define __inv_sflush_prologue __sflush_prologue
@@ -81,6 +83,8 @@ extern void (*r4k_blast_icache)(void);
 #define __dflush_epilogue }
 #define __inv_dflush_prologue {
 #define __inv_dflush_epilogue }
+#define __wb_dflush_prologue {
+#define __wb_dflush_epilogue }
 #define __sflush_prologue {
 #define __sflush_epilogue }
 #define __inv_sflush_prologue {
@@ -728,6 +732,8 @@ __BUILD_BLAST_CACHE_RANGE(i, icache, Hit_Invalidate_I, , )
 __BUILD_BLAST_CACHE_RANGE(s, scache, Hit_Writeback_Inv_SD, , )
 /* blast_inv_dcache_range */
 __BUILD_BLAST_CACHE_RANGE(inv_d, dcache, Hit_Invalidate_D, , )
+/* blast_wb_dcache_range */
+__BUILD_BLAST_CACHE_RANGE(wb_d, dcache, Hit_Writeback_D, , )
 __BUILD_BLAST_CACHE_RANGE(inv_s, scache, Hit_Invalidate_SD, , )
 
 #endif /* _ASM_R4KCACHE_H */
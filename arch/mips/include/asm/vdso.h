@@ -53,6 +53,15 @@ extern struct mips_vdso_image vdso_image_o32;
 extern struct mips_vdso_image vdso_image_n32;
 #endif
 
+struct resource;
+
+/*
+ * Platforms without a GIC may provide a memory mapped counter for the VDSO.
+ * Its page is mapped read-only in the slot of the GIC user page. Returns 0
+ * and the physical range of the counter register, or a negative error.
+ */
+extern int plat_vdso_get_usm_range(struct resource *range);
+
 /**
  * union mips_vdso_data - Data provided by the kernel for the VDSO.
  * @xtime_sec:		Current real time (seconds part).
@@ -67,6 +76,7 @@ extern struct mips_vdso_image vdso_image_n32;
  * @cs_mask:		Clocksource mask value.
  * @tz_minuteswest:	Minutes west of Greenwich (from timezone).
  * @tz_dsttime:		Type of DST correction (from timezone).
+ * @counter_offset:	Offset of the systick counter in its user page.
  *
  * This structure contains data needed by functions within the VDSO. It is
  * populated by the kernel and mapped read-only into user memory. The time
@@ -89,6 +99,7 @@ union mips_vdso_data {
 		u64 cs_mask;
 		s32 tz_minuteswest;
 		s32 tz_dsttime;
+		u32 counter_offset;
 	};
 
 	u8 page[PAGE_SIZE];
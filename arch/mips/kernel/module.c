@@ -20,6 +20,8 @@
 
 #undef DEBUG
 
+#include <linux/bitmap.h>
+#include <linux/debugfs.h>
 #include <linux/extable.h>
 #include <linux/moduleloader.h>
 #include <linux/elf.h>
@@ -32,7 +34,9 @@
 #include <linux/kernel.h>
 #include <linux/spinlock.h>
 #include <linux/jump_label.h>
+#include <linux/seq_file.h>
 
+#include <asm/debug.h>
 #include <asm/pgtable.h>	/* MODULE_START */
 
 struct mips_hi16 {
@@ -119,6 +123,165 @@ get_plt_size(const Elf_Ehdr *hdr, const Elf_Shdr *sechdrs,
 }
 
 #ifndef MODULE_START
+/*
+ * module_pool=<size> sets physically contiguous memory aside at boot for
+ * the modules, so that they still run from KSEG0 once fragmentation makes
+ * alloc_phys() fail, instead of from vmalloc space with one TLB entry per
+ * 4 KiB page.
+ */
+static unsigned long module_pool_base;
+static unsigned long module_pool_pages;
+static unsigned long *module_pool_map;
+static DEFINE_SPINLOCK(module_pool_lock);
+static unsigned int module_vmalloc_count;
+
+static int __init module_pool_setup(char *s)
+{
+	module_pool_pages = PAGE_ALIGN(memparse(s, NULL)) >> PAGE_SHIFT;
+	return 0;
+}
+early_param("module_pool", module_pool_setup);
+
+static int __init module_pool_init(void)
+{
+	unsigned int order;
+	struct page *page, *p;
+
+	if (!module_pool_pages)
+		return 0;
+
+	order = get_order(module_pool_pages << PAGE_SHIFT);
+	if (order >= MAX_ORDER)
+		goto fail;
+
+	module_pool_map = kcalloc(BITS_TO_LONGS(module_pool_pages),
+				  sizeof(long), GFP_KERNEL);
+	page = alloc_pages(GFP_KERNEL | __GFP_NOWARN, order);
+	if (!module_pool_map || !page) {
+		kfree(module_pool_map);
+		if (page)
+			__free_pages(page, order);
+		goto fail;
+	}
+
+	split_page(page, order);
+	for (p = page + module_pool_pages; p < page + (1 << order); ++p)
+		__free_page(p);
+
+	module_pool_base = (unsigned long)page_address(page);
+	pr_info("module pool: %lu KiB at %08lx\n",
+		module_pool_pages << (PAGE_SHIFT - 10), module_pool_base);
+
+	return 0;
+
+fail:
+	pr_err("module pool: can't allocate %lu KiB\n",
+	       module_pool_pages << (PAGE_SHIFT - 10));
+	module_pool_pages = 0;
+	return -ENOMEM;
+}
+core_initcall(module_pool_init);
+
+static bool in_module_pool(void *ptr)
+{
+	unsigned long addr = (unsigned long)ptr;
+
+	return module_pool_base && addr >= module_pool_base &&
+	       addr < module_pool_base + (module_pool_pages << PAGE_SHIFT);
+}
+
+static void *alloc_pool(unsigned long size)
+{
+	unsigned long nr = PAGE_ALIGN(size) >> PAGE_SHIFT;
+	unsigned long start;
+	struct page *page, *p;
+
+	if (!module_pool_base)
+		return NULL;
+
+	spin_lock(&module_pool_lock);
+	start = bitmap_find_next_zero_area(module_pool_map, module_pool_pages,
+					   0, nr, 0);
+	if (start >= module_pool_pages) {
+		spin_unlock(&module_pool_lock);
+		return NULL;
+	}
+	bitmap_set(module_pool_map, start, nr);
+	spin_unlock(&module_pool_lock);
+
+	/* mark all pages except for the last one, as alloc_phys() does */
+	page = virt_to_page(module_pool_base + (start << PAGE_SHIFT));
+	for (p = page; p + 1 < page + nr; ++p)
+		set_bit(PG_owner_priv_1, &p->flags);
+
+	return page_address(page);
+}
+
+static void free_pool(void *ptr)
+{
+	unsigned long start, nr = 0;
+	struct page *page;
+	bool free;
+
+	page = virt_to_page(ptr);
+	do {
+		free = test_and_clear_bit(PG_owner_priv_1, &page->flags);
+		page++;
+		nr++;
+	} while (free);
+
+	start = ((unsigned long)ptr - module_pool_base) >> PAGE_SHIFT;
+	spin_lock(&module_pool_lock);
+	bitmap_clear(module_pool_map, start, nr);
+	spin_unlock(&module_pool_lock);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int module_pool_show(struct seq_file *m, void *v)
+{
+	unsigned int used;
+
+	spin_lock(&module_pool_lock);
+	used = module_pool_map ? bitmap_weight(module_pool_map,
+					       module_pool_pages) : 0;
+	spin_unlock(&module_pool_lock);
+
+	seq_printf(m, "pool pages: %lu\n", module_pool_pages);
+	seq_printf(m, "pool used:  %u\n", used);
+	seq_printf(m, "vmalloc:    %u\n", READ_ONCE(module_vmalloc_count));
+
+	return 0;
+}
+
+static int module_pool_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, module_pool_show, NULL);
+}
+
+static const struct file_operations module_pool_fops = {
+	.open		= module_pool_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init module_pool_debugfs_init(void)
+{
+	struct dentry *d;
+
+	if (!mips_debugfs_dir)
+		return -ENODEV;
+
+	d = debugfs_create_file("module_pool", S_IRUGO, mips_debugfs_dir,
+				NULL, &module_pool_fops);
+	if (!d)
+		return -ENOMEM;
+
+	return 0;
+}
+late_initcall(module_pool_debugfs_init);
+#endif
+
 static void *alloc_phys(unsigned long size)
 {
 	unsigned order;
@@ -151,6 +314,13 @@ static void free_phys(void *ptr)
 	struct page *page;
 	bool free;
 
+#ifndef MODULE_START
+	if (in_module_pool(ptr)) {
+		free_pool(ptr);
+		return;
+	}
+#endif
+
 	page = virt_to_page(ptr);
 	do {
 		free = test_and_clear_bit(PG_owner_priv_1, &page->flags);
@@ -172,13 +342,17 @@ void *module_alloc(unsigned long size)
 	if (size == 0)
 		return NULL;
 
-	ptr = alloc_phys(size);
+	ptr = alloc_pool(size);
+	if (!ptr)
+		ptr = alloc_phys(size);
 
 	/* If we failed to allocate physically contiguous memory,
 	 * fall back to regular vmalloc. The module loader code will
 	 * create jump tables to handle long jumps */
-	if (!ptr)
+	if (!ptr) {
+		module_vmalloc_count++;
 		return vmalloc(size);
+	}
 
 	return ptr;
 #endif
@@ -15,15 +15,144 @@
  */
 
 #include <linux/perf_event.h>
+#include <linux/uaccess.h>
 
+#include <asm/inst.h>
 #include <asm/stacktrace.h>
 
 /* Callchain handling code. */
 
+/* How far back to look for the start of a user function */
+#define USER_UNWIND_MAX_INSNS	1024
+
+static bool user_insn_is_return(union mips_instruction ip)
+{
+	return ip.r_format.opcode == spec_op && ip.r_format.rs == 31 &&
+	       (ip.r_format.func == jr_op ||
+		(ip.r_format.func == jalr_op && ip.r_format.rd == 0));
+}
+
+static bool user_insn_is_sp_move(union mips_instruction ip)
+{
+	return (ip.i_format.opcode == addiu_op ||
+		ip.i_format.opcode == daddiu_op) &&
+	       ip.i_format.rs == 29 && ip.i_format.rt == 29;
+}
+
+static bool user_insn_is_ra_save(union mips_instruction ip)
+{
+	return (ip.i_format.opcode == sw_op || ip.i_format.opcode == sd_op) &&
+	       ip.i_format.rs == 29 && ip.i_format.rt == 31;
+}
+
 /*
- * Leave userspace callchain empty for now. When we find a way to trace
- * the user stack callchains, we will add it here.
+ * pc and sp are user controlled, never let them read kernel or MMIO
+ * space. This doesn't rely on access_ok(), the sample may have hit a
+ * set_fs(KERNEL_DS) section.
  */
+static bool user_unwind_ok(const void __user *p, unsigned long size)
+{
+	unsigned long addr = (unsigned long)p;
+
+	return addr < TASK_SIZE && size <= TASK_SIZE - addr;
+}
+
+/*
+ * User code has neither frame pointers nor symbols we could use here, so
+ * do what unwind_stack() does for the kernel, walking back from pc to the
+ * stack adjustment that opens the function. Returns the frame size, 0 for
+ * a function without a frame, or -1 if the prologue can't be found. *ra_off
+ * is where ra was saved, or -1 if pc is before the save, *ra_64 whether it
+ * was saved with sd.
+ */
+static int user_unwind_frame(unsigned long pc, int *ra_off, bool *ra_64)
+{
+	union mips_instruction ip;
+	int i;
+
+	*ra_off = -1;
+	for (i = 1; i <= USER_UNWIND_MAX_INSNS; i++) {
+		void __user *p = (void __user *)(pc - 4 * i);
+
+		if (!user_unwind_ok(p, sizeof(ip)) ||
+		    __copy_from_user_inatomic(&ip, p, sizeof(ip)))
+			return -1;
+
+		/* the end of the previous function */
+		if (user_insn_is_return(ip))
+			return 0;
+
+		if (user_insn_is_sp_move(ip)) {
+			/* an epilogue on another return path */
+			if (ip.i_format.simmediate > 0)
+				continue;
+			return -ip.i_format.simmediate;
+		}
+
+		if (user_insn_is_ra_save(ip)) {
+			*ra_off = ip.i_format.simmediate;
+			*ra_64 = ip.i_format.opcode == sd_op;
+		}
+	}
+
+	return -1;
+}
+
+void perf_callchain_user(struct perf_callchain_entry_ctx *entry,
+			 struct pt_regs *regs)
+{
+	unsigned long pc = regs->cp0_epc;
+	unsigned long sp = regs->regs[29];
+	unsigned long ra = regs->regs[31];
+	unsigned long caller;
+	int frame, ra_off;
+	bool top = true, ra_64;
+	u32 caller32;
+	void __user *p;
+
+	perf_callchain_store(entry, pc);
+
+	if (!current->mm)
+		return;
+
+	pagefault_disable();
+	while (entry->nr < entry->max_stack) {
+		/* MIPS16 and microMIPS code is not decoded */
+		if (pc & 3)
+			break;
+
+		frame = user_unwind_frame(pc, &ra_off, &ra_64);
+		if (frame < 0)
+			break;
+
+		p = (void __user *)(sp + ra_off);
+		if (ra_off >= 0 && ra_64) {
+			if (!user_unwind_ok(p, sizeof(caller)) ||
+			    __get_user(caller, (unsigned long __user *)p))
+				break;
+		} else if (ra_off >= 0) {
+			if (!user_unwind_ok(p, sizeof(caller32)) ||
+			    __get_user(caller32, (u32 __user *)p))
+				break;
+			caller = caller32;
+		} else if (top) {
+			/* a leaf, or before the save: ra is still live */
+			caller = ra;
+		} else {
+			break;
+		}
+
+		if (!caller || caller == pc || caller >= TASK_SIZE)
+			break;
+
+		perf_callchain_store(entry, caller);
+		pc = caller;
+		sp += frame;
+		top = false;
+	}
+	pagefault_enable();
+}
+
 
 static void save_raw_perf_callchain(struct perf_callchain_entry_ctx *entry,
 				    unsigned long reg29)
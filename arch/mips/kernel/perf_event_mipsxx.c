@@ -814,6 +814,21 @@ static const struct mips_perf_event mipsxxcore_event_map
 	[PERF_COUNT_HW_BRANCH_MISSES] = { 0x02, CNTR_ODD, T },
 };
 
+/*
+ * 24K: the common events plus D-cache accesses and misses, and the cycles
+ * the pipeline stalls on I-cache and D-cache misses.
+ */
+static const struct mips_perf_event mips24k_event_map[PERF_COUNT_HW_MAX] = {
+	[PERF_COUNT_HW_CPU_CYCLES] = { 0x00, CNTR_EVEN | CNTR_ODD, P },
+	[PERF_COUNT_HW_INSTRUCTIONS] = { 0x01, CNTR_EVEN | CNTR_ODD, T },
+	[PERF_COUNT_HW_CACHE_REFERENCES] = { 0x0a, CNTR_EVEN, T },
+	[PERF_COUNT_HW_CACHE_MISSES] = { 0x0b, CNTR_EVEN | CNTR_ODD, T },
+	[PERF_COUNT_HW_BRANCH_INSTRUCTIONS] = { 0x02, CNTR_EVEN, T },
+	[PERF_COUNT_HW_BRANCH_MISSES] = { 0x02, CNTR_ODD, T },
+	[PERF_COUNT_HW_STALLED_CYCLES_FRONTEND] = { 0x25, CNTR_EVEN, T },
+	[PERF_COUNT_HW_STALLED_CYCLES_BACKEND] = { 0x25, CNTR_ODD, T },
+};
+
 /* 74K/proAptiv core has different branch event code. */
 static const struct mips_perf_event mipsxxcore_event_map2
 				[PERF_COUNT_HW_MAX] = {
@@ -947,6 +962,72 @@ static const struct mips_perf_event mipsxxcore_cache_map
 },
 };
 
+/*
+ * 24K: as above, but the TLB events are the JTLB ones. A micro-TLB miss
+ * that hits the JTLB only costs a cycle or two, a JTLB miss takes the
+ * refill exception.
+ */
+static const struct mips_perf_event mips24k_cache_map
+				[PERF_COUNT_HW_CACHE_MAX]
+				[PERF_COUNT_HW_CACHE_OP_MAX]
+				[PERF_COUNT_HW_CACHE_RESULT_MAX] = {
+[C(L1D)] = {
+	/* reads and writes are counted together, see above */
+	[C(OP_READ)] = {
+		[C(RESULT_ACCESS)]	= { 0x0a, CNTR_EVEN, T },
+		[C(RESULT_MISS)]	= { 0x0b, CNTR_EVEN | CNTR_ODD, T },
+	},
+	[C(OP_WRITE)] = {
+		[C(RESULT_ACCESS)]	= { 0x0a, CNTR_EVEN, T },
+		[C(RESULT_MISS)]	= { 0x0b, CNTR_EVEN | CNTR_ODD, T },
+	},
+},
+[C(L1I)] = {
+	[C(OP_READ)] = {
+		[C(RESULT_ACCESS)]	= { 0x09, CNTR_EVEN, T },
+		[C(RESULT_MISS)]	= { 0x09, CNTR_ODD, T },
+	},
+	[C(OP_WRITE)] = {
+		[C(RESULT_ACCESS)]	= { 0x09, CNTR_EVEN, T },
+		[C(RESULT_MISS)]	= { 0x09, CNTR_ODD, T },
+	},
+	[C(OP_PREFETCH)] = {
+		[C(RESULT_ACCESS)]	= { 0x14, CNTR_EVEN, T },
+	},
+},
+[C(DTLB)] = {
+	[C(OP_READ)] = {
+		[C(RESULT_ACCESS)]	= { 0x08, CNTR_EVEN, T },
+		[C(RESULT_MISS)]	= { 0x08, CNTR_ODD, T },
+	},
+	[C(OP_WRITE)] = {
+		[C(RESULT_ACCESS)]	= { 0x08, CNTR_EVEN, T },
+		[C(RESULT_MISS)]	= { 0x08, CNTR_ODD, T },
+	},
+},
+[C(ITLB)] = {
+	[C(OP_READ)] = {
+		[C(RESULT_ACCESS)]	= { 0x07, CNTR_EVEN, T },
+		[C(RESULT_MISS)]	= { 0x07, CNTR_ODD, T },
+	},
+	[C(OP_WRITE)] = {
+		[C(RESULT_ACCESS)]	= { 0x07, CNTR_EVEN, T },
+		[C(RESULT_MISS)]	= { 0x07, CNTR_ODD, T },
+	},
+},
+[C(BPU)] = {
+	/* Using the same code for *HW_BRANCH* */
+	[C(OP_READ)] = {
+		[C(RESULT_ACCESS)]	= { 0x02, CNTR_EVEN, T },
+		[C(RESULT_MISS)]	= { 0x02, CNTR_ODD, T },
+	},
+	[C(OP_WRITE)] = {
+		[C(RESULT_ACCESS)]	= { 0x02, CNTR_EVEN, T },
+		[C(RESULT_MISS)]	= { 0x02, CNTR_ODD, T },
+	},
+},
+};
+
 /* 74K/proAptiv core has completely different cache event map. */
 static const struct mips_perf_event mipsxxcore_cache_map2
 				[PERF_COUNT_HW_CACHE_MAX]
@@ -1744,8 +1825,8 @@ init_hw_perf_events(void)
 	switch (current_cpu_type()) {
 	case CPU_24K:
 		mipspmu.name = "mips/24K";
-		mipspmu.general_event_map = &mipsxxcore_event_map;
-		mipspmu.cache_event_map = &mipsxxcore_cache_map;
+		mipspmu.general_event_map = &mips24k_event_map;
+		mipspmu.cache_event_map = &mips24k_cache_map;
 		break;
 	case CPU_34K:
 		mipspmu.name = "mips/34K";
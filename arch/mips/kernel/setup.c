@@ -80,6 +80,13 @@ EXPORT_SYMBOL(mips_io_port_base);
 static struct resource code_resource = { .name = "Kernel code", };
 static struct resource data_resource = { .name = "Kernel data", };
 
+#ifdef CONFIG_XIP_KERNEL
+/* The text and read-only data stay in flash, only the data is in RAM */
+#define __kernel_ram_start	_sdata
+#else
+#define __kernel_ram_start	_text
+#endif
+
 static void *detect_magic __initdata = detect_memory_region;
 
 void __init add_memory_region(phys_addr_t start, phys_addr_t size, long type)
@@ -781,7 +788,7 @@ static void __init arch_mem_init(char **cmdline_p)
 	 * into another memory section you don't want that to be
 	 * freed when the initdata is freed.
 	 */
-	arch_mem_addpart(PFN_DOWN(__pa_symbol(&_text)) << PAGE_SHIFT,
+	arch_mem_addpart(PFN_DOWN(__pa_symbol(&__kernel_ram_start)) << PAGE_SHIFT,
 			 PFN_UP(__pa_symbol(&_edata)) << PAGE_SHIFT,
 			 BOOT_MEM_RAM);
 	arch_mem_addpart(PFN_UP(__pa_symbol(&__init_begin)) << PAGE_SHIFT,
@@ -868,7 +875,12 @@ static void __init resource_init(void)
 
 	code_resource.start = __pa_symbol(&_text);
 	code_resource.end = __pa_symbol(&_etext) - 1;
+#ifdef CONFIG_XIP_KERNEL
+	/* the code is not in any of the RAM regions and won't be requested */
+	data_resource.start = __pa_symbol(&_sdata);
+#else
 	data_resource.start = __pa_symbol(&_etext);
+#endif
 	data_resource.end = __pa_symbol(&_edata) - 1;
 
 	for (i = 0; i < boot_mem_map.nr_map; i++) {
@@ -36,6 +36,11 @@ static struct vm_special_mapping vdso_vvar_mapping = {
 	.pages = no_pages,
 };
 
+int __weak plat_vdso_get_usm_range(struct resource *range)
+{
+	return -ENODEV;
+}
+
 static void __init init_vdso_image(struct mips_vdso_image *image)
 {
 	unsigned long num_pages, i;
@@ -53,8 +58,13 @@ static void __init init_vdso_image(struct mips_vdso_image *image)
 
 static int __init init_vdso(void)
 {
+	struct resource res;
+
 	init_vdso_image(&vdso_image);
 
+	if (!plat_vdso_get_usm_range(&res))
+		vdso_data.counter_offset = res.start & ~PAGE_MASK;
+
 #ifdef CONFIG_MIPS32_O32
 	init_vdso_image(&vdso_image_o32);
 #endif
@@ -101,7 +111,8 @@ int arch_setup_additional_pages(struct linux_binprm *bprm, int uses_interp)
 	struct mm_struct *mm = current->mm;
 	unsigned long gic_size, vvar_size, size, base, data_addr, vdso_addr;
 	struct vm_area_struct *vma;
-	struct resource gic_res;
+	struct resource gic_res, plat_res;
+	bool plat_counter = false;
 	int ret;
 
 	if (down_write_killable(&mm->mmap_sem))
@@ -126,6 +137,16 @@ int arch_setup_additional_pages(struct linux_binprm *bprm, int uses_interp)
 	 * the counter registers at the start.
 	 */
 	gic_size = gic_present ? PAGE_SIZE : 0;
+
+	/*
+	 * Without a GIC, a platform counter page may use the same slot in
+	 * front of the data page.
+	 */
+	if (!gic_size && !plat_vdso_get_usm_range(&plat_res)) {
+		plat_counter = true;
+		gic_size = PAGE_SIZE;
+	}
+
 	vvar_size = gic_size + PAGE_SIZE;
 	size = vvar_size + image->size;
 
@@ -147,7 +168,7 @@ int arch_setup_additional_pages(struct linux_binprm *bprm, int uses_interp)
 	}
 
 	/* Map GIC user page. */
-	if (gic_size) {
+	if (gic_size && !plat_counter) {
 		ret = gic_get_usm_range(&gic_res);
 		if (ret)
 			goto out;
@@ -160,6 +181,16 @@ int arch_setup_additional_pages(struct linux_binprm *bprm, int uses_interp)
 			goto out;
 	}
 
+	/* Map platform counter page. */
+	if (plat_counter) {
+		ret = io_remap_pfn_range(vma, base,
+					 plat_res.start >> PAGE_SHIFT,
+					 PAGE_SIZE,
+					 pgprot_noncached(PAGE_READONLY));
+		if (ret)
+			goto out;
+	}
+
 	/* Map data page. */
 	ret = remap_pfn_range(vma, data_addr,
 			      virt_to_phys(&vdso_data) >> PAGE_SHIFT,
@@ -0,0 +1,222 @@
+/*
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License.  See the file "COPYING" in the main directory of this archive
+ * for more details.
+ *
+ * Boot time selection of memcpy and memset.
+ *
+ * The variants in copy_pref.S are checked against memcpy.S/memset.S, then
+ * all of them are timed on a mix of packet sized and larger than D-cache
+ * copies. memcpy and memset are patched to jump to the fastest variant,
+ * which is shown in /proc/cpuinfo.
+ */
+#include <linux/gfp.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/notifier.h>
+#include <linux/random.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include <asm/cpu-features.h>
+#include <asm/cpu-info.h>
+#include <asm/mipsregs.h>
+
+#include "redirect.h"
+
+void *memcpy_pfs(void *dst, const void *src, size_t len);
+void *memcpy_pref64(void *dst, const void *src, size_t len);
+void *memcpy_pref128(void *dst, const void *src, size_t len);
+void *memcpy_pref256(void *dst, const void *src, size_t len);
+void *memset_pfs(void *s, int c, size_t len);
+
+struct copy_variant {
+	const char *name;
+	void *func;
+	u64 cycles;
+};
+
+static struct copy_variant memcpy_variants[] = {
+	{ "generic", memcpy },
+	{ "pfs", memcpy_pfs },
+	{ "pref64", memcpy_pref64 },
+	{ "pref128", memcpy_pref128 },
+	{ "pref256", memcpy_pref256 },
+};
+
+static struct copy_variant memset_variants[] = {
+	{ "generic", memset },
+	{ "pfs", memset_pfs },
+};
+
+static struct copy_variant *memcpy_selected = &memcpy_variants[0];
+static struct copy_variant *memset_selected = &memset_variants[0];
+
+/* Larger than the D-cache, so that the big copies miss */
+#define COPY_BUF_ORDER	4
+#define COPY_BUF_SIZE	(PAGE_SIZE << COPY_BUF_ORDER)
+
+/* The benchmark mix, len and number of runs */
+static const struct {
+	unsigned int len;
+	unsigned int runs;
+} copy_mix[] = {
+	{ 64, 64 },
+	{ 256, 64 },
+	{ 1514, 32 },
+	{ 16384, 8 },
+};
+
+typedef void *(*memcpy_fn)(void *, const void *, size_t);
+typedef void *(*memset_fn)(void *, int, size_t);
+
+static bool __init copy_check(struct copy_variant *v, bool set, u8 *src,
+			      u8 *dst, u8 *ref)
+{
+	unsigned int len, sa, da;
+
+	for (len = 0; len < 700; len += len < 160 ? 1 : 97) {
+		for (sa = 0; sa < 4; sa++) {
+			for (da = 0; da < 4; da++) {
+				memset(ref, 0x5a, len + 8);
+				memset(dst, 0x5a, len + 8);
+				if (set) {
+					memset(ref + da, src[sa], len);
+					if (((memset_fn)v->func)(dst + da, src[sa],
+								 len) != dst + da)
+						return false;
+				} else {
+					memcpy(ref + da, src + sa, len);
+					if (((memcpy_fn)v->func)(dst + da, src + sa,
+								 len) != dst + da)
+						return false;
+				}
+				if (memcmp(ref, dst, len + 8))
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static u64 __init copy_time(struct copy_variant *v, bool set, u8 *src,
+			    u8 *dst)
+{
+	unsigned int i, j, off, sa, len, start;
+	u64 cycles = 0;
+
+	for (i = 0; i < ARRAY_SIZE(copy_mix); i++) {
+		/* both the word aligned and the lwl/lwr path count */
+		for (sa = 0; sa <= 2; sa += 2) {
+			len = copy_mix[i].len - sa;
+			off = 0;
+			start = read_c0_count();
+			for (j = 0; j < copy_mix[i].runs; j++) {
+				/* walk the buffers, big copies mostly miss */
+				if (off + copy_mix[i].len > COPY_BUF_SIZE)
+					off = 0;
+				if (set)
+					((memset_fn)v->func)(dst + off + sa, 0,
+							     len);
+				else
+					((memcpy_fn)v->func)(dst + off,
+							     src + off + sa,
+							     len);
+				off += copy_mix[i].len + 64;
+			}
+			cycles += read_c0_count() - start;
+		}
+	}
+
+	return cycles;
+}
+
+static struct copy_variant * __init copy_calibrate(struct copy_variant *v,
+						   int n, bool set, u8 *src,
+						   u8 *dst, u8 *ref)
+{
+	struct copy_variant *best = v;
+	unsigned long flags;
+	int i;
+
+	local_irq_save(flags);
+	for (i = 0; i < n; i++) {
+		if (i && !copy_check(&v[i], set, src, dst, ref)) {
+			pr_err("%s: %s variant is broken\n",
+			       set ? "memset" : "memcpy", v[i].name);
+			continue;
+		}
+		v[i].cycles = copy_time(&v[i], set, src, dst);
+		if (v[i].cycles < best->cycles)
+			best = &v[i];
+	}
+	local_irq_restore(flags);
+
+	return best;
+}
+
+static int copy_cpuinfo(struct notifier_block *nb, unsigned long action,
+			void *data)
+{
+	struct proc_cpuinfo_notifier_args *pcn = data;
+
+	seq_printf(pcn->m, "memcpy\t\t\t: %s\n", memcpy_selected->name);
+	seq_printf(pcn->m, "memset\t\t\t: %s\n", memset_selected->name);
+
+	return NOTIFY_OK;
+}
+
+static int __init copy_select(void)
+{
+	unsigned long src, dst;
+	u8 *ref;
+
+	proc_cpuinfo_notifier(copy_cpuinfo, 0);
+
+	/*
+	 * The variants assume 32 byte lines and use PrepareForStore. An XIP
+	 * kernel can't patch memcpy and memset, they are in flash.
+	 */
+	if (IS_ENABLED(CONFIG_CPU_MICROMIPS) || IS_ENABLED(CONFIG_XIP_KERNEL) ||
+	    !cpu_has_prefetch || cpu_dcache_line_size() != 32)
+		return 0;
+
+	src = __get_free_pages(GFP_KERNEL, COPY_BUF_ORDER);
+	dst = __get_free_pages(GFP_KERNEL, COPY_BUF_ORDER);
+	ref = kmalloc(1024, GFP_KERNEL);
+	if (!src || !dst || !ref)
+		goto out;
+
+	prandom_bytes((void *)src, COPY_BUF_SIZE);
+
+	memcpy_selected = copy_calibrate(memcpy_variants,
+					 ARRAY_SIZE(memcpy_variants), false,
+					 (u8 *)src, (u8 *)dst, ref);
+	memset_selected = copy_calibrate(memset_variants,
+					 ARRAY_SIZE(memset_variants), true,
+					 (u8 *)src, (u8 *)dst, ref);
+
+	/*
+	 * The delay slots set the return value or the inatomic flag.
+	 * __copy_user, memmove and __bzero enter past the patched first
+	 * instruction, so they keep the generic code and its fixups.
+	 */
+	if (memcpy_selected != &memcpy_variants[0])
+		lib_redirect(memcpy, memcpy_selected->func);
+	if (memset_selected != &memset_variants[0])
+		lib_redirect(memset, memset_selected->func);
+
+	pr_info("memcpy: %s (%llu vs %llu ticks), memset: %s (%llu vs %llu ticks)\n",
+		memcpy_selected->name, memcpy_selected->cycles,
+		memcpy_variants[0].cycles, memset_selected->name,
+		memset_selected->cycles, memset_variants[0].cycles);
+
+out:
+	kfree(ref);
+	free_pages(dst, COPY_BUF_ORDER);
+	free_pages(src, COPY_BUF_ORDER);
+	return 0;
+}
+arch_initcall(copy_select);
@@ -0,0 +1,254 @@
+/*
+ * This file is subject to the terms and conditions of the GNU General Public
+ * License.  See the file "COPYING" in the main directory of this archive
+ * for more details.
+ *
+ * Boot time selection of the IP checksum routines.
+ *
+ * On cores with the DSP ASE the variants in csum_partial_dsp.S are checked
+ * against the generic code, benchmarked, and then csum_partial and
+ * csum_partial_copy_nocheck are patched to jump to them. The measurements
+ * are kept for debugfs (mips/csum).
+ */
+#include <linux/debugfs.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/random.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include <asm/checksum.h>
+#include <asm/cpu-features.h>
+#include <asm/debug.h>
+#include <asm/mipsregs.h>
+
+#include "redirect.h"
+
+__wsum csum_partial_dsp(const void *buff, int len, __wsum sum);
+__wsum csum_partial_copy_nocheck_dsp(const void *src, void *dst, int len,
+				     __wsum sum);
+
+#define CSUM_TEST_LEN	1600
+#define CSUM_BENCH_RUNS	32
+
+static const unsigned int csum_bench_size[] = { 64, 256, 576, 1500 };
+static const unsigned int csum_bench_align[] = { 0, 1, 2 };
+
+/* cycles per byte, in hundredths */
+struct csum_bench {
+	unsigned int csum[2];
+	unsigned int copy[2];
+};
+
+static struct csum_bench
+csum_bench[ARRAY_SIZE(csum_bench_size)][ARRAY_SIZE(csum_bench_align)];
+static const char *csum_impl = "generic";
+static bool csum_nodsp;
+
+static int __init csum_nodsp_setup(char *s)
+{
+	csum_nodsp = true;
+	return 1;
+}
+__setup("nodspcsum", csum_nodsp_setup);
+
+/* Cycles per count register increment */
+static unsigned int csum_ccres(void)
+{
+	unsigned int res;
+
+	__asm__ __volatile__(
+	"	.set	push			\n"
+	"	.set	mips32r2		\n"
+	"	rdhwr	%0, $3			\n"
+	"	.set	pop			\n"
+	: "=r" (res));
+
+	return res ? res : 1;
+}
+
+static int __init csum_dsp_check(u8 *buf)
+{
+	u8 *src = buf, *dst = buf + CSUM_TEST_LEN + 8;
+	u8 *ref = dst + CSUM_TEST_LEN + 8;
+	unsigned int sa, da = 0, len;
+	__wsum sum, a, b;
+
+	prandom_bytes(src, CSUM_TEST_LEN + 8);
+
+	for (len = 0; len <= CSUM_TEST_LEN; len += len < 80 ? 1 : 61) {
+		for (sa = 0; sa < 4; sa++) {
+			sum = (__force __wsum)prandom_u32();
+			a = csum_partial(src + sa, len, sum);
+			b = csum_partial_dsp(src + sa, len, sum);
+			if (csum_fold(a) != csum_fold(b))
+				goto fail;
+
+			for (da = 0; da < 4; da++) {
+				a = csum_partial_copy_nocheck(src + sa, ref + da,
+							      len, sum);
+				b = csum_partial_copy_nocheck_dsp(src + sa,
+								  dst + da,
+								  len, sum);
+				if (csum_fold(a) != csum_fold(b) ||
+				    memcmp(ref + da, dst + da, len))
+					goto fail;
+			}
+		}
+	}
+
+	return 0;
+
+fail:
+	pr_err("csum: DSP ASE checksum mismatch, len %u src %u dst %u\n",
+	       len, sa, da);
+	return -EINVAL;
+}
+
+static unsigned int __init csum_cycles(u8 *buf, unsigned int len,
+				       unsigned int align, bool dsp, bool copy)
+{
+	unsigned int start = 0, i;
+	u8 *dst = buf + CSUM_TEST_LEN + 8;
+	u64 cycles;
+
+	for (i = 0; i <= CSUM_BENCH_RUNS; i++) {
+		/* the first run only warms the caches */
+		if (i == 1)
+			start = read_c0_count();
+
+		if (copy && dsp)
+			csum_partial_copy_nocheck_dsp(buf + align, dst, len, 0);
+		else if (copy)
+			csum_partial_copy_nocheck(buf + align, dst, len, 0);
+		else if (dsp)
+			csum_partial_dsp(buf + align, len, 0);
+		else
+			csum_partial(buf + align, len, 0);
+	}
+
+	cycles = (u64)(read_c0_count() - start) * csum_ccres() * 100;
+	do_div(cycles, CSUM_BENCH_RUNS * len);
+
+	return cycles;
+}
+
+static void __init csum_dsp_bench(u8 *buf)
+{
+	unsigned long flags;
+	struct csum_bench *b;
+	int s, a, dsp;
+
+	local_irq_save(flags);
+	for (s = 0; s < ARRAY_SIZE(csum_bench_size); s++) {
+		for (a = 0; a < ARRAY_SIZE(csum_bench_align); a++) {
+			b = &csum_bench[s][a];
+			for (dsp = 0; dsp < 2; dsp++) {
+				b->csum[dsp] = csum_cycles(buf,
+							   csum_bench_size[s],
+							   csum_bench_align[a],
+							   dsp, false);
+				b->copy[dsp] = csum_cycles(buf,
+							   csum_bench_size[s],
+							   csum_bench_align[a],
+							   dsp, true);
+			}
+		}
+	}
+	local_irq_restore(flags);
+}
+
+static int __init csum_select(void)
+{
+	struct csum_bench *b;
+	u8 *buf;
+
+	/* an XIP kernel can't patch the checksum routines in flash */
+	if (!cpu_has_dsp || csum_nodsp || IS_ENABLED(CONFIG_CPU_MICROMIPS) ||
+	    IS_ENABLED(CONFIG_XIP_KERNEL))
+		return 0;
+
+	buf = kmalloc(3 * (CSUM_TEST_LEN + 8), GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	if (csum_dsp_check(buf)) {
+		kfree(buf);
+		return 0;
+	}
+	csum_dsp_bench(buf);
+	kfree(buf);
+
+	/*
+	 * The delay slots only clear the odd flags, which are set again.
+	 * The user copies branch around the csum_partial_copy_nocheck entry
+	 * and keep the generic code with its exception fixups.
+	 */
+	lib_redirect(csum_partial, csum_partial_dsp);
+	lib_redirect(csum_partial_copy_nocheck, csum_partial_copy_nocheck_dsp);
+	csum_impl = "dsp";
+
+	b = &csum_bench[ARRAY_SIZE(csum_bench_size) - 1][0];
+	pr_info("csum: using DSP ASE, 1500 bytes %u.%02u -> %u.%02u cycles/byte\n",
+		b->csum[0] / 100, b->csum[0] % 100,
+		b->csum[1] / 100, b->csum[1] % 100);
+
+	return 0;
+}
+arch_initcall(csum_select);
+
+#ifdef CONFIG_DEBUG_FS
+static int csum_show(struct seq_file *m, void *v)
+{
+	struct csum_bench *b;
+	int s, a;
+
+	seq_printf(m, "implementation: %s\n", csum_impl);
+	if (strcmp(csum_impl, "dsp"))
+		return 0;
+
+	seq_puts(m, "cycles/byte  size align  csum generic/dsp  copy generic/dsp\n");
+	for (s = 0; s < ARRAY_SIZE(csum_bench_size); s++) {
+		for (a = 0; a < ARRAY_SIZE(csum_bench_align); a++) {
+			b = &csum_bench[s][a];
+			seq_printf(m, "%17u %5u %6u.%02u %4u.%02u %7u.%02u %4u.%02u\n",
+				   csum_bench_size[s], csum_bench_align[a],
+				   b->csum[0] / 100, b->csum[0] % 100,
+				   b->csum[1] / 100, b->csum[1] % 100,
+				   b->copy[0] / 100, b->copy[0] % 100,
+				   b->copy[1] / 100, b->copy[1] % 100);
+		}
+	}
+
+	return 0;
+}
+
+static int csum_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, csum_show, NULL);
+}
+
+static const struct file_operations csum_fops = {
+	.open		= csum_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init csum_debugfs_init(void)
+{
+	struct dentry *d;
+
+	if (!mips_debugfs_dir)
+		return -ENODEV;
+
+	d = debugfs_create_file("csum", S_IRUGO, mips_debugfs_dir, NULL,
+				&csum_fops);
+	if (!d)
+		return -ENOMEM;
+
+	return 0;
+}
+device_initcall(csum_debugfs_init);
+#endif
@@ -0,0 +1,21 @@
+#ifndef __MIPS_LIB_REDIRECT_H
+#define __MIPS_LIB_REDIRECT_H
+
+#include <asm/cacheflush.h>
+#include <asm/uasm.h>
+
+/*
+ * Point an assembler library routine at a tuned variant picked at boot by
+ * overwriting its first instruction with "j target". The routine's second
+ * instruction ends up in the delay slot, so it must be harmless to the
+ * variant (the callers check this for each routine they patch).
+ */
+static inline void __init lib_redirect(void *func, void *target)
+{
+	u32 *p = func;
+
+	uasm_i_j(&p, (unsigned long)target);
+	flush_icache_range((unsigned long)func, (unsigned long)p);
+}
+
+#endif /* __MIPS_LIB_REDIRECT_H */
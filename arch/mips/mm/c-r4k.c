@@ -8,13 +8,17 @@
  * Copyright (C) 1999, 2000 Silicon Graphics, Inc.
  */
 #include <linux/cpu_pm.h>
+#include <linux/debugfs.h>
 #include <linux/hardirq.h>
 #include <linux/init.h>
 #include <linux/highmem.h>
 #include <linux/kernel.h>
 #include <linux/linkage.h>
+#include <linux/mutex.h>
 #include <linux/preempt.h>
 #include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
 #include <linux/smp.h>
 #include <linux/mm.h>
 #include <linux/export.h>
@@ -27,6 +31,7 @@
 #include <asm/cpu.h>
 #include <asm/cpu-features.h>
 #include <asm/cpu-type.h>
+#include <asm/debug.h>
 #include <asm/io.h>
 #include <asm/page.h>
 #include <asm/pgtable.h>
@@ -832,6 +837,43 @@ static void r4k_flush_icache_user_range(unsigned long start, unsigned long end)
 
 #if defined(CONFIG_DMA_NONCOHERENT) || defined(CONFIG_DMA_MAYBE_COHERENT)
 
+/*
+ * Above a certain buffer size walking it with hit ops costs more than an
+ * index writeback invalidate of the whole D-cache (a "blast"). The sizes
+ * are kept per operation, start out as the D-cache size and are measured
+ * at boot by r4k_dma_cache_calibrate(). Without inclusive primary caches
+ * that is the only path here, and the bytes maintained are counted by
+ * operation for debugfs (mips/dma_cache).
+ */
+enum {
+	DMA_CACHE_WBACK,
+	DMA_CACHE_WBACK_INV,
+	DMA_CACHE_INV,
+	DMA_CACHE_BLAST,
+	DMA_CACHE_NR_OPS
+};
+
+static const char * const dma_cache_op_names[DMA_CACHE_NR_OPS] = {
+	"wback", "wback_inv", "inv", "blast"
+};
+
+static unsigned long dma_cache_blast_size[DMA_CACHE_BLAST] __read_mostly;
+
+struct dma_cache_stats {
+	u64 bytes[DMA_CACHE_NR_OPS];
+};
+
+static DEFINE_PER_CPU(struct dma_cache_stats, dma_cache_stats);
+
+static inline bool r4k_dma_cache_blast(int op, unsigned long size)
+{
+	if (size >= dma_cache_blast_size[op])
+		op = DMA_CACHE_BLAST;
+	this_cpu_add(dma_cache_stats.bytes[op], size);
+
+	return op == DMA_CACHE_BLAST;
+}
+
 static void r4k_dma_cache_wback_inv(unsigned long addr, unsigned long size)
 {
 	/* Catch bad driver code */
@@ -853,7 +895,7 @@ static void r4k_dma_cache_wback_inv(unsigned long addr, unsigned long size)
 	 * subset property so we have to flush the primary caches
 	 * explicitly
 	 */
-	if (size >= dcache_size) {
+	if (r4k_dma_cache_blast(DMA_CACHE_WBACK_INV, size)) {
 		r4k_blast_dcache();
 	} else {
 		R4600_HIT_CACHEOP_WAR_IMPL;
@@ -865,6 +907,29 @@ static void r4k_dma_cache_wback_inv(unsigned long addr, unsigned long size)
 	__sync();
 }
 
+/*
+ * Only used without inclusive primary caches, on cores implementing the
+ * MIPS32/64 Hit_Writeback_D. The lines stay valid, a buffer the CPU keeps
+ * using after handing it to the device (packet headers) does not miss.
+ */
+static void r4k_dma_cache_wback(unsigned long addr, unsigned long size)
+{
+	/* Catch bad driver code */
+	BUG_ON(size == 0);
+
+	preempt_disable();
+	if (r4k_dma_cache_blast(DMA_CACHE_WBACK, size)) {
+		r4k_blast_dcache();
+	} else {
+		R4600_HIT_CACHEOP_WAR_IMPL;
+		blast_wb_dcache_range(addr, addr + size);
+	}
+	preempt_enable();
+
+	bc_wback_inv(addr, size);
+	__sync();
+}
+
 static void r4k_dma_cache_inv(unsigned long addr, unsigned long size)
 {
 	/* Catch bad driver code */
@@ -890,7 +955,7 @@ static void r4k_dma_cache_inv(unsigned long addr, unsigned long size)
 		return;
 	}
 
-	if (size >= dcache_size) {
+	if (r4k_dma_cache_blast(DMA_CACHE_INV, size)) {
 		r4k_blast_dcache();
 	} else {
 		R4600_HIT_CACHEOP_WAR_IMPL;
@@ -901,6 +966,167 @@ static void r4k_dma_cache_inv(unsigned long addr, unsigned long size)
 	bc_inv(addr, size);
 	__sync();
 }
+
+static unsigned int __init r4k_dma_cache_time(int op, unsigned long buf,
+					      unsigned long size)
+{
+	unsigned int start;
+
+	/* the buffers handed to the device are usually hot and dirty */
+	if (op != DMA_CACHE_INV)
+		memset((void *)buf, op, size);
+
+	start = read_c0_count();
+	switch (op) {
+	case DMA_CACHE_WBACK:
+		blast_wb_dcache_range(buf, buf + size);
+		break;
+	case DMA_CACHE_WBACK_INV:
+		blast_dcache_range(buf, buf + size);
+		break;
+	case DMA_CACHE_INV:
+		blast_inv_dcache_range(buf, buf + size);
+		break;
+	default:
+		r4k_blast_dcache();
+		break;
+	}
+	__sync();
+
+	return read_c0_count() - start;
+}
+
+/*
+ * Time each hit op over half the D-cache and a blast of a D-cache full of
+ * dirty lines, and move the crossovers to where they cost the same. The
+ * refills after a blast are not counted, so the crossovers err towards
+ * blasting a little early.
+ */
+static int __init r4k_dma_cache_calibrate(void)
+{
+	unsigned int t, best[DMA_CACHE_NR_OPS];
+	unsigned long buf, flags, half = dcache_size / 2;
+	u64 size;
+	int op, i;
+
+	if (_dma_cache_inv != r4k_dma_cache_inv || cpu_has_inclusive_pcaches ||
+	    !dcache_size)
+		return 0;
+
+	buf = (unsigned long)kmalloc(dcache_size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	local_irq_save(flags);
+	for (op = 0; op < DMA_CACHE_NR_OPS; op++) {
+		best[op] = UINT_MAX;
+		for (i = 0; i < 4; i++) {
+			if (op == DMA_CACHE_BLAST)
+				t = r4k_dma_cache_time(op, buf, dcache_size);
+			else
+				t = r4k_dma_cache_time(op, buf, half);
+			best[op] = min(best[op], t);
+		}
+	}
+	local_irq_restore(flags);
+	kfree((void *)buf);
+
+	for (op = 0; op < DMA_CACHE_BLAST; op++) {
+		if (op == DMA_CACHE_WBACK && _dma_cache_wback != r4k_dma_cache_wback)
+			continue;
+		size = (u64)best[DMA_CACHE_BLAST] * half;
+		do_div(size, max(best[op], 1U));
+		size = clamp_t(u64, size, PAGE_SIZE, 64 * dcache_size);
+		dma_cache_blast_size[op] = size & ~(u64)(cpu_dcache_line_size() - 1);
+	}
+
+	pr_info("DMA cache crossover: wback %lu, wback_inv %lu, inv %lu bytes\n",
+		dma_cache_blast_size[DMA_CACHE_WBACK],
+		dma_cache_blast_size[DMA_CACHE_WBACK_INV],
+		dma_cache_blast_size[DMA_CACHE_INV]);
+
+	return 0;
+}
+arch_initcall(r4k_dma_cache_calibrate);
+
+#ifdef CONFIG_DEBUG_FS
+static u64 dma_cache_last_bytes[DMA_CACHE_NR_OPS];
+static unsigned long dma_cache_last_jiffies = INITIAL_JIFFIES;
+static DEFINE_MUTEX(dma_cache_mutex);
+
+/* Total bytes per op, and per second since the last read */
+static int dma_cache_show(struct seq_file *m, void *v)
+{
+	unsigned long now = jiffies, dj;
+	u64 bytes, rate;
+	int op, cpu;
+
+	mutex_lock(&dma_cache_mutex);
+	dj = max(now - dma_cache_last_jiffies, 1UL);
+	seq_puts(m, "op          blast at           bytes       bytes/s\n");
+	for (op = 0; op < DMA_CACHE_NR_OPS; op++) {
+		bytes = 0;
+		for_each_possible_cpu(cpu)
+			bytes += per_cpu(dma_cache_stats, cpu).bytes[op];
+
+		rate = (bytes - dma_cache_last_bytes[op]) * HZ;
+		do_div(rate, dj);
+		dma_cache_last_bytes[op] = bytes;
+
+		if (op == DMA_CACHE_BLAST)
+			seq_printf(m, "%-10s %9s", dma_cache_op_names[op], "-");
+		else
+			seq_printf(m, "%-10s %9lu", dma_cache_op_names[op],
+				   dma_cache_blast_size[op]);
+		seq_printf(m, " %15llu %13llu\n", bytes, rate);
+	}
+	dma_cache_last_jiffies = now;
+	mutex_unlock(&dma_cache_mutex);
+
+	return 0;
+}
+
+static int dma_cache_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dma_cache_show, NULL);
+}
+
+static const struct file_operations dma_cache_fops = {
+	.open		= dma_cache_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init r4k_dma_cache_debugfs_init(void)
+{
+	struct dentry *dir, *d;
+	int op;
+
+	if (!mips_debugfs_dir || _dma_cache_inv != r4k_dma_cache_inv)
+		return 0;
+
+	dir = debugfs_create_dir("dma_cache", mips_debugfs_dir);
+	if (!dir)
+		return -ENOMEM;
+
+	d = debugfs_create_file("stats", S_IRUGO, dir, NULL, &dma_cache_fops);
+	if (!d)
+		return -ENOMEM;
+
+	/* the crossovers can be tuned, 0 always blasts */
+	for (op = 0; op < DMA_CACHE_BLAST; op++) {
+		d = debugfs_create_ulong(dma_cache_op_names[op], S_IRUGO | S_IWUSR,
+					 dir, &dma_cache_blast_size[op]);
+		if (!d)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+device_initcall(r4k_dma_cache_debugfs_init);
+#endif /* CONFIG_DEBUG_FS */
+
 #endif /* CONFIG_DMA_NONCOHERENT || CONFIG_DMA_MAYBE_COHERENT */
 
 struct flush_cache_sigtramp_args {
@@ -1950,6 +2176,12 @@ void r4k_cache_init(void)
 		_dma_cache_wback_inv	= r4k_dma_cache_wback_inv;
 		_dma_cache_wback	= r4k_dma_cache_wback_inv;
 		_dma_cache_inv		= r4k_dma_cache_inv;
+
+		if (!cpu_has_inclusive_pcaches && cpu_has_mips_r)
+			_dma_cache_wback = r4k_dma_cache_wback;
+		dma_cache_blast_size[DMA_CACHE_WBACK]	  = dcache_size;
+		dma_cache_blast_size[DMA_CACHE_WBACK_INV] = dcache_size;
+		dma_cache_blast_size[DMA_CACHE_INV]	  = dcache_size;
 	}
 #endif
 
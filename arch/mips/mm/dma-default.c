@@ -233,8 +233,15 @@ static int mips_dma_mmap(struct device *dev, struct vm_area_struct *vma,
 }
 
 static inline void __dma_sync_virtual(void *addr, size_t size,
-	enum dma_data_direction direction)
+	enum dma_data_direction direction, unsigned long attrs)
 {
+	/* No line of the buffer is dirty, there is nothing to write back */
+	if (attrs & DMA_ATTR_CPU_CLEAN) {
+		if (direction != DMA_TO_DEVICE)
+			dma_cache_inv((unsigned long)addr, size);
+		return;
+	}
+
 	switch (direction) {
 	case DMA_TO_DEVICE:
 		dma_cache_wback((unsigned long)addr, size);
@@ -259,8 +266,8 @@ static inline void __dma_sync_virtual(void *addr, size_t size,
  * If highmem is not configured then the bulk of this loop gets
  * optimized out.
  */
-static inline void __dma_sync(struct page *page,
-	unsigned long offset, size_t size, enum dma_data_direction direction)
+static inline void __dma_sync(struct page *page, unsigned long offset,
+	size_t size, enum dma_data_direction direction, unsigned long attrs)
 {
 	size_t left = size;
 
@@ -279,11 +286,11 @@ static inline void __dma_sync(struct page *page,
 			}
 
 			addr = kmap_atomic(page);
-			__dma_sync_virtual(addr + offset, len, direction);
+			__dma_sync_virtual(addr + offset, len, direction, attrs);
 			kunmap_atomic(addr);
 		} else
 			__dma_sync_virtual(page_address(page) + offset,
-					   size, direction);
+					   size, direction, attrs);
 		offset = 0;
 		page++;
 		left -= len;
@@ -296,7 +303,7 @@ mips_dma_unmap_page(struct device *dev, dma_addr_t dma_addr, size_t size,
 {
 	if (cpu_needs_post_dma_flush(dev))
 		__dma_sync(dma_addr_to_page(dev, dma_addr),
-			   dma_addr & ~PAGE_MASK, size, direction);
+			   dma_addr & ~PAGE_MASK, size, direction, attrs);
 	plat_post_dma_flush(dev);
 	plat_unmap_dma_mem(dev, dma_addr, size, direction);
 }
@@ -310,7 +317,7 @@ static int mips_dma_map_sg(struct device *dev, struct scatterlist *sglist,
 	for_each_sg(sglist, sg, nents, i) {
 		if (!plat_device_is_coherent(dev))
 			__dma_sync(sg_page(sg), sg->offset, sg->length,
-				   direction);
+				   direction, attrs);
 #ifdef CONFIG_NEED_SG_DMA_LENGTH
 		sg->dma_length = sg->length;
 #endif
@@ -326,7 +333,7 @@ static dma_addr_t mips_dma_map_page(struct device *dev, struct page *page,
 	unsigned long attrs)
 {
 	if (!plat_device_is_coherent(dev))
-		__dma_sync(page, offset, size, direction);
+		__dma_sync(page, offset, size, direction, attrs);
 
 	return plat_map_dma_mem_page(dev, page) + offset;
 }
@@ -343,7 +350,7 @@ mips_dma_unmap_sg(struct device *dev, struct scatterlist *sglist,
 		if (!plat_device_is_coherent(dev) &&
 		    direction != DMA_TO_DEVICE)
 			__dma_sync(sg_page(sg), sg->offset, sg->length,
-				   direction);
+				   direction, attrs);
 		plat_unmap_dma_mem(dev, sg->dma_address, sg->length, direction);
 	}
 }
@@ -354,7 +361,7 @@ mips_dma_sync_single_for_cpu(struct device *dev, dma_addr_t dma_handle,
 {
 	if (cpu_needs_post_dma_flush(dev))
 		__dma_sync(dma_addr_to_page(dev, dma_handle),
-			   dma_handle & ~PAGE_MASK, size, direction);
+			   dma_handle & ~PAGE_MASK, size, direction, 0);
 	plat_post_dma_flush(dev);
 }
 
@@ -363,7 +370,7 @@ static void mips_dma_sync_single_for_device(struct device *dev,
 {
 	if (!plat_device_is_coherent(dev))
 		__dma_sync(dma_addr_to_page(dev, dma_handle),
-			   dma_handle & ~PAGE_MASK, size, direction);
+			   dma_handle & ~PAGE_MASK, size, direction, 0);
 }
 
 static void __maybe_unused
@@ -376,7 +383,7 @@ mips_dma_sync_sg_for_cpu(struct device *dev, struct scatterlist *sglist,
 	if (cpu_needs_post_dma_flush(dev)) {
 		for_each_sg(sglist, sg, nelems, i) {
 			__dma_sync(sg_page(sg), sg->offset, sg->length,
-				   direction);
+				   direction, 0);
 		}
 	}
 	plat_post_dma_flush(dev);
@@ -392,7 +399,7 @@ static void mips_dma_sync_sg_for_device(struct device *dev,
 	if (!plat_device_is_coherent(dev)) {
 		for_each_sg(sglist, sg, nelems, i) {
 			__dma_sync(sg_page(sg), sg->offset, sg->length,
-				   direction);
+				   direction, 0);
 		}
 	}
 }
@@ -22,6 +22,7 @@
  */
 
 #include <linux/bug.h>
+#include <linux/debugfs.h>
 #include <linux/kernel.h>
 #include <linux/types.h>
 #include <linux/smp.h>
@@ -30,6 +31,7 @@
 
 #include <asm/cacheflush.h>
 #include <asm/cpu-type.h>
+#include <asm/debug.h>
 #include <asm/pgtable.h>
 #include <asm/war.h>
 #include <asm/uasm.h>
@@ -46,6 +48,43 @@ static int __init xpa_disable(char *s)
 
 __setup("noxpa", xpa_disable);
 
+/*
+ * With "tlbstat" the 32-bit refill handler counts the refills, in
+ * debugfs mips/tlb_refills. The counter is shared, on SMP it is only
+ * an estimate.
+ */
+static int mips_tlb_refill_stats;
+static unsigned long tlb_refill_count;
+
+static int __init tlb_refill_stats_enable(char *s)
+{
+	mips_tlb_refill_stats = 1;
+
+	return 1;
+}
+
+__setup("tlbstat", tlb_refill_stats_enable);
+
+#ifdef CONFIG_DEBUG_FS
+static int __init tlb_refill_debugfs_init(void)
+{
+	struct dentry *d;
+
+	if (!mips_tlb_refill_stats || IS_ENABLED(CONFIG_64BIT))
+		return 0;
+	if (!mips_debugfs_dir)
+		return -ENODEV;
+
+	d = debugfs_create_ulong("tlb_refills", S_IRUGO | S_IWUSR,
+				 mips_debugfs_dir, &tlb_refill_count);
+	if (!d)
+		return -ENOMEM;
+
+	return 0;
+}
+late_initcall(tlb_refill_debugfs_init);
+#endif
+
 /*
  * TLB load/store/modify handlers.
  *
@@ -1310,6 +1349,14 @@ static void build_r4000_tlb_refill_handler(void)
 #ifdef CONFIG_64BIT
 		build_get_pmde64(&p, &l, &r, K0, K1); /* get pmd in K1 */
 #else
+		if (mips_tlb_refill_stats) {
+			long addr = (long)&tlb_refill_count;
+
+			uasm_i_lui(&p, K0, uasm_rel_hi(addr));
+			UASM_i_LW(&p, K1, uasm_rel_lo(addr), K0);
+			UASM_i_ADDIU(&p, K1, K1, 1);
+			UASM_i_SW(&p, K1, uasm_rel_lo(addr), K0);
+		}
 		build_get_pgde32(&p, K0, K1); /* get pgd in K1 */
 #endif
 
@@ -2056,6 +2103,25 @@ build_r4000_tlbchange_handler_tail(u32 **p, struct uasm_label **l,
 #endif
 }
 
+/*
+ * Jump from the fastpath handlers to the page fault code. A j can't get
+ * there from microMIPS code, nor from the handlers in RAM when the text
+ * runs from flash in another 256MB region.
+ */
+static void build_jump_page_fault(u32 **p, void (*handler)(void))
+{
+	unsigned long addr = (unsigned long)handler;
+
+	if ((IS_ENABLED(CONFIG_CPU_MICROMIPS) && (addr & 1)) ||
+	    IS_ENABLED(CONFIG_XIP_KERNEL)) {
+		uasm_i_lui(p, K0, uasm_rel_hi((long)addr));
+		uasm_i_addiu(p, K0, K0, uasm_rel_lo((long)addr));
+		uasm_i_jr(p, K0);
+	} else {
+		uasm_i_j(p, addr & 0x0fffffff);
+	}
+}
+
 static void build_r4000_tlb_load_handler(void)
 {
 	u32 *p = handle_tlbl;
@@ -2219,14 +2285,7 @@ static void build_r4000_tlb_load_handler(void)
 
 	uasm_l_nopage_tlbl(&l, p);
 	build_restore_work_registers(&p);
-#ifdef CONFIG_CPU_MICROMIPS
-	if ((unsigned long)tlb_do_page_fault_0 & 1) {
-		uasm_i_lui(&p, K0, uasm_rel_hi((long)tlb_do_page_fault_0));
-		uasm_i_addiu(&p, K0, K0, uasm_rel_lo((long)tlb_do_page_fault_0));
-		uasm_i_jr(&p, K0);
-	} else
-#endif
-	uasm_i_j(&p, (unsigned long)tlb_do_page_fault_0 & 0x0fffffff);
+	build_jump_page_fault(&p, tlb_do_page_fault_0);
 	uasm_i_nop(&p);
 
 	if (p >= handle_tlbl_end)
@@ -2274,14 +2333,7 @@ static void build_r4000_tlb_store_handler(void)
 
 	uasm_l_nopage_tlbs(&l, p);
 	build_restore_work_registers(&p);
-#ifdef CONFIG_CPU_MICROMIPS
-	if ((unsigned long)tlb_do_page_fault_1 & 1) {
-		uasm_i_lui(&p, K0, uasm_rel_hi((long)tlb_do_page_fault_1));
-		uasm_i_addiu(&p, K0, K0, uasm_rel_lo((long)tlb_do_page_fault_1));
-		uasm_i_jr(&p, K0);
-	} else
-#endif
-	uasm_i_j(&p, (unsigned long)tlb_do_page_fault_1 & 0x0fffffff);
+	build_jump_page_fault(&p, tlb_do_page_fault_1);
 	uasm_i_nop(&p);
 
 	if (p >= handle_tlbs_end)
@@ -2330,14 +2382,7 @@ static void build_r4000_tlb_modify_handler(void)
 
 	uasm_l_nopage_tlbm(&l, p);
 	build_restore_work_registers(&p);
-#ifdef CONFIG_CPU_MICROMIPS
-	if ((unsigned long)tlb_do_page_fault_1 & 1) {
-		uasm_i_lui(&p, K0, uasm_rel_hi((long)tlb_do_page_fault_1));
-		uasm_i_addiu(&p, K0, K0, uasm_rel_lo((long)tlb_do_page_fault_1));
-		uasm_i_jr(&p, K0);
-	} else
-#endif
-	uasm_i_j(&p, (unsigned long)tlb_do_page_fault_1 & 0x0fffffff);
+	build_jump_page_fault(&p, tlb_do_page_fault_1);
 	uasm_i_nop(&p);
 
 	if (p >= handle_tlbm_end)
@@ -1188,10 +1188,21 @@ jmp_cmp:
 
 int bpf_jit_enable __read_mostly;
 
+/* Fill unused parts of the image with break instructions */
+void bpf_jit_fill_hole(void *area, unsigned int size)
+{
+	u32 *p;
+
+	for (p = area; size >= sizeof(u32); size -= sizeof(u32))
+		*p++ = 0x0000000d;
+}
+
 void bpf_jit_compile(struct bpf_prog *fp)
 {
+	struct bpf_binary_header *header;
 	struct jit_ctx ctx;
 	unsigned int alloc_size, tmp_idx;
+	u8 *image;
 
 	if (!bpf_jit_enable)
 		return;
@@ -1214,13 +1225,12 @@ void bpf_jit_compile(struct bpf_prog *fp)
 	build_epilogue(&ctx);
 
 	alloc_size = 4 * ctx.idx;
-	ctx.target = module_alloc(alloc_size);
-	if (ctx.target == NULL)
+	header = bpf_jit_binary_alloc(alloc_size, &image, sizeof(u32),
+				      bpf_jit_fill_hole);
+	if (header == NULL)
 		goto out;
 
-	/* Clean it */
-	memset(ctx.target, 0, alloc_size);
-
+	ctx.target = (u32 *)image;
 	ctx.idx = 0;
 
 	/* Generate the actual JIT code */
@@ -1242,10 +1252,13 @@ out:
 	kfree(ctx.offsets);
 }
 
+/* Shared with the eBPF JIT, both allocate through bpf_jit_binary_alloc() */
 void bpf_jit_free(struct bpf_prog *fp)
 {
+	unsigned long addr = (unsigned long)fp->bpf_func & PAGE_MASK;
+
 	if (fp->jited)
-		module_memfree(fp->bpf_func);
+		bpf_jit_binary_free((struct bpf_binary_header *)addr);
 
 	bpf_prog_unlock_free(fp);
 }
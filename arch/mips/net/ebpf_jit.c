@@ -0,0 +1,1233 @@
+/*
+ * Just-In-Time compiler for eBPF filters on MIPS32r2
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; version 2 of the License.
+ */
+
+#include <linux/atomic.h>
+#include <linux/bpf.h>
+#include <linux/errno.h>
+#include <linux/filter.h>
+#include <linux/math64.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/types.h>
+#include <asm/cacheflush.h>
+#include <asm/uasm.h>
+
+#include "bpf_jit.h"
+
+/*
+ * eBPF registers are 64 bits wide and live in pairs of MIPS registers.
+ * R0-R5 use the registers the o32 ABI uses for a 64-bit return value and
+ * the 64-bit arguments of a helper call, so calls need no shuffling
+ * except for R3-R5, which o32 passes on the stack. R6-R9 live in the
+ * callee saved registers. R10 is read-only and never above 4G, so its
+ * high word is $zero.
+ *
+ * o32 keeps a 64-bit value in a register pair in memory order, which is
+ * why the low word comes second on big endian.
+ */
+#define LO	0
+#define HI	1
+
+#ifdef __BIG_ENDIAN
+#define PAIR(first, second)	{ second, first }
+#define OFF_LO			4
+#define OFF_HI			0
+#else
+#define PAIR(first, second)	{ first, second }
+#define OFF_LO			0
+#define OFF_HI			4
+#endif
+
+static const u8 bpf2mips[][2] = {
+	/* return value from helpers, and exit value of the program */
+	[BPF_REG_0] = PAIR(MIPS_R_V0, MIPS_R_V1),
+	/* arguments to helpers, R3-R5 are copied to the stack for calls */
+	[BPF_REG_1] = PAIR(MIPS_R_A0, MIPS_R_A1),
+	[BPF_REG_2] = PAIR(MIPS_R_A2, MIPS_R_A3),
+	[BPF_REG_3] = PAIR(MIPS_R_T0, MIPS_R_T1),
+	[BPF_REG_4] = PAIR(MIPS_R_T2, MIPS_R_T3),
+	[BPF_REG_5] = PAIR(MIPS_R_T4, MIPS_R_T5),
+	/* preserved across helper calls */
+	[BPF_REG_6] = PAIR(MIPS_R_S0, MIPS_R_S1),
+	[BPF_REG_7] = PAIR(MIPS_R_S2, MIPS_R_S3),
+	[BPF_REG_8] = PAIR(MIPS_R_S4, MIPS_R_S5),
+	[BPF_REG_9] = PAIR(MIPS_R_S6, MIPS_R_S7),
+	/* read-only frame pointer */
+	[BPF_REG_FP] = { MIPS_R_FP, MIPS_R_ZERO },
+	/* constant blinding */
+	[BPF_REG_AX] = PAIR(MIPS_R_T6, MIPS_R_T7),
+};
+
+/*
+ * Scratch registers. $ra is saved in the prologue and the JIT never
+ * relies on it, so it is free between calls as well.
+ */
+#define J_T8	MIPS_R_T8
+#define J_T9	MIPS_R_T9
+#define J_AT	MIPS_R_AT
+#define J_RA	MIPS_R_RA
+
+/*
+ * Stack frame, all programs use the same one so that tail calls can
+ * reuse the frame of the caller.
+ *
+ *   0 +----------------------+ <= $sp
+ *     | o32 argument area    |
+ *  16 +----------------------+
+ *     | helper args R3 - R5  |
+ *  40 +----------------------+
+ *     | tail call count      |
+ *  44 +----------------------+
+ *     | skb load buffer      |
+ *  48 +----------------------+
+ *     | spill area           | R0-R5/AX around internal helper calls
+ * 104 +----------------------+
+ *     | eBPF stack           |
+ * 616 +----------------------+ <= R10
+ *     | saved $ra $fp $s0-7  |
+ * 656 +----------------------+
+ */
+#define JIT_ARGS_OFF		16
+#define JIT_TCC_OFF		40
+#define JIT_BUF_OFF		44
+#define JIT_SPILL_OFF		48
+#define JIT_SPILL_REGS		7	/* R0-R5, AX */
+#define JIT_STACK_OFF		(JIT_SPILL_OFF + JIT_SPILL_REGS * 8)
+#define JIT_FP_OFF		(JIT_STACK_OFF + MAX_BPF_STACK)
+#define JIT_SAVE_OFF		JIT_FP_OFF
+#define JIT_SAVE_REGS		10	/* $ra, $fp, $s0-$s7 */
+#define JIT_FRAME_SIZE		(JIT_SAVE_OFF + JIT_SAVE_REGS * 4)
+
+/*
+ * Instructions before the tail call entry point: stack adjustment,
+ * register saves, $fp setup, R1 setup and the tail call count.
+ */
+#ifdef __BIG_ENDIAN
+#define JIT_PROLOGUE_R1		2
+#else
+#define JIT_PROLOGUE_R1		1
+#endif
+#define JIT_TAIL_OFFSET		((2 + JIT_SAVE_REGS + JIT_PROLOGUE_R1 + 1) * 4)
+
+/**
+ * struct jit_ctx - JIT context
+ * @prog:		The eBPF program
+ * @image:		Memory for the compiled program, NULL when sizing
+ * @idx:		Instruction index
+ * @offsets:		Instruction index of each eBPF instruction
+ * @zero_exit:		Instruction index of the "return 0" exit path
+ * @epilogue:		Instruction index of the epilogue
+ * @bad_branch:		A branch target was out of range
+ */
+struct jit_ctx {
+	const struct bpf_prog *prog;
+	u32 *image;
+	u32 idx;
+	u32 *offsets;
+	u32 zero_exit;
+	u32 epilogue;
+	bool bad_branch;
+};
+
+#define emit(ctx, func, ...)					\
+do {								\
+	if ((ctx)->image != NULL) {				\
+		u32 *p = &(ctx)->image[(ctx)->idx];		\
+		uasm_i_##func(&p, ##__VA_ARGS__);		\
+	}							\
+	(ctx)->idx++;						\
+} while (0)
+
+static inline bool is_range16(s32 imm)
+{
+	return imm >= -0x8000 && imm < 0x8000;
+}
+
+/* Byte offset from the delay slot of a branch at ctx->idx to @tgt */
+static s32 b_off(struct jit_ctx *ctx, u32 tgt)
+{
+	s32 off = ((s32)tgt - (s32)(ctx->idx + 1)) * 4;
+
+	if (off < -0x20000 || off > 0x1fffc) {
+		ctx->bad_branch = true;
+		return 0;
+	}
+
+	return off;
+}
+
+static void emit_mov(struct jit_ctx *ctx, u8 dst, u8 src)
+{
+	if (dst != src)
+		emit(ctx, addu, dst, src, MIPS_R_ZERO);
+}
+
+static void emit_load_imm(struct jit_ctx *ctx, u8 dst, s32 imm)
+{
+	if (is_range16(imm)) {
+		emit(ctx, addiu, dst, MIPS_R_ZERO, imm);
+	} else if (imm >= 0 && imm <= 0xffff) {
+		emit(ctx, ori, dst, MIPS_R_ZERO, imm);
+	} else {
+		emit(ctx, lui, dst, imm >> 16);
+		if (imm & 0xffff)
+			emit(ctx, ori, dst, dst, imm & 0xffff);
+	}
+}
+
+/* Always two instructions, for code that needs a fixed length */
+static void emit_load_addr(struct jit_ctx *ctx, u8 dst, unsigned long addr)
+{
+	emit(ctx, lui, dst, (s32)addr >> 16);
+	emit(ctx, ori, dst, dst, addr & 0xffff);
+}
+
+/* Sign extension of a 32-bit immediate into the high word */
+static void emit_load_sext_hi(struct jit_ctx *ctx, u8 dst, s32 imm)
+{
+	emit(ctx, addiu, dst, MIPS_R_ZERO, imm < 0 ? -1 : 0);
+}
+
+static void emit_zext(struct jit_ctx *ctx, u8 hi)
+{
+	emit(ctx, addu, hi, MIPS_R_ZERO, MIPS_R_ZERO);
+}
+
+static void emit_bpf_branch(struct jit_ctx *ctx, bool eq, u8 rs, u8 rt,
+			    int bpf_tgt)
+{
+	if (eq)
+		emit(ctx, beq, rs, rt, b_off(ctx, ctx->offsets[bpf_tgt]));
+	else
+		emit(ctx, bne, rs, rt, b_off(ctx, ctx->offsets[bpf_tgt]));
+	emit(ctx, nop);
+}
+
+static void emit_zero_exit_if_zero(struct jit_ctx *ctx, u8 reg)
+{
+	emit(ctx, beq, reg, MIPS_R_ZERO, b_off(ctx, ctx->zero_exit));
+	emit(ctx, nop);
+}
+
+static void emit_call(struct jit_ctx *ctx, unsigned long func)
+{
+	emit_load_addr(ctx, J_T9, func);
+	emit(ctx, jalr, J_RA, J_T9);
+	emit(ctx, nop);
+}
+
+/*
+ * Save or restore the call clobbered eBPF registers around calls the
+ * program does not know about, except @keep which receives the result.
+ */
+static void emit_spill(struct jit_ctx *ctx, int keep, bool restore)
+{
+	static const u8 regs[JIT_SPILL_REGS] = {
+		BPF_REG_0, BPF_REG_1, BPF_REG_2, BPF_REG_3,
+		BPF_REG_4, BPF_REG_5, BPF_REG_AX,
+	};
+	int i, off;
+
+	for (i = 0; i < JIT_SPILL_REGS; i++) {
+		if (regs[i] == keep)
+			continue;
+
+		off = JIT_SPILL_OFF + i * 8;
+		if (restore) {
+			emit(ctx, lw, bpf2mips[regs[i]][LO], off, MIPS_R_SP);
+			emit(ctx, lw, bpf2mips[regs[i]][HI], off + 4,
+			     MIPS_R_SP);
+		} else {
+			emit(ctx, sw, bpf2mips[regs[i]][LO], off, MIPS_R_SP);
+			emit(ctx, sw, bpf2mips[regs[i]][HI], off + 4,
+			     MIPS_R_SP);
+		}
+	}
+}
+
+static u64 jit_div64(u64 dividend, u64 divisor)
+{
+	return div64_u64(dividend, divisor);
+}
+
+static u64 jit_mod64(u64 dividend, u64 divisor)
+{
+	u64 rem;
+
+	div64_u64_rem(dividend, divisor, &rem);
+	return rem;
+}
+
+static void *jit_load_pointer(const struct sk_buff *skb, int k,
+			      unsigned int size, void *buffer)
+{
+	return bpf_load_pointer(skb, k, size, buffer);
+}
+
+static void build_prologue(struct jit_ctx *ctx)
+{
+	const u8 *r1 = bpf2mips[BPF_REG_1];
+	int i;
+
+	emit(ctx, addiu, MIPS_R_SP, MIPS_R_SP, -JIT_FRAME_SIZE);
+	emit(ctx, sw, MIPS_R_RA, JIT_SAVE_OFF, MIPS_R_SP);
+	emit(ctx, sw, MIPS_R_FP, JIT_SAVE_OFF + 4, MIPS_R_SP);
+	for (i = 0; i < 8; i++)
+		emit(ctx, sw, MIPS_R_S0 + i, JIT_SAVE_OFF + 8 + i * 4,
+		     MIPS_R_SP);
+	emit(ctx, addiu, MIPS_R_FP, MIPS_R_SP, JIT_FP_OFF);
+
+	/* The context pointer arrives as a 32-bit argument in $a0 */
+#ifdef __BIG_ENDIAN
+	emit(ctx, addu, r1[LO], MIPS_R_A0, MIPS_R_ZERO);
+#endif
+	emit_zext(ctx, r1[HI]);
+
+	emit(ctx, sw, MIPS_R_ZERO, JIT_TCC_OFF, MIPS_R_SP);
+	/* tail calls enter here */
+}
+
+static void build_epilogue(struct jit_ctx *ctx)
+{
+	const u8 *r0 = bpf2mips[BPF_REG_0];
+	int i;
+
+	ctx->epilogue = ctx->idx;
+	emit_mov(ctx, MIPS_R_V0, r0[LO]);
+	emit(ctx, lw, MIPS_R_RA, JIT_SAVE_OFF, MIPS_R_SP);
+	emit(ctx, lw, MIPS_R_FP, JIT_SAVE_OFF + 4, MIPS_R_SP);
+	for (i = 0; i < 8; i++)
+		emit(ctx, lw, MIPS_R_S0 + i, JIT_SAVE_OFF + 8 + i * 4,
+		     MIPS_R_SP);
+	emit(ctx, jr, MIPS_R_RA);
+	emit(ctx, addiu, MIPS_R_SP, MIPS_R_SP, JIT_FRAME_SIZE);
+
+	/* division by zero and failed packet loads return 0 */
+	ctx->zero_exit = ctx->idx;
+	emit(ctx, b, b_off(ctx, ctx->epilogue));
+	emit_zext(ctx, r0[LO]);
+}
+
+/* dst = dst <op> imm on a 32-bit word, for and/or/xor */
+static void emit_logic_imm(struct jit_ctx *ctx, u8 op, u8 dst, s32 imm)
+{
+	bool fits = imm >= 0 && imm <= 0xffff;
+
+	if (!fits)
+		emit_load_imm(ctx, J_T8, imm);
+
+	switch (op) {
+	case BPF_AND:
+		if (fits)
+			emit(ctx, andi, dst, dst, imm);
+		else
+			emit(ctx, and, dst, dst, J_T8);
+		break;
+	case BPF_OR:
+		if (fits)
+			emit(ctx, ori, dst, dst, imm);
+		else
+			emit(ctx, or, dst, dst, J_T8);
+		break;
+	case BPF_XOR:
+		if (fits)
+			emit(ctx, xori, dst, dst, imm);
+		else
+			emit(ctx, xor, dst, dst, J_T8);
+		break;
+	}
+}
+
+/* dst += val on a register pair */
+static void emit_add64_imm(struct jit_ctx *ctx, const u8 *dst, u64 val)
+{
+	s32 lo = (u32)val, hi = (u32)(val >> 32);
+
+	if (lo) {
+		if (is_range16(lo)) {
+			emit(ctx, addiu, J_T8, dst[LO], lo);
+			emit(ctx, sltiu, J_T9, J_T8, lo);
+		} else {
+			emit_load_imm(ctx, J_AT, lo);
+			emit(ctx, addu, J_T8, dst[LO], J_AT);
+			emit(ctx, sltu, J_T9, J_T8, J_AT);
+		}
+		emit(ctx, addu, dst[HI], dst[HI], J_T9);
+		emit_mov(ctx, dst[LO], J_T8);
+	}
+
+	if (hi) {
+		if (is_range16(hi)) {
+			emit(ctx, addiu, dst[HI], dst[HI], hi);
+		} else {
+			emit_load_imm(ctx, J_AT, hi);
+			emit(ctx, addu, dst[HI], dst[HI], J_AT);
+		}
+	}
+}
+
+/* 64-bit shift by a constant */
+static void emit_shift64_imm(struct jit_ctx *ctx, u8 op, const u8 *dst,
+			     u32 n)
+{
+	n &= 63;
+	if (!n)
+		return;
+
+	switch (op) {
+	case BPF_LSH:
+		if (n < 32) {
+			emit(ctx, srl, J_T8, dst[LO], 32 - n);
+			emit(ctx, sll, dst[HI], dst[HI], n);
+			emit(ctx, or, dst[HI], dst[HI], J_T8);
+			emit(ctx, sll, dst[LO], dst[LO], n);
+		} else {
+			emit(ctx, sll, dst[HI], dst[LO], n - 32);
+			emit_zext(ctx, dst[LO]);
+		}
+		break;
+	case BPF_RSH:
+		if (n < 32) {
+			emit(ctx, sll, J_T8, dst[HI], 32 - n);
+			emit(ctx, srl, dst[LO], dst[LO], n);
+			emit(ctx, or, dst[LO], dst[LO], J_T8);
+			emit(ctx, srl, dst[HI], dst[HI], n);
+		} else {
+			emit(ctx, srl, dst[LO], dst[HI], n - 32);
+			emit_zext(ctx, dst[HI]);
+		}
+		break;
+	case BPF_ARSH:
+		if (n < 32) {
+			emit(ctx, sll, J_T8, dst[HI], 32 - n);
+			emit(ctx, srl, dst[LO], dst[LO], n);
+			emit(ctx, or, dst[LO], dst[LO], J_T8);
+			emit(ctx, sra, dst[HI], dst[HI], n);
+		} else {
+			emit(ctx, sra, dst[LO], dst[HI], n - 32);
+			emit(ctx, sra, dst[HI], dst[HI], 31);
+		}
+		break;
+	}
+}
+
+/*
+ * 64-bit shift by a register. Shifts below 32 combine both words, the
+ * word crossing part is done as (x >> 1) >> (31 - n) so that n == 0
+ * needs no special case.
+ */
+static void emit_shift64_reg(struct jit_ctx *ctx, u8 op, const u8 *dst,
+			     u8 src)
+{
+	emit(ctx, andi, J_T8, src, 63);
+	emit(ctx, andi, J_T9, J_T8, 32);
+	/* to the >= 32 case, past the 8 instructions below */
+	emit(ctx, bne, J_T9, MIPS_R_ZERO, 9 * 4);
+	emit(ctx, nop);
+
+	switch (op) {
+	case BPF_LSH:
+		emit(ctx, sllv, dst[HI], dst[HI], J_T8);
+		emit(ctx, xori, J_T9, J_T8, 31);
+		emit(ctx, srl, J_AT, dst[LO], 1);
+		emit(ctx, srlv, J_AT, J_AT, J_T9);
+		emit(ctx, or, dst[HI], dst[HI], J_AT);
+		emit(ctx, sllv, dst[LO], dst[LO], J_T8);
+		emit(ctx, b, 3 * 4);
+		emit(ctx, nop);
+		emit(ctx, sllv, dst[HI], dst[LO], J_T8);
+		emit_zext(ctx, dst[LO]);
+		break;
+	case BPF_RSH:
+	case BPF_ARSH:
+		emit(ctx, srlv, dst[LO], dst[LO], J_T8);
+		emit(ctx, xori, J_T9, J_T8, 31);
+		emit(ctx, sll, J_AT, dst[HI], 1);
+		emit(ctx, sllv, J_AT, J_AT, J_T9);
+		emit(ctx, or, dst[LO], dst[LO], J_AT);
+		if (op == BPF_RSH)
+			emit(ctx, srlv, dst[HI], dst[HI], J_T8);
+		else
+			emit(ctx, srav, dst[HI], dst[HI], J_T8);
+		emit(ctx, b, 3 * 4);
+		emit(ctx, nop);
+		if (op == BPF_RSH) {
+			emit(ctx, srlv, dst[LO], dst[HI], J_T8);
+			emit_zext(ctx, dst[HI]);
+		} else {
+			emit(ctx, srav, dst[LO], dst[HI], J_T8);
+			emit(ctx, sra, dst[HI], dst[HI], 31);
+		}
+		break;
+	}
+}
+
+/* dst *= src, with the high word of src given separately for constants */
+static void emit_mul64(struct jit_ctx *ctx, const u8 *dst, u8 src_lo,
+		       u8 src_hi, bool neg_hi)
+{
+	if (neg_hi) {
+		/* high word of the constant is all ones */
+		emit(ctx, mul, J_T8, dst[HI], src_lo);
+		emit(ctx, subu, J_T8, J_T8, dst[LO]);
+	} else {
+		emit(ctx, mul, J_T8, dst[HI], src_lo);
+		emit(ctx, mul, J_T9, dst[LO], src_hi);
+		emit(ctx, addu, J_T8, J_T8, J_T9);
+	}
+	emit(ctx, multu, dst[LO], src_lo);
+	emit(ctx, mflo, dst[LO]);
+	emit(ctx, mfhi, J_T9);
+	emit(ctx, addu, dst[HI], J_T8, J_T9);
+}
+
+/* 64-bit division and modulo go through C helpers */
+static void emit_divmod64(struct jit_ctx *ctx, const struct bpf_insn *insn)
+{
+	const u8 *dst = bpf2mips[insn->dst_reg];
+	const u8 *src = bpf2mips[insn->src_reg];
+	const u8 *r0 = bpf2mips[BPF_REG_0];
+	const u8 *r1 = bpf2mips[BPF_REG_1];
+	const u8 *r2 = bpf2mips[BPF_REG_2];
+
+	if (BPF_SRC(insn->code) == BPF_X) {
+		emit(ctx, or, J_T8, src[LO], src[HI]);
+		emit_zero_exit_if_zero(ctx, J_T8);
+	}
+
+	emit_spill(ctx, insn->dst_reg, false);
+
+	if (BPF_SRC(insn->code) == BPF_X) {
+		emit_mov(ctx, J_T8, src[LO]);
+		emit_mov(ctx, J_AT, src[HI]);
+	} else {
+		emit_load_imm(ctx, J_T8, insn->imm);
+		emit_load_sext_hi(ctx, J_AT, insn->imm);
+	}
+	emit_mov(ctx, r1[LO], dst[LO]);
+	emit_mov(ctx, r1[HI], dst[HI]);
+	emit_mov(ctx, r2[LO], J_T8);
+	emit_mov(ctx, r2[HI], J_AT);
+
+	if (BPF_OP(insn->code) == BPF_DIV)
+		emit_call(ctx, (unsigned long)jit_div64);
+	else
+		emit_call(ctx, (unsigned long)jit_mod64);
+
+	emit_mov(ctx, dst[LO], r0[LO]);
+	emit_mov(ctx, dst[HI], r0[HI]);
+	emit_spill(ctx, insn->dst_reg, true);
+}
+
+static void emit_bswap(struct jit_ctx *ctx, const u8 *dst, s32 bits)
+{
+	switch (bits) {
+	case 16:
+		emit(ctx, wsbh, dst[LO], dst[LO]);
+		emit(ctx, andi, dst[LO], dst[LO], 0xffff);
+		break;
+	case 32:
+		emit(ctx, wsbh, dst[LO], dst[LO]);
+		emit(ctx, rotr, dst[LO], dst[LO], 16);
+		break;
+	case 64:
+		emit(ctx, wsbh, J_T8, dst[LO]);
+		emit(ctx, rotr, J_T8, J_T8, 16);
+		emit(ctx, wsbh, dst[LO], dst[HI]);
+		emit(ctx, rotr, dst[LO], dst[LO], 16);
+		emit_mov(ctx, dst[HI], J_T8);
+		break;
+	}
+}
+
+/* Conditional jump on two register pairs */
+static void emit_jmp64(struct jit_ctx *ctx, u8 op, const u8 *dst,
+		       u8 src_lo, u8 src_hi, int tgt)
+{
+	switch (op) {
+	case BPF_JEQ:
+	case BPF_JNE:
+		emit(ctx, xor, J_T8, dst[LO], src_lo);
+		emit(ctx, xor, J_T9, dst[HI], src_hi);
+		emit(ctx, or, J_T8, J_T8, J_T9);
+		emit_bpf_branch(ctx, op == BPF_JEQ, J_T8, MIPS_R_ZERO, tgt);
+		break;
+	case BPF_JSET:
+		emit(ctx, and, J_T8, dst[LO], src_lo);
+		emit(ctx, and, J_T9, dst[HI], src_hi);
+		emit(ctx, or, J_T8, J_T8, J_T9);
+		emit_bpf_branch(ctx, false, J_T8, MIPS_R_ZERO, tgt);
+		break;
+	case BPF_JGT:
+	case BPF_JGE:
+	case BPF_JSGT:
+	case BPF_JSGE:
+		/* high words decide unless they are equal */
+		if (op == BPF_JSGT || op == BPF_JSGE)
+			emit(ctx, slt, J_T8, src_hi, dst[HI]);
+		else
+			emit(ctx, sltu, J_T8, src_hi, dst[HI]);
+		emit_bpf_branch(ctx, false, J_T8, MIPS_R_ZERO, tgt);
+		/* not taken, past the 3 instructions below */
+		emit(ctx, bne, dst[HI], src_hi, 4 * 4);
+		emit(ctx, nop);
+		/* low words compare unsigned in either case */
+		if (op == BPF_JGT || op == BPF_JSGT) {
+			emit(ctx, sltu, J_T8, src_lo, dst[LO]);
+			emit_bpf_branch(ctx, false, J_T8, MIPS_R_ZERO, tgt);
+		} else {
+			emit(ctx, sltu, J_T8, dst[LO], src_lo);
+			emit_bpf_branch(ctx, true, J_T8, MIPS_R_ZERO, tgt);
+		}
+		break;
+	}
+}
+
+/*
+ * bpf_tail_call(ctx, array, index): R2 holds the array, R3 the index.
+ * Jumps into the target past its prologue, keeping the frame.
+ */
+static void emit_tail_call(struct jit_ctx *ctx)
+{
+	const u8 *r2 = bpf2mips[BPF_REG_2];
+	const u8 *r3 = bpf2mips[BPF_REG_3];
+	/* byte offset from the delay slot of instruction @i to "out" */
+#define OUT(i)	((21 - (i) - 1) * 4)
+
+	/* if (index >= array->map.max_entries) goto out; */
+	emit(ctx, bne, r3[HI], MIPS_R_ZERO, OUT(0));
+	emit(ctx, nop);
+	emit(ctx, lw, J_T8, offsetof(struct bpf_array, map.max_entries),
+	     r2[LO]);
+	emit(ctx, sltu, J_T8, r3[LO], J_T8);
+	emit(ctx, beq, J_T8, MIPS_R_ZERO, OUT(4));
+	emit(ctx, nop);
+
+	/* if (tail_call_cnt > MAX_TAIL_CALL_CNT) goto out; */
+	emit(ctx, lw, J_T9, JIT_TCC_OFF, MIPS_R_SP);
+	emit(ctx, sltiu, J_T8, J_T9, MAX_TAIL_CALL_CNT + 1);
+	emit(ctx, beq, J_T8, MIPS_R_ZERO, OUT(8));
+	emit(ctx, nop);
+	emit(ctx, addiu, J_T9, J_T9, 1);
+	emit(ctx, sw, J_T9, JIT_TCC_OFF, MIPS_R_SP);
+
+	/* prog = array->ptrs[index]; if (prog == NULL) goto out; */
+	emit(ctx, sll, J_T8, r3[LO], 2);
+	emit(ctx, addu, J_T8, J_T8, r2[LO]);
+	emit(ctx, lw, J_T8, offsetof(struct bpf_array, ptrs), J_T8);
+	emit(ctx, beq, J_T8, MIPS_R_ZERO, OUT(15));
+	emit(ctx, nop);
+
+	/* goto *(prog->bpf_func + JIT_TAIL_OFFSET); */
+	emit(ctx, lw, J_T9, offsetof(struct bpf_prog, bpf_func), J_T8);
+	emit(ctx, addiu, J_T9, J_T9, JIT_TAIL_OFFSET);
+	emit(ctx, jr, J_T9);
+	emit(ctx, nop);
+	/* out: */
+#undef OUT
+}
+
+/* R0 = ntohx(*(size *)(skb->data + k)), k in $at */
+static void emit_ld_skb(struct jit_ctx *ctx, int size)
+{
+	const u8 *r0 = bpf2mips[BPF_REG_0];
+	const u8 skb = bpf2mips[BPF_REG_6][LO];
+
+	/* fast path for linear data, negative offsets take the slow path */
+	emit(ctx, bltz, J_AT, (13 - 1) * 4);
+	emit(ctx, nop);
+	emit(ctx, lw, J_T8, offsetof(struct sk_buff, len), skb);
+	emit(ctx, lw, J_T9, offsetof(struct sk_buff, data_len), skb);
+	emit(ctx, subu, J_T8, J_T8, J_T9);
+	emit(ctx, addiu, J_T9, J_AT, size);
+	emit(ctx, sltu, J_T8, J_T8, J_T9);
+	emit(ctx, bne, J_T8, MIPS_R_ZERO, (13 - 8) * 4);
+	emit(ctx, nop);
+	emit(ctx, lw, J_T8, offsetof(struct sk_buff, data), skb);
+	emit(ctx, addu, J_T8, J_T8, J_AT);
+	emit(ctx, b, (24 - 12) * 4);
+	emit(ctx, nop);
+
+	/* slow path: fragments and negative offsets */
+	emit(ctx, addu, MIPS_R_A0, skb, MIPS_R_ZERO);
+	emit(ctx, addu, MIPS_R_A1, J_AT, MIPS_R_ZERO);
+	emit(ctx, addiu, MIPS_R_A2, MIPS_R_ZERO, size);
+	emit(ctx, addiu, MIPS_R_A3, MIPS_R_SP, JIT_BUF_OFF);
+	emit_call(ctx, (unsigned long)jit_load_pointer);
+	emit_zero_exit_if_zero(ctx, MIPS_R_V0);
+	emit(ctx, addu, J_T8, MIPS_R_V0, MIPS_R_ZERO);
+
+	/* load: */
+	switch (size) {
+	case 4:
+		emit(ctx, lw, r0[LO], 0, J_T8);
+#ifndef __BIG_ENDIAN
+		emit(ctx, wsbh, r0[LO], r0[LO]);
+		emit(ctx, rotr, r0[LO], r0[LO], 16);
+#endif
+		break;
+	case 2:
+		emit(ctx, lhu, r0[LO], 0, J_T8);
+#ifndef __BIG_ENDIAN
+		emit(ctx, wsbh, r0[LO], r0[LO]);
+#endif
+		break;
+	case 1:
+		emit(ctx, lbu, r0[LO], 0, J_T8);
+		break;
+	}
+	emit_zext(ctx, r0[HI]);
+}
+
+/*
+ * JITs one eBPF instruction.
+ * Returns 0 on success, 1 if the instruction took two slots (imm64),
+ * and a negative error if it could not be translated.
+ */
+static int build_insn(const struct bpf_insn *insn, struct jit_ctx *ctx)
+{
+	const u8 code = insn->code;
+	const u8 *dst = bpf2mips[insn->dst_reg];
+	const u8 *src = bpf2mips[insn->src_reg];
+	const s16 off = insn->off;
+	const s32 imm = insn->imm;
+	const int i = insn - ctx->prog->insnsi;
+	u8 base, val, val_hi;
+	s32 moff;
+
+	switch (code) {
+	/* dst = src, dst = imm */
+	case BPF_ALU | BPF_MOV | BPF_X:
+		emit_mov(ctx, dst[LO], src[LO]);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU64 | BPF_MOV | BPF_X:
+		emit_mov(ctx, dst[LO], src[LO]);
+		emit_mov(ctx, dst[HI], src[HI]);
+		break;
+	case BPF_ALU | BPF_MOV | BPF_K:
+		emit_load_imm(ctx, dst[LO], imm);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU64 | BPF_MOV | BPF_K:
+		emit_load_imm(ctx, dst[LO], imm);
+		emit_load_sext_hi(ctx, dst[HI], imm);
+		break;
+
+	/* 32-bit arithmetic, the high word is cleared */
+	case BPF_ALU | BPF_ADD | BPF_X:
+		emit(ctx, addu, dst[LO], dst[LO], src[LO]);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_SUB | BPF_X:
+		emit(ctx, subu, dst[LO], dst[LO], src[LO]);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_ADD | BPF_K:
+	case BPF_ALU | BPF_SUB | BPF_K:
+		moff = BPF_OP(code) == BPF_ADD ? imm : -(u32)imm;
+		if (is_range16(moff)) {
+			emit(ctx, addiu, dst[LO], dst[LO], moff);
+		} else {
+			emit_load_imm(ctx, J_T8, moff);
+			emit(ctx, addu, dst[LO], dst[LO], J_T8);
+		}
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_AND | BPF_X:
+		emit(ctx, and, dst[LO], dst[LO], src[LO]);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_OR | BPF_X:
+		emit(ctx, or, dst[LO], dst[LO], src[LO]);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_XOR | BPF_X:
+		emit(ctx, xor, dst[LO], dst[LO], src[LO]);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_AND | BPF_K:
+	case BPF_ALU | BPF_OR | BPF_K:
+	case BPF_ALU | BPF_XOR | BPF_K:
+		emit_logic_imm(ctx, BPF_OP(code), dst[LO], imm);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_MUL | BPF_X:
+		emit(ctx, mul, dst[LO], dst[LO], src[LO]);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_MUL | BPF_K:
+		emit_load_imm(ctx, J_T8, imm);
+		emit(ctx, mul, dst[LO], dst[LO], J_T8);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_DIV | BPF_X:
+	case BPF_ALU | BPF_MOD | BPF_X:
+	case BPF_ALU | BPF_DIV | BPF_K:
+	case BPF_ALU | BPF_MOD | BPF_K:
+		if (BPF_SRC(code) == BPF_X) {
+			/* the interpreter returns 0 on division by zero */
+			emit_zero_exit_if_zero(ctx, src[LO]);
+			val = src[LO];
+		} else {
+			emit_load_imm(ctx, J_T8, imm);
+			val = J_T8;
+		}
+		emit(ctx, divu, dst[LO], val);
+		if (BPF_OP(code) == BPF_DIV)
+			emit(ctx, mflo, dst[LO]);
+		else
+			emit(ctx, mfhi, dst[LO]);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_LSH | BPF_X:
+		emit(ctx, sllv, dst[LO], dst[LO], src[LO]);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_RSH | BPF_X:
+		emit(ctx, srlv, dst[LO], dst[LO], src[LO]);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_ARSH | BPF_X:
+		emit(ctx, srav, dst[LO], dst[LO], src[LO]);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_LSH | BPF_K:
+		emit(ctx, sll, dst[LO], dst[LO], imm & 31);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_RSH | BPF_K:
+		emit(ctx, srl, dst[LO], dst[LO], imm & 31);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_ARSH | BPF_K:
+		emit(ctx, sra, dst[LO], dst[LO], imm & 31);
+		emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU | BPF_NEG:
+		emit(ctx, subu, dst[LO], MIPS_R_ZERO, dst[LO]);
+		emit_zext(ctx, dst[HI]);
+		break;
+
+	/* 64-bit arithmetic */
+	case BPF_ALU64 | BPF_ADD | BPF_X:
+		emit(ctx, addu, J_T8, dst[LO], src[LO]);
+		emit(ctx, sltu, J_T9, J_T8, src[LO]);
+		emit(ctx, addu, dst[HI], dst[HI], src[HI]);
+		emit(ctx, addu, dst[HI], dst[HI], J_T9);
+		emit_mov(ctx, dst[LO], J_T8);
+		break;
+	case BPF_ALU64 | BPF_SUB | BPF_X:
+		emit(ctx, sltu, J_T9, dst[LO], src[LO]);
+		emit(ctx, subu, dst[LO], dst[LO], src[LO]);
+		emit(ctx, subu, dst[HI], dst[HI], src[HI]);
+		emit(ctx, subu, dst[HI], dst[HI], J_T9);
+		break;
+	case BPF_ALU64 | BPF_ADD | BPF_K:
+		emit_add64_imm(ctx, dst, (s64)imm);
+		break;
+	case BPF_ALU64 | BPF_SUB | BPF_K:
+		emit_add64_imm(ctx, dst, -(s64)imm);
+		break;
+	case BPF_ALU64 | BPF_AND | BPF_X:
+		emit(ctx, and, dst[LO], dst[LO], src[LO]);
+		emit(ctx, and, dst[HI], dst[HI], src[HI]);
+		break;
+	case BPF_ALU64 | BPF_OR | BPF_X:
+		emit(ctx, or, dst[LO], dst[LO], src[LO]);
+		emit(ctx, or, dst[HI], dst[HI], src[HI]);
+		break;
+	case BPF_ALU64 | BPF_XOR | BPF_X:
+		emit(ctx, xor, dst[LO], dst[LO], src[LO]);
+		emit(ctx, xor, dst[HI], dst[HI], src[HI]);
+		break;
+	case BPF_ALU64 | BPF_AND | BPF_K:
+		emit_logic_imm(ctx, BPF_AND, dst[LO], imm);
+		if (imm >= 0)
+			emit_zext(ctx, dst[HI]);
+		break;
+	case BPF_ALU64 | BPF_OR | BPF_K:
+		emit_logic_imm(ctx, BPF_OR, dst[LO], imm);
+		if (imm < 0)
+			emit_load_sext_hi(ctx, dst[HI], imm);
+		break;
+	case BPF_ALU64 | BPF_XOR | BPF_K:
+		emit_logic_imm(ctx, BPF_XOR, dst[LO], imm);
+		if (imm < 0) {
+			emit_load_sext_hi(ctx, J_T8, imm);
+			emit(ctx, xor, dst[HI], dst[HI], J_T8);
+		}
+		break;
+	case BPF_ALU64 | BPF_MUL | BPF_X:
+		emit_mul64(ctx, dst, src[LO], src[HI], false);
+		break;
+	case BPF_ALU64 | BPF_MUL | BPF_K:
+		emit_load_imm(ctx, J_AT, imm);
+		emit_mul64(ctx, dst, J_AT, MIPS_R_ZERO, imm < 0);
+		break;
+	case BPF_ALU64 | BPF_DIV | BPF_X:
+	case BPF_ALU64 | BPF_MOD | BPF_X:
+	case BPF_ALU64 | BPF_DIV | BPF_K:
+	case BPF_ALU64 | BPF_MOD | BPF_K:
+		emit_divmod64(ctx, insn);
+		break;
+	case BPF_ALU64 | BPF_LSH | BPF_X:
+	case BPF_ALU64 | BPF_RSH | BPF_X:
+	case BPF_ALU64 | BPF_ARSH | BPF_X:
+		emit_shift64_reg(ctx, BPF_OP(code), dst, src[LO]);
+		break;
+	case BPF_ALU64 | BPF_LSH | BPF_K:
+	case BPF_ALU64 | BPF_RSH | BPF_K:
+	case BPF_ALU64 | BPF_ARSH | BPF_K:
+		emit_shift64_imm(ctx, BPF_OP(code), dst, imm);
+		break;
+	case BPF_ALU64 | BPF_NEG:
+		emit(ctx, sltu, J_T8, MIPS_R_ZERO, dst[LO]);
+		emit(ctx, subu, dst[LO], MIPS_R_ZERO, dst[LO]);
+		emit(ctx, subu, dst[HI], MIPS_R_ZERO, dst[HI]);
+		emit(ctx, subu, dst[HI], dst[HI], J_T8);
+		break;
+
+	/* dst = htole(dst), dst = htobe(dst) */
+	case BPF_ALU | BPF_END | BPF_FROM_LE:
+	case BPF_ALU | BPF_END | BPF_FROM_BE:
+#ifdef __BIG_ENDIAN
+		if (BPF_SRC(code) == BPF_FROM_LE)
+#else
+		if (BPF_SRC(code) == BPF_FROM_BE)
+#endif
+			emit_bswap(ctx, dst, imm);
+		else if (imm == 16)
+			emit(ctx, andi, dst[LO], dst[LO], 0xffff);
+		if (imm != 64)
+			emit_zext(ctx, dst[HI]);
+		break;
+
+	/* jumps */
+	case BPF_JMP | BPF_JA:
+		emit(ctx, b, b_off(ctx, ctx->offsets[i + off + 1]));
+		emit(ctx, nop);
+		break;
+	case BPF_JMP | BPF_JEQ | BPF_X:
+	case BPF_JMP | BPF_JNE | BPF_X:
+	case BPF_JMP | BPF_JGT | BPF_X:
+	case BPF_JMP | BPF_JGE | BPF_X:
+	case BPF_JMP | BPF_JSGT | BPF_X:
+	case BPF_JMP | BPF_JSGE | BPF_X:
+	case BPF_JMP | BPF_JSET | BPF_X:
+		emit_jmp64(ctx, BPF_OP(code), dst, src[LO], src[HI],
+			   i + off + 1);
+		break;
+	case BPF_JMP | BPF_JEQ | BPF_K:
+	case BPF_JMP | BPF_JNE | BPF_K:
+	case BPF_JMP | BPF_JGT | BPF_K:
+	case BPF_JMP | BPF_JGE | BPF_K:
+	case BPF_JMP | BPF_JSGT | BPF_K:
+	case BPF_JMP | BPF_JSGE | BPF_K:
+	case BPF_JMP | BPF_JSET | BPF_K:
+		val = MIPS_R_ZERO;
+		if (imm) {
+			emit_load_imm(ctx, J_AT, imm);
+			val = J_AT;
+		}
+		val_hi = MIPS_R_ZERO;
+		if (imm < 0) {
+			emit_load_sext_hi(ctx, J_RA, imm);
+			val_hi = J_RA;
+		}
+		emit_jmp64(ctx, BPF_OP(code), dst, val, val_hi, i + off + 1);
+		break;
+
+	/* helper call */
+	case BPF_JMP | BPF_CALL:
+	{
+		int r;
+
+		/* o32 passes the 3rd to 5th 64-bit argument on the stack */
+		for (r = BPF_REG_3; r <= BPF_REG_5; r++) {
+			moff = JIT_ARGS_OFF + (r - BPF_REG_3) * 8;
+			emit(ctx, sw, bpf2mips[r][LO], moff + OFF_LO,
+			     MIPS_R_SP);
+			emit(ctx, sw, bpf2mips[r][HI], moff + OFF_HI,
+			     MIPS_R_SP);
+		}
+		emit_call(ctx, (unsigned long)__bpf_call_base + imm);
+		break;
+	}
+	case BPF_JMP | BPF_CALL | BPF_X:
+		emit_tail_call(ctx);
+		break;
+	case BPF_JMP | BPF_EXIT:
+		/* the last instruction falls through to the epilogue */
+		if (i == ctx->prog->len - 1)
+			break;
+		emit(ctx, b, b_off(ctx, ctx->epilogue));
+		emit(ctx, nop);
+		break;
+
+	/* dst = imm64 */
+	case BPF_LD | BPF_IMM | BPF_DW:
+		emit_load_imm(ctx, dst[LO], imm);
+		emit_load_imm(ctx, dst[HI], insn[1].imm);
+		return 1;
+
+	/* dst = *(size *)(src + off) */
+	case BPF_LDX | BPF_MEM | BPF_B:
+	case BPF_LDX | BPF_MEM | BPF_H:
+	case BPF_LDX | BPF_MEM | BPF_W:
+	case BPF_LDX | BPF_MEM | BPF_DW:
+		switch (BPF_SIZE(code)) {
+		case BPF_B:
+			emit(ctx, lbu, dst[LO], off, src[LO]);
+			break;
+		case BPF_H:
+			emit(ctx, lhu, dst[LO], off, src[LO]);
+			break;
+		case BPF_W:
+			emit(ctx, lw, dst[LO], off, src[LO]);
+			break;
+		case BPF_DW:
+			base = src[LO];
+			moff = off;
+			if (!is_range16(moff + 4)) {
+				emit(ctx, addiu, J_T8, base, moff);
+				base = J_T8;
+				moff = 0;
+			}
+			/* the base may be the low word of dst */
+			if (base == dst[LO]) {
+				emit(ctx, lw, dst[HI], moff + OFF_HI, base);
+				emit(ctx, lw, dst[LO], moff + OFF_LO, base);
+			} else {
+				emit(ctx, lw, dst[LO], moff + OFF_LO, base);
+				emit(ctx, lw, dst[HI], moff + OFF_HI, base);
+			}
+			break;
+		}
+		if (BPF_SIZE(code) != BPF_DW)
+			emit_zext(ctx, dst[HI]);
+		break;
+
+	/* *(size *)(dst + off) = src, *(size *)(dst + off) = imm */
+	case BPF_ST | BPF_MEM | BPF_B:
+	case BPF_ST | BPF_MEM | BPF_H:
+	case BPF_ST | BPF_MEM | BPF_W:
+	case BPF_ST | BPF_MEM | BPF_DW:
+	case BPF_STX | BPF_MEM | BPF_B:
+	case BPF_STX | BPF_MEM | BPF_H:
+	case BPF_STX | BPF_MEM | BPF_W:
+	case BPF_STX | BPF_MEM | BPF_DW:
+		if (BPF_CLASS(code) == BPF_STX) {
+			val = src[LO];
+			val_hi = src[HI];
+		} else {
+			val = MIPS_R_ZERO;
+			if (imm) {
+				emit_load_imm(ctx, J_T9, imm);
+				val = J_T9;
+			}
+			val_hi = MIPS_R_ZERO;
+			if (imm < 0) {
+				emit_load_sext_hi(ctx, J_AT, imm);
+				val_hi = J_AT;
+			}
+		}
+
+		base = dst[LO];
+		moff = off;
+		if (BPF_SIZE(code) == BPF_DW && !is_range16(moff + 4)) {
+			emit(ctx, addiu, J_T8, base, moff);
+			base = J_T8;
+			moff = 0;
+		}
+
+		switch (BPF_SIZE(code)) {
+		case BPF_B:
+			emit(ctx, sb, val, moff, base);
+			break;
+		case BPF_H:
+			emit(ctx, sh, val, moff, base);
+			break;
+		case BPF_W:
+			emit(ctx, sw, val, moff, base);
+			break;
+		case BPF_DW:
+			emit(ctx, sw, val, moff + OFF_LO, base);
+			emit(ctx, sw, val_hi, moff + OFF_HI, base);
+			break;
+		}
+		break;
+
+	/* lock *(u32 *)(dst + off) += src */
+	case BPF_STX | BPF_XADD | BPF_W:
+		emit(ctx, ll, J_T8, off, dst[LO]);
+		emit(ctx, addu, J_T8, J_T8, src[LO]);
+		emit(ctx, sc, J_T8, off, dst[LO]);
+		emit(ctx, beq, J_T8, MIPS_R_ZERO, -4 * 4);
+		emit(ctx, nop);
+		break;
+	/* lock *(u64 *)(dst + off) += src, no 64-bit ll/sc on MIPS32 */
+	case BPF_STX | BPF_XADD | BPF_DW:
+	{
+		const u8 *r1 = bpf2mips[BPF_REG_1];
+
+		emit_spill(ctx, -1, false);
+		emit(ctx, addiu, J_T8, dst[LO], off);
+		emit_mov(ctx, J_T9, src[HI]);
+		emit_mov(ctx, r1[LO], src[LO]);
+		emit_mov(ctx, r1[HI], J_T9);
+		emit_mov(ctx, MIPS_R_A2, J_T8);
+		emit_call(ctx, (unsigned long)atomic64_add);
+		emit_spill(ctx, -1, true);
+		break;
+	}
+
+	/* R0 = ntohx(*(size *)(((struct sk_buff *)R6)->data + imm [+ src])) */
+	case BPF_LD | BPF_ABS | BPF_W:
+	case BPF_LD | BPF_ABS | BPF_H:
+	case BPF_LD | BPF_ABS | BPF_B:
+	case BPF_LD | BPF_IND | BPF_W:
+	case BPF_LD | BPF_IND | BPF_H:
+	case BPF_LD | BPF_IND | BPF_B:
+		if (BPF_MODE(code) == BPF_IND && is_range16(imm)) {
+			emit(ctx, addiu, J_AT, src[LO], imm);
+		} else {
+			emit_load_imm(ctx, J_AT, imm);
+			if (BPF_MODE(code) == BPF_IND)
+				emit(ctx, addu, J_AT, J_AT, src[LO]);
+		}
+		switch (BPF_SIZE(code)) {
+		case BPF_W:
+			emit_ld_skb(ctx, 4);
+			break;
+		case BPF_H:
+			emit_ld_skb(ctx, 2);
+			break;
+		case BPF_B:
+			emit_ld_skb(ctx, 1);
+			break;
+		}
+		break;
+
+	default:
+		pr_debug("%s: unhandled opcode 0x%02x\n", __FILE__, code);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int build_body(struct jit_ctx *ctx)
+{
+	const struct bpf_prog *prog = ctx->prog;
+	int i, ret;
+
+	for (i = 0; i < prog->len; i++) {
+		ctx->offsets[i] = ctx->idx;
+		ret = build_insn(&prog->insnsi[i], ctx);
+		if (ret < 0)
+			return ret;
+		if (ret > 0) {
+			i++;
+			ctx->offsets[i] = ctx->idx;
+		}
+	}
+	/* jumps past the last instruction land on the epilogue */
+	ctx->offsets[i] = ctx->idx;
+
+	return 0;
+}
+
+struct bpf_prog *bpf_int_jit_compile(struct bpf_prog *prog)
+{
+	struct bpf_prog *tmp, *orig_prog = prog;
+	struct bpf_binary_header *header;
+	bool tmp_blinded = false;
+	struct jit_ctx ctx;
+	unsigned int image_size;
+	u8 *image_ptr;
+
+	if (!bpf_jit_enable || IS_ENABLED(CONFIG_CPU_MICROMIPS))
+		return orig_prog;
+
+	tmp = bpf_jit_blind_constants(prog);
+	/*
+	 * If blinding was requested and we failed during blinding,
+	 * we must fall back to the interpreter.
+	 */
+	if (IS_ERR(tmp))
+		return orig_prog;
+	if (tmp != prog) {
+		tmp_blinded = true;
+		prog = tmp;
+	}
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.prog = prog;
+
+	ctx.offsets = kcalloc(prog->len + 1, sizeof(*ctx.offsets), GFP_KERNEL);
+	if (ctx.offsets == NULL) {
+		prog = orig_prog;
+		goto out;
+	}
+
+	/* 1. Sizing pass, fills in the offsets */
+	build_prologue(&ctx);
+	if (ctx.idx * 4 != JIT_TAIL_OFFSET) {
+		pr_err_once("%s: tail call offset %u, expected %u\n",
+			    __FILE__, ctx.idx * 4, JIT_TAIL_OFFSET);
+		prog = orig_prog;
+		goto out_off;
+	}
+	if (build_body(&ctx)) {
+		prog = orig_prog;
+		goto out_off;
+	}
+	build_epilogue(&ctx);
+
+	image_size = ctx.idx * 4;
+	header = bpf_jit_binary_alloc(image_size, &image_ptr, sizeof(u32),
+				      bpf_jit_fill_hole);
+	if (header == NULL) {
+		prog = orig_prog;
+		goto out_off;
+	}
+
+	/* 2. Now generate the code */
+	ctx.image = (u32 *)image_ptr;
+	ctx.idx = 0;
+	ctx.bad_branch = false;
+	build_prologue(&ctx);
+	build_body(&ctx);
+	build_epilogue(&ctx);
+
+	/* Programs too large for 16-bit branch offsets use the interpreter */
+	if (ctx.bad_branch) {
+		bpf_jit_binary_free(header);
+		prog = orig_prog;
+		goto out_off;
+	}
+
+	flush_icache_range((unsigned long)header,
+			   (unsigned long)(ctx.image + ctx.idx));
+
+	if (bpf_jit_enable > 1)
+		bpf_jit_dump(prog->len, image_size, 2, ctx.image);
+
+	prog->bpf_func = (void *)ctx.image;
+	prog->jited = 1;
+
+out_off:
+	kfree(ctx.offsets);
+out:
+	if (tmp_blinded)
+		bpf_jit_prog_release_other(prog, prog == orig_prog ?
+					   tmp : orig_prog);
+	return prog;
+}
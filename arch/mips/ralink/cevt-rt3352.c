@@ -17,6 +17,7 @@
 #include <linux/of_address.h>
 
 #include <asm/mach-ralink/ralink_regs.h>
+#include <asm/vdso.h>
 
 #define SYSTICK_FREQ		(50 * 1000)
 
@@ -164,6 +165,71 @@ static int systick_set_oneshot(struct clock_event_device *evt)
 	return 0;
 }
 
+/* physical address of the count register, 0 if not mapped into the vdso */
+static phys_addr_t systick_count_phys;
+
+static cycle_t systick_read(struct clocksource *cs)
+{
+	return read_count(&systick);
+}
+
+static struct clocksource systick_cs = {
+	.read		= systick_read,
+	.mask		= CLOCKSOURCE_MASK(16),
+	.flags		= CLOCK_SOURCE_IS_CONTINUOUS,
+};
+
+int plat_vdso_get_usm_range(struct resource *range)
+{
+	if (!systick_count_phys)
+		return -ENODEV;
+
+	range->start = systick_count_phys;
+	range->end = systick_count_phys + sizeof(u32) - 1;
+	range->flags = IORESOURCE_MEM;
+
+	return 0;
+}
+
+/*
+ * Mapping the count register into userspace exposes its whole page, so
+ * every process can read the registers of any other device in it, and
+ * some of those have read side effects. Only allow it if no other enabled
+ * device has registers there, unless the board accepts that.
+ */
+static bool __init systick_page_private(struct device_node *np,
+					phys_addr_t addr)
+{
+	phys_addr_t page = addr & PAGE_MASK;
+	struct device_node *node, *parent;
+	struct resource res;
+	int i;
+
+	for_each_node_with_property(node, "reg") {
+		if (node == np || !of_device_is_available(node))
+			continue;
+
+		/* the buses the systick sits on cover it anyway */
+		parent = of_get_parent(np);
+		while (parent && parent != node)
+			parent = of_get_next_parent(parent);
+		of_node_put(parent);
+		if (parent)
+			continue;
+
+		for (i = 0; !of_address_to_resource(node, i, &res); i++) {
+			if (res.start < page + PAGE_SIZE && res.end >= page) {
+				pr_warn("%s: page shared with %s, not mapped into the vdso\n",
+					np->name, node->full_name);
+				of_node_put(node);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
 static const struct of_device_id systick_match[] = {
 	{ .compatible = "ralink,mt7620a-systick", .data = mt7620_freq_scaling},
 	{},
@@ -172,6 +238,7 @@ static const struct of_device_id systick_match[] = {
 static int __init ralink_systick_init(struct device_node *np)
 {
 	const struct of_device_id *match;
+	struct resource res;
 	int rating = 200;
 	int ret;
 
@@ -191,8 +258,31 @@ static int __init ralink_systick_init(struct device_node *np)
 
 	/* enable counter than register clock source */
 	iowrite32(CFG_CNT_EN, systick.membase + SYSTICK_CONFIG);
-	clocksource_mmio_init(systick.membase + SYSTICK_COUNT, np->name,
-			SYSTICK_FREQ, rating, 16, clocksource_mmio_readl_up);
+	/*
+	 * The counter is readable from userspace once its page is mapped,
+	 * which lets the vdso use it when it is the active clocksource.
+	 * Boards opt in, and only get it if the page holds nothing else or
+	 * they also accept exposing the rest of the page. On MT7620/MT7628
+	 * the systick shares its page with sysc, intc and memc, so they
+	 * need both properties.
+	 */
+	if (of_property_read_bool(np, "ralink,vdso") &&
+	    !of_address_to_resource(np, 0, &res)) {
+		if (of_property_read_bool(np, "ralink,vdso-shared-page")) {
+			pr_warn("%s: page at %pa is readable by all processes\n",
+				np->name, &res.start);
+			systick_count_phys = res.start + SYSTICK_COUNT;
+		} else if (systick_page_private(np, res.start + SYSTICK_COUNT)) {
+			systick_count_phys = res.start + SYSTICK_COUNT;
+		}
+		if (systick_count_phys)
+			systick_cs.archdata.vdso_clock_mode =
+				VDSO_CLOCK_SYSTICK;
+	}
+
+	systick_cs.name = np->name;
+	systick_cs.rating = rating;
+	clocksource_register_hz(&systick_cs, SYSTICK_FREQ);
 
 	/* register clock event */
 	systick.dev.irq = irq_of_parse_and_map(np, 0);
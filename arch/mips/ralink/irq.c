@@ -9,14 +9,19 @@
 
 #include <linux/io.h>
 #include <linux/bitops.h>
+#include <linux/debugfs.h>
 #include <linux/of_platform.h>
 #include <linux/of_address.h>
 #include <linux/of_irq.h>
 #include <linux/irqdomain.h>
 #include <linux/interrupt.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
 
+#include <asm/debug.h>
 #include <asm/irq_cpu.h>
 #include <asm/mipsregs.h>
+#include <asm/time.h>
 
 #include "common.h"
 
@@ -36,6 +41,9 @@
 
 #define RALINK_INTC_IRQ_PERFC   (RALINK_INTC_IRQ_BASE + 9)
 
+/* sources dispatched per exception before the others get a chance */
+#define RALINK_INTC_BUDGET	16
+
 enum rt_intc_regs_enum {
 	INTC_REG_STATUS0 = 0,
 	INTC_REG_STATUS1,
@@ -58,6 +66,32 @@ static void __iomem *rt_intc_membase;
 
 static int rt_perfcount_irq;
 
+/*
+ * Sources listed here are dispatched first, in this order, the others by
+ * ascending bit number. Set from the "ralink,intc-priority" DT property
+ * and debugfs (mips/intc_priority).
+ */
+static u32 rt_intc_prio[RALINK_INTC_IRQ_COUNT];
+static unsigned int rt_intc_prio_count;
+static u32 rt_intc_prio_mask;
+
+/*
+ * Times in count register ticks. The latency of a source runs from the
+ * exception entry, or for one that came up while others were handled,
+ * from the last status read that didn't show it yet.
+ */
+struct rt_intc_stats {
+	unsigned long count;
+	u64 time;
+	u32 max_latency;
+};
+
+static struct rt_intc_stats rt_intc_stats[RALINK_INTC_IRQ_COUNT];
+/* the CPU lines, by IP number, including the INTC cascade on IP2 */
+static struct rt_intc_stats rt_cpu_stats[8];
+/* when the line being dispatched was last seen not pending */
+static u32 rt_cpu_since;
+
 static inline void rt_intc_w32(u32 val, unsigned reg)
 {
 	__raw_writel(val, rt_intc_membase + rt_intc_regs[reg]);
@@ -85,8 +119,17 @@ static struct irq_chip ralink_intc_irq_chip = {
 	.irq_mask_ack	= ralink_intc_irq_mask,
 };
 
+/*
+ * R2 cores name the CPU line the counter overflow is merged into in
+ * IntCtl.IPPCI, on the 24K that is the timer's IP7. Cause.PCI tells the
+ * two apart, so the PMU shares the line. Only the older cores without it
+ * go through the INTC.
+ */
 int get_c0_perfcount_int(void)
 {
+	if (cpu_has_mips_r2_r6 && cp0_perfcount_irq >= 2)
+		return MIPS_CPU_IRQ_BASE + cp0_perfcount_irq;
+
 	return rt_perfcount_irq;
 }
 EXPORT_SYMBOL_GPL(get_c0_perfcount_int);
@@ -96,41 +139,148 @@ unsigned int get_c0_compare_int(void)
 	return CP0_LEGACY_COMPARE_IRQ;
 }
 
-static void ralink_intc_irq_handler(struct irq_desc *desc)
+static int rt_intc_set_prio(const u32 *prio, unsigned int count)
 {
-	u32 pending = rt_intc_r32(INTC_REG_STATUS0);
+	unsigned long flags;
+	u32 mask = 0;
+	unsigned int i;
+
+	if (count > RALINK_INTC_IRQ_COUNT)
+		return -EINVAL;
+
+	for (i = 0; i < count; i++) {
+		if (prio[i] >= RALINK_INTC_IRQ_COUNT || (mask & BIT(prio[i])))
+			return -EINVAL;
+		mask |= BIT(prio[i]);
+	}
+
+	/* the SoCs using this INTC are single core */
+	local_irq_save(flags);
+	memcpy(rt_intc_prio, prio, count * sizeof(*prio));
+	rt_intc_prio_count = count;
+	rt_intc_prio_mask = mask;
+	local_irq_restore(flags);
+
+	return 0;
+}
+
+static inline unsigned int rt_intc_next(u32 pending)
+{
+	unsigned int i;
+
+	if (pending & rt_intc_prio_mask)
+		for (i = 0; i < rt_intc_prio_count; i++)
+			if (pending & BIT(rt_intc_prio[i]))
+				return rt_intc_prio[i];
+
+	return __ffs(pending);
+}
 
-	if (pending) {
-		struct irq_domain *domain = irq_desc_get_handler_data(desc);
-		generic_handle_irq(irq_find_mapping(domain, __ffs(pending)));
-	} else {
+static inline void rt_irq_account(struct rt_intc_stats *st, u32 since,
+				  u32 now)
+{
+	u32 lat = now - since;
+
+	if (lat > st->max_latency)
+		st->max_latency = lat;
+	st->count++;
+}
+
+/*
+ * Dispatch everything pending instead of one source per exception. The
+ * status is read again after each handler, so a higher priority source
+ * that came up meanwhile goes before the lower ones still waiting.
+ */
+static void ralink_intc_irq_handler(struct irq_desc *desc)
+{
+	struct irq_domain *domain = irq_desc_get_handler_data(desc);
+	u32 seen[RALINK_INTC_IRQ_COUNT];
+	u32 pending, waiting = 0, fresh, last, now;
+	struct rt_intc_stats *st;
+	unsigned int hwirq, budget = RALINK_INTC_BUDGET;
+
+	last = rt_cpu_since;
+	pending = rt_intc_r32(INTC_REG_STATUS0);
+	if (!pending) {
 		spurious_interrupt();
+		return;
 	}
+
+	do {
+		for (fresh = pending & ~waiting; fresh; fresh &= fresh - 1)
+			seen[__ffs(fresh)] = last;
+
+		hwirq = rt_intc_next(pending);
+		waiting = pending & ~BIT(hwirq);
+
+		st = &rt_intc_stats[hwirq];
+		now = read_c0_count();
+		rt_irq_account(st, seen[hwirq], now);
+		generic_handle_irq(irq_find_mapping(domain, hwirq));
+		last = read_c0_count();
+		st->time += last - now;
+
+		pending = rt_intc_r32(INTC_REG_STATUS0);
+	} while (pending && --budget);
 }
 
+static void ralink_cpu_irq(unsigned int line, u32 since)
+{
+	struct rt_intc_stats *st = &rt_cpu_stats[line];
+	u32 now = read_c0_count();
+
+	rt_irq_account(st, since, now);
+	rt_cpu_since = since;
+	do_IRQ(MIPS_CPU_IRQ_BASE + line);
+	st->time += read_c0_count() - now;
+}
+
+/*
+ * Keep handling the highest priority pending CPU line until none is left,
+ * instead of taking an exception for each.
+ */
 asmlinkage void plat_irq_dispatch(void)
 {
-	unsigned long pending;
+	unsigned int budget = RALINK_INTC_BUDGET;
+	unsigned long pending, waiting = 0, fresh;
+	unsigned int line;
+	u32 seen[8], last;
 
+	/* whatever is pending now was raised before the exception */
+	last = read_c0_count();
 	pending = read_c0_status() & read_c0_cause() & ST0_IM;
+	do {
+		for (fresh = (pending & ~waiting) >> CAUSEB_IP; fresh;
+		     fresh &= fresh - 1)
+			seen[__ffs(fresh)] = last;
 
-	if (pending & STATUSF_IP7)
-		do_IRQ(RALINK_CPU_IRQ_COUNTER);
+		if (pending & STATUSF_IP7)
+			line = RALINK_CPU_IRQ_COUNTER - MIPS_CPU_IRQ_BASE;
 
-	else if (pending & STATUSF_IP5)
-		do_IRQ(RALINK_CPU_IRQ_FE);
+		else if (pending & STATUSF_IP5)
+			line = RALINK_CPU_IRQ_FE - MIPS_CPU_IRQ_BASE;
 
-	else if (pending & STATUSF_IP6)
-		do_IRQ(RALINK_CPU_IRQ_WIFI);
+		else if (pending & STATUSF_IP6)
+			line = RALINK_CPU_IRQ_WIFI - MIPS_CPU_IRQ_BASE;
 
-	else if (pending & STATUSF_IP4)
-		do_IRQ(RALINK_CPU_IRQ_PCI);
+		else if (pending & STATUSF_IP4)
+			line = RALINK_CPU_IRQ_PCI - MIPS_CPU_IRQ_BASE;
 
-	else if (pending & STATUSF_IP2)
-		do_IRQ(RALINK_CPU_IRQ_INTC);
+		else if (pending & STATUSF_IP2)
+			line = RALINK_CPU_IRQ_INTC - MIPS_CPU_IRQ_BASE;
 
-	else
-		spurious_interrupt();
+		else {
+			if (budget == RALINK_INTC_BUDGET)
+				spurious_interrupt();
+			break;
+		}
+
+		waiting = pending & ~(STATUSF_IP0 << line);
+		ralink_cpu_irq(line, seen[line]);
+
+		last = read_c0_count();
+		pending = read_c0_status() & read_c0_cause() & ST0_IM;
+	} while (pending && --budget);
 }
 
 static int intc_map(struct irq_domain *d, unsigned int irq, irq_hw_number_t hw)
@@ -148,14 +298,22 @@ static const struct irq_domain_ops irq_domain_ops = {
 static int __init intc_of_init(struct device_node *node,
 			       struct device_node *parent)
 {
+	u32 prio[RALINK_INTC_IRQ_COUNT];
 	struct resource res;
 	struct irq_domain *domain;
-	int irq;
+	int irq, count;
 
 	if (!of_property_read_u32_array(node, "ralink,intc-registers",
 					rt_intc_regs, 6))
 		pr_info("intc: using register map from devicetree\n");
 
+	count = of_property_count_u32_elems(node, "ralink,intc-priority");
+	if (count > 0 && (count > RALINK_INTC_IRQ_COUNT ||
+	    of_property_read_u32_array(node, "ralink,intc-priority", prio,
+				       count) ||
+	    rt_intc_set_prio(prio, count)))
+		pr_err("intc: invalid ralink,intc-priority\n");
+
 	irq = irq_of_parse_and_map(node, 0);
 	if (!irq)
 		panic("Failed to get INTC IRQ");
@@ -193,6 +351,151 @@ static int __init intc_of_init(struct device_node *node,
 	return 0;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static u64 intc_ticks_to_ns(u64 ticks)
+{
+	ticks *= 1000;
+	do_div(ticks, max(mips_hpt_frequency / 1000000, 1U));
+
+	return ticks;
+}
+
+static void intc_stats_line(struct seq_file *m, const char *name,
+			    unsigned int hwirq, unsigned int irq,
+			    const struct rt_intc_stats *st)
+{
+	u64 time, avg;
+
+	time = intc_ticks_to_ns(st->time);
+	avg = time;
+	do_div(avg, st->count);
+	do_div(time, 1000);
+
+	seq_printf(m, "%3s%2u %5u %10lu %11llu %8llu %16llu\n", name, hwirq,
+		   irq, st->count, time, avg,
+		   intc_ticks_to_ns(st->max_latency));
+}
+
+/*
+ * CPU lines first, "ip2" being the INTC cascade with all of its sources,
+ * then the INTC sources. Latencies count from the exception entry.
+ */
+static int intc_stats_show(struct seq_file *m, void *v)
+{
+	unsigned int i;
+
+	seq_puts(m, "hwirq   irq      count    time(us)  avg(ns)  max latency(ns)\n");
+	for (i = 0; i < ARRAY_SIZE(rt_cpu_stats); i++)
+		if (rt_cpu_stats[i].count)
+			intc_stats_line(m, "ip", i, MIPS_CPU_IRQ_BASE + i,
+					&rt_cpu_stats[i]);
+
+	for (i = 0; i < RALINK_INTC_IRQ_COUNT; i++)
+		if (rt_intc_stats[i].count)
+			intc_stats_line(m, "", i, RALINK_INTC_IRQ_BASE + i,
+					&rt_intc_stats[i]);
+
+	return 0;
+}
+
+static int intc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, intc_stats_show, NULL);
+}
+
+/* any write clears the statistics */
+static ssize_t intc_stats_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	memset(rt_intc_stats, 0, sizeof(rt_intc_stats));
+	memset(rt_cpu_stats, 0, sizeof(rt_cpu_stats));
+	local_irq_restore(flags);
+
+	return count;
+}
+
+static const struct file_operations intc_stats_fops = {
+	.open		= intc_stats_open,
+	.read		= seq_read,
+	.write		= intc_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int intc_priority_show(struct seq_file *m, void *v)
+{
+	unsigned int i;
+
+	for (i = 0; i < rt_intc_prio_count; i++)
+		seq_printf(m, "%s%u", i ? " " : "", rt_intc_prio[i]);
+	seq_putc(m, '\n');
+
+	return 0;
+}
+
+static int intc_priority_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, intc_priority_show, NULL);
+}
+
+/* space separated hwirq numbers, highest priority first */
+static ssize_t intc_priority_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	u32 prio[RALINK_INTC_IRQ_COUNT];
+	unsigned int n = 0;
+	char kbuf[128], *p, *tok;
+	int ret;
+
+	if (count >= sizeof(kbuf))
+		return -EINVAL;
+	if (copy_from_user(kbuf, buf, count))
+		return -EFAULT;
+	kbuf[count] = '\0';
+
+	p = strim(kbuf);
+	while ((tok = strsep(&p, " ,")) != NULL) {
+		if (!*tok)
+			continue;
+		if (n == RALINK_INTC_IRQ_COUNT)
+			return -EINVAL;
+		ret = kstrtou32(tok, 0, &prio[n++]);
+		if (ret)
+			return ret;
+	}
+
+	ret = rt_intc_set_prio(prio, n);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations intc_priority_fops = {
+	.open		= intc_priority_open,
+	.read		= seq_read,
+	.write		= intc_priority_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init intc_debugfs_init(void)
+{
+	if (!mips_debugfs_dir || !rt_intc_membase)
+		return 0;
+
+	if (!debugfs_create_file("intc_stats", 0644, mips_debugfs_dir, NULL,
+				 &intc_stats_fops) ||
+	    !debugfs_create_file("intc_priority", 0644, mips_debugfs_dir, NULL,
+				 &intc_priority_fops))
+		return -ENOMEM;
+
+	return 0;
+}
+device_initcall(intc_debugfs_init);
+#endif
+
 static struct of_device_id __initdata of_irq_ids[] = {
 	{ .compatible = "mti,cpu-interrupt-controller", .data = mips_cpu_irq_of_init },
 	{ .compatible = "ralink,rt2880-intc", .data = intc_of_init },
@@ -87,7 +87,16 @@ void __init plat_mem_setup(void)
 	 * Load the builtin devicetree. This causes the chosen node to be
 	 * parsed resulting in our memory appearing
 	 */
+#ifdef CONFIG_XIP_KERNEL
+	if (fw_passed_dtb)
+		__dt_setup_arch((void *)fw_passed_dtb);
+	else if (__dtb_start != __dtb_end)
+		__dt_setup_arch(__dtb_start);
+	else
+		panic("no devicetree for the XIP kernel");
+#else
 	__dt_setup_arch(&__image_dtb);
+#endif
 
 	of_scan_flat_dt(early_init_dt_find_chosen, NULL);
 	if (chosen_dtb)
@@ -94,6 +94,21 @@ static __always_inline u64 read_gic_count(const union mips_vdso_data *data)
 
 #endif
 
+#ifdef CONFIG_CLKEVT_RT3352
+
+/*
+ * The systick count is only 16 bits wide and wraps every 1.3s at 50kHz.
+ * Masking the delta with cs_mask below copes with one wrap, and the
+ * clocksource mask keeps the timekeeper from going longer than that
+ * without refreshing cs_cycle_last, so a single read is enough here.
+ */
+static __always_inline u64 read_systick_count(const union mips_vdso_data *data)
+{
+	return __raw_readl(get_systick(data));
+}
+
+#endif
+
 static __always_inline u64 get_ns(const union mips_vdso_data *data)
 {
 	u64 cycle_now, delta, nsec;
@@ -108,6 +123,11 @@ static __always_inline u64 get_ns(const union mips_vdso_data *data)
 	case VDSO_CLOCK_GIC:
 		cycle_now = read_gic_count(data);
 		break;
+#endif
+#ifdef CONFIG_CLKEVT_RT3352
+	case VDSO_CLOCK_SYSTICK:
+		cycle_now = read_systick_count(data);
+		break;
 #endif
 	default:
 		return 0;
@@ -86,4 +86,14 @@ static inline void __iomem *get_gic(const union mips_vdso_data *data)
 
 #endif /* CONFIG_CLKSRC_MIPS_GIC */
 
+#ifdef CONFIG_CLKEVT_RT3352
+
+/* The systick page takes the slot of the GIC page, they never coexist. */
+static inline void __iomem *get_systick(const union mips_vdso_data *data)
+{
+	return (void __iomem *)data - PAGE_SIZE + data->counter_offset;
+}
+
+#endif /* CONFIG_CLKEVT_RT3352 */
+
 #endif /* __ASSEMBLY__ */
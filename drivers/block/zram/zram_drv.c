@@ -31,6 +31,9 @@
 #include <linux/err.h>
 #include <linux/idr.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
 
 #include "zram_drv.h"
 
@@ -375,6 +378,80 @@ static ssize_t comp_algorithm_store(struct device *dev,
 	return len;
 }
 
+static ssize_t recomp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->recomp_algorithm, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t recomp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char compressor[CRYPTO_MAX_ALG_NAME];
+	size_t sz;
+
+	strlcpy(compressor, buf, sizeof(compressor));
+	/* ignore trailing newline */
+	sz = strlen(compressor);
+	if (sz > 0 && compressor[sz - 1] == '\n')
+		compressor[sz - 1] = 0x00;
+
+	/* an empty string disables recompression */
+	if (compressor[0] && !zcomp_available_algorithm(compressor))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+
+	strlcpy(zram->recomp_algorithm, compressor, sizeof(compressor));
+	up_write(&zram->init_lock);
+	return len;
+}
+
+static ssize_t recomp_idle_secs_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n",
+			READ_ONCE(zram->recomp_idle_secs));
+}
+
+static ssize_t recomp_idle_secs_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned int secs;
+	int err;
+
+	err = kstrtouint(buf, 10, &secs);
+	if (err)
+		return err;
+	if (secs > INT_MAX / HZ)
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	WRITE_ONCE(zram->recomp_idle_secs, secs);
+	/* restart the wait with the new period */
+	if (zram->recomp_task)
+		wake_up_process(zram->recomp_task);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
 static ssize_t compact_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
@@ -402,11 +479,17 @@ static ssize_t io_stat_show(struct device *dev,
 
 	down_read(&zram->init_lock);
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8llu\n",
+			"%8llu %8llu %8llu %8llu %8llu %8llu %8llu %8llu %8llu %8llu\n",
 			(u64)atomic64_read(&zram->stats.failed_reads),
 			(u64)atomic64_read(&zram->stats.failed_writes),
 			(u64)atomic64_read(&zram->stats.invalid_io),
-			(u64)atomic64_read(&zram->stats.notify_free));
+			(u64)atomic64_read(&zram->stats.notify_free),
+			(u64)atomic64_read(&zram->stats.num_decomp[0]),
+			(u64)atomic64_read(&zram->stats.decomp_nsecs[0]),
+			(u64)atomic64_read(&zram->stats.num_decomp[1]),
+			(u64)atomic64_read(&zram->stats.decomp_nsecs[1]),
+			(u64)atomic64_read(&zram->stats.num_recomp),
+			(u64)atomic64_read(&zram->stats.recomp_nsecs));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -433,14 +516,16 @@ static ssize_t mm_stat_show(struct device *dev,
 	max_used = atomic_long_read(&zram->stats.max_used_pages);
 
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu\n",
+			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu\n",
 			orig_size << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.compr_data_size),
 			mem_used << PAGE_SHIFT,
 			zram->limit_pages << PAGE_SHIFT,
 			max_used << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.zero_pages),
-			pool_stats.pages_compacted);
+			pool_stats.pages_compacted,
+			(u64)atomic64_read(&zram->stats.recomp_pages),
+			(u64)atomic64_read(&zram->stats.recomp_data_size));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -546,6 +631,9 @@ static void zram_free_page(struct zram *zram, size_t index)
 	struct zram_meta *meta = zram->meta;
 	unsigned long handle = meta->table[index].handle;
 
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	zram_clear_flag(meta, index, ZRAM_NORECOMP);
+
 	if (unlikely(!handle)) {
 		/*
 		 * No memory is allocated for zero filled pages.
@@ -564,6 +652,13 @@ static void zram_free_page(struct zram *zram, size_t index)
 			&zram->stats.compr_data_size);
 	atomic64_dec(&zram->stats.pages_stored);
 
+	if (zram_test_flag(meta, index, ZRAM_RECOMP)) {
+		zram_clear_flag(meta, index, ZRAM_RECOMP);
+		atomic64_sub(zram_get_obj_size(meta, index),
+				&zram->stats.recomp_data_size);
+		atomic64_dec(&zram->stats.recomp_pages);
+	}
+
 	meta->table[index].handle = 0;
 	zram_set_obj_size(meta, index, 0);
 }
@@ -590,10 +685,18 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	if (size == PAGE_SIZE) {
 		memcpy(mem, cmem, PAGE_SIZE);
 	} else {
-		struct zcomp_strm *zstrm = zcomp_stream_get(zram->comp);
+		bool recomp = zram_test_flag(meta, index, ZRAM_RECOMP);
+		struct zcomp *comp = recomp ? zram->recomp : zram->comp;
+		struct zcomp_strm *zstrm;
+		ktime_t start = ktime_get();
 
+		zstrm = zcomp_stream_get(comp);
 		ret = zcomp_decompress(zstrm, cmem, size, mem);
-		zcomp_stream_put(zram->comp);
+		zcomp_stream_put(comp);
+
+		atomic64_inc(&zram->stats.num_decomp[recomp]);
+		atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)),
+				&zram->stats.decomp_nsecs[recomp]);
 	}
 	zs_unmap_object(meta->mem_pool, handle);
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
@@ -617,6 +720,7 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	page = bvec->bv_page;
 
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	zram_clear_flag(meta, index, ZRAM_IDLE);
 	if (unlikely(!meta->table[index].handle) ||
 			zram_test_flag(meta, index, ZRAM_ZERO)) {
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
@@ -1021,10 +1125,153 @@ out:
 	return err;
 }
 
+/*
+ * Compress the page again with the recompression algorithm if it has not
+ * been accessed since the previous pass, or mark it so that the next pass
+ * can tell. Returns false when the pass has to stop.
+ */
+static bool zram_recompress_page(struct zram *zram, u32 index, void *buf)
+{
+	struct zram_meta *meta = zram->meta;
+	struct zcomp_strm *zstrm;
+	unsigned long handle, new_handle;
+	unsigned int size, clen;
+	unsigned char *cmem;
+	ktime_t start;
+	int ret = 0;
+
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	handle = meta->table[index].handle;
+	if (!handle || zram_test_flag(meta, index, ZRAM_RECOMP) ||
+			zram_test_flag(meta, index, ZRAM_NORECOMP)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return true;
+	}
+	if (!zram_test_flag(meta, index, ZRAM_IDLE)) {
+		zram_set_flag(meta, index, ZRAM_IDLE);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return true;
+	}
+
+	size = zram_get_obj_size(meta, index);
+	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_RO);
+	if (size == PAGE_SIZE) {
+		memcpy(buf, cmem, PAGE_SIZE);
+	} else {
+		zstrm = zcomp_stream_get(zram->comp);
+		ret = zcomp_decompress(zstrm, cmem, size, buf);
+		zcomp_stream_put(zram->comp);
+	}
+	zs_unmap_object(meta->mem_pool, handle);
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+	/* the read path reports it */
+	if (unlikely(ret))
+		return true;
+
+	start = ktime_get();
+	zstrm = zcomp_stream_get(zram->recomp);
+	ret = zcomp_compress(zstrm, buf, &clen);
+	atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)),
+			&zram->stats.recomp_nsecs);
+
+	new_handle = 0;
+	if (!ret && clen < size && clen <= max_zpage_size) {
+		new_handle = zs_malloc(meta->mem_pool, clen,
+				__GFP_KSWAPD_RECLAIM |
+				__GFP_NOWARN |
+				__GFP_HIGHMEM |
+				__GFP_MOVABLE);
+		if (!new_handle) {
+			/* no point going on for now, try on the next pass */
+			zcomp_stream_put(zram->recomp);
+			return false;
+		}
+
+		cmem = zs_map_object(meta->mem_pool, new_handle, ZS_MM_WO);
+		memcpy(cmem, zstrm->buffer, clen);
+		zs_unmap_object(meta->mem_pool, new_handle);
+	}
+	zcomp_stream_put(zram->recomp);
+
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	/* accessed or rewritten in the meantime */
+	if (meta->table[index].handle != handle ||
+			!zram_test_flag(meta, index, ZRAM_IDLE)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		if (new_handle)
+			zs_free(meta->mem_pool, new_handle);
+		return true;
+	}
+
+	if (!new_handle) {
+		zram_set_flag(meta, index, ZRAM_NORECOMP);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return true;
+	}
+
+	zs_free(meta->mem_pool, handle);
+	meta->table[index].handle = new_handle;
+	zram_set_obj_size(meta, index, clen);
+	zram_set_flag(meta, index, ZRAM_RECOMP);
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+	atomic64_sub(size - clen, &zram->stats.compr_data_size);
+	atomic64_add(clen, &zram->stats.recomp_data_size);
+	atomic64_inc(&zram->stats.recomp_pages);
+	atomic64_inc(&zram->stats.num_recomp);
+
+	return true;
+}
+
+/*
+ * Every recomp_idle_secs, recompress the pages that stayed idle since the
+ * previous pass. The thread is SCHED_IDLE, so the passes only use the CPU
+ * time nobody else wants. It is stopped by zram_reset_device() before the
+ * meta data goes away.
+ */
+static int zram_recomp_thread(void *data)
+{
+	struct zram *zram = data;
+	struct sched_param param = { .sched_priority = 0 };
+	size_t num_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned int secs;
+	size_t index;
+	void *buf;
+
+	sched_setscheduler_nocheck(current, SCHED_IDLE, &param);
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+
+	while (!kthread_should_stop()) {
+		secs = READ_ONCE(zram->recomp_idle_secs);
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (kthread_should_stop()) {
+			__set_current_state(TASK_RUNNING);
+			break;
+		}
+		/* woken up early, the period has changed */
+		if (schedule_timeout(secs ? secs * HZ : MAX_SCHEDULE_TIMEOUT))
+			continue;
+		if (!buf || !READ_ONCE(zram->recomp_idle_secs))
+			continue;
+
+		for (index = 0; index < num_pages; index++) {
+			if (kthread_should_stop() ||
+					!zram_recompress_page(zram, index, buf))
+				break;
+			cond_resched();
+		}
+	}
+
+	kfree(buf);
+	return 0;
+}
+
 static void zram_reset_device(struct zram *zram)
 {
 	struct zram_meta *meta;
-	struct zcomp *comp;
+	struct zcomp *comp, *recomp;
 	u64 disksize;
 
 	down_write(&zram->init_lock);
@@ -1036,8 +1283,15 @@ static void zram_reset_device(struct zram *zram)
 		return;
 	}
 
+	if (zram->recomp_task) {
+		kthread_stop(zram->recomp_task);
+		zram->recomp_task = NULL;
+	}
+
 	meta = zram->meta;
 	comp = zram->comp;
+	recomp = zram->recomp;
+	zram->recomp = NULL;
 	disksize = zram->disksize;
 	/*
 	 * Refcount will go down to 0 eventually and r/w handler
@@ -1062,13 +1316,16 @@ static void zram_reset_device(struct zram *zram)
 	/* I/O operation under all of CPU are done so let's free */
 	zram_meta_free(meta, disksize);
 	zcomp_destroy(comp);
+	if (recomp)
+		zcomp_destroy(recomp);
 }
 
 static ssize_t disksize_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	u64 disksize;
-	struct zcomp *comp;
+	struct zcomp *comp, *recomp = NULL;
+	struct task_struct *recomp_task = NULL;
 	struct zram_meta *meta;
 	struct zram *zram = dev_to_zram(dev);
 	int err;
@@ -1097,19 +1354,43 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_destroy_comp;
 	}
 
+	if (zram->recomp_algorithm[0]) {
+		recomp = zcomp_create(zram->recomp_algorithm);
+		if (IS_ERR(recomp)) {
+			pr_err("Cannot initialise %s recompressing backend\n",
+					zram->recomp_algorithm);
+			err = PTR_ERR(recomp);
+			recomp = NULL;
+			goto out_destroy_comp;
+		}
+
+		recomp_task = kthread_create(zram_recomp_thread, zram,
+				"%s_recomp", zram->disk->disk_name);
+		if (IS_ERR(recomp_task)) {
+			err = PTR_ERR(recomp_task);
+			goto out_destroy_comp;
+		}
+	}
+
 	init_waitqueue_head(&zram->io_done);
 	atomic_set(&zram->refcount, 1);
 	zram->meta = meta;
 	zram->comp = comp;
+	zram->recomp = recomp;
+	zram->recomp_task = recomp_task;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
 	zram_revalidate_disk(zram);
+	if (recomp_task)
+		wake_up_process(recomp_task);
 	up_write(&zram->init_lock);
 
 	return len;
 
 out_destroy_comp:
 	up_write(&zram->init_lock);
+	if (recomp)
+		zcomp_destroy(recomp);
 	zcomp_destroy(comp);
 out_free_meta:
 	zram_meta_free(meta, disksize);
@@ -1193,6 +1474,8 @@ static DEVICE_ATTR_RW(mem_limit);
 static DEVICE_ATTR_RW(mem_used_max);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+static DEVICE_ATTR_RW(recomp_algorithm);
+static DEVICE_ATTR_RW(recomp_idle_secs);
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
@@ -1213,6 +1496,8 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_mem_used_max.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_recomp_idle_secs.attr,
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
 	&dev_attr_debug_stat.attr,
@@ -63,6 +63,9 @@ enum zram_pageflags {
 	/* Page consists entirely of zeros */
 	ZRAM_ZERO = ZRAM_FLAG_SHIFT,
 	ZRAM_ACCESS,	/* page is now accessed */
+	ZRAM_IDLE,	/* not accessed since the last recompression pass */
+	ZRAM_RECOMP,	/* compressed with the recompression algorithm */
+	ZRAM_NORECOMP,	/* recompression did not make it smaller */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -87,6 +90,13 @@ struct zram_stats {
 	atomic64_t pages_stored;	/* no. of pages currently stored */
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
 	atomic64_t writestall;		/* no. of write slow paths */
+	atomic64_t recomp_pages;	/* no. of pages stored recompressed */
+	atomic64_t recomp_data_size;	/* compressed size of those pages */
+	atomic64_t num_recomp;		/* no. of pages recompressed */
+	atomic64_t recomp_nsecs;	/* time spent recompressing */
+	/* decompressions and their time, for the primary and recomp algorithm */
+	atomic64_t num_decomp[2];
+	atomic64_t decomp_nsecs[2];
 };
 
 struct zram_meta {
@@ -115,6 +125,14 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 	char compressor[CRYPTO_MAX_ALG_NAME];
+	/*
+	 * Pages not accessed for recomp_idle_secs are compressed again
+	 * with recomp_algorithm by recomp_task, when the CPU is idle.
+	 */
+	struct zcomp *recomp;
+	struct task_struct *recomp_task;
+	unsigned int recomp_idle_secs;
+	char recomp_algorithm[CRYPTO_MAX_ALG_NAME];
 	/*
 	 * zram is claimed so open request will be failed
 	 */
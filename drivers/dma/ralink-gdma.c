@@ -22,6 +22,11 @@
 #include <linux/of_dma.h>
 #include <linux/reset.h>
 #include <linux/of_device.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/dma/ralink-gdma.h>
 
 #include "virt-dma.h"
 
@@ -110,6 +115,34 @@ struct gdma_dma_desc {
 	struct gdma_dma_sg sg[];
 };
 
+/* period jitter histogram, log2 microsecond buckets */
+#define GDMA_HIST_SIZE		16
+
+struct gdma_dma_stats {
+	u32 segments;
+	u32 chained;
+	u32 restarts;
+	u32 underrun;
+	u32 lat_max;
+	u32 lat_cnt;
+	u64 lat_total;
+
+	/* cyclic only, change of the period length from one to the next */
+	ktime_t last_period;
+	s64 last_interval;
+	u32 periods;
+	u32 jitter_max;
+	u32 early[GDMA_HIST_SIZE];
+	u32 late[GDMA_HIST_SIZE];
+};
+
+/*
+ * A channel may be paired with a second hardware channel. Segments then
+ * alternate between the two: while one runs, the other is programmed
+ * masked and gets unmasked by the hardware (NEXT field) when the running
+ * one is done, so consecutive segments continue without waiting for the
+ * irq and tasklet. The partner is reserved and can't be requested.
+ */
 struct gdma_dmaengine_chan {
 	struct virt_dma_chan vchan;
 	unsigned int id;
@@ -120,6 +153,15 @@ struct gdma_dmaengine_chan {
 
 	struct gdma_dma_desc *desc;
 	unsigned int next_sg;
+	unsigned int done_sg;
+
+	struct gdma_dmaengine_chan *chain;
+	bool chain_slave;
+	bool hw_busy;
+	bool hw_counted;
+	ktime_t done_ts;
+
+	struct gdma_dma_stats stats;
 };
 
 struct gdma_dma_dev {
@@ -131,6 +173,9 @@ struct gdma_dma_dev {
 	volatile unsigned long chan_issued;
 	atomic_t cnt;
 
+	struct dentry *dbg_dir;
+	struct dentry *dbg_stats;
+
 	struct gdma_dmaengine_chan chan[];
 };
 
@@ -139,7 +184,8 @@ struct gdma_data
 	int chancnt;
 	u32 done_int_reg;
 	void (*init)(struct gdma_dma_dev *dma_dev);
-	int (*start_transfer)(struct gdma_dmaengine_chan *chan);
+	int (*start_transfer)(struct gdma_dmaengine_chan *chan,
+			struct gdma_dmaengine_chan *hw, bool masked);
 };
 
 static struct gdma_dma_dev *gdma_dma_chan_get_dev(
@@ -230,31 +276,32 @@ static int gdma_dma_config(struct dma_chan *c,
 	return 0;
 }
 
-static int gdma_dma_terminate_all(struct dma_chan *c)
+/* must be called with the owner's vchan lock held */
+static void gdma_dma_hw_idle(struct gdma_dma_dev *dma_dev,
+		struct gdma_dmaengine_chan *hw)
 {
-	struct gdma_dmaengine_chan *chan = to_gdma_dma_chan(c);
-	struct gdma_dma_dev *dma_dev = gdma_dma_chan_get_dev(chan);
-	unsigned long flags, timeout;
-	LIST_HEAD(head);
-	int i = 0;
-
-	spin_lock_irqsave(&chan->vchan.lock, flags);
-	chan->desc = NULL;
-	clear_bit(chan->id, &dma_dev->chan_issued);
-	vchan_get_all_descriptors(&chan->vchan, &head);
-	spin_unlock_irqrestore(&chan->vchan.lock, flags);
+	hw->hw_busy = false;
+	if (hw->hw_counted) {
+		hw->hw_counted = false;
+		atomic_dec(&dma_dev->cnt);
+	}
+}
 
-	vchan_dma_desc_free_list(&chan->vchan, &head);
+static void gdma_dma_wait_idle(struct gdma_dma_dev *dma_dev,
+		struct gdma_dmaengine_chan *hw)
+{
+	unsigned long timeout;
+	int i = 0;
 
 	/* wait dma transfer complete */
 	timeout = jiffies + msecs_to_jiffies(5000);
-	while (gdma_dma_read(dma_dev, GDMA_REG_CTRL0(chan->id)) &
+	while (gdma_dma_read(dma_dev, GDMA_REG_CTRL0(hw->id)) &
 			GDMA_REG_CTRL0_ENABLE) {
 		if (time_after_eq(jiffies, timeout)) {
 			dev_err(dma_dev->ddev.dev, "chan %d wait timeout\n",
-					chan->id);
+					hw->id);
 			/* restore to init value */
-			gdma_dma_write(dma_dev, GDMA_REG_CTRL0(chan->id), 0);
+			gdma_dma_write(dma_dev, GDMA_REG_CTRL0(hw->id), 0);
 			break;
 		}
 		cpu_relax();
@@ -263,7 +310,47 @@ static int gdma_dma_terminate_all(struct dma_chan *c)
 
 	if (i)
 		dev_dbg(dma_dev->ddev.dev, "terminate chan %d loops %d\n",
-				chan->id, i);
+				hw->id, i);
+}
+
+static int gdma_dma_terminate_all(struct dma_chan *c)
+{
+	struct gdma_dmaengine_chan *chan = to_gdma_dma_chan(c);
+	struct gdma_dma_dev *dma_dev = gdma_dma_chan_get_dev(chan);
+	unsigned long flags;
+	LIST_HEAD(head);
+
+	spin_lock_irqsave(&chan->vchan.lock, flags);
+	chan->desc = NULL;
+	clear_bit(chan->id, &dma_dev->chan_issued);
+	if (chan->chain)
+		clear_bit(chan->chain->id, &dma_dev->chan_issued);
+	vchan_get_all_descriptors(&chan->vchan, &head);
+	spin_unlock_irqrestore(&chan->vchan.lock, flags);
+
+	vchan_dma_desc_free_list(&chan->vchan, &head);
+
+	/*
+	 * a masked chained segment never gets unmasked once its partner
+	 * is stopped, so it is only cleared by the wait timeout. kill it
+	 * right away instead.
+	 */
+	if (chan->chain && (gdma_dma_read(dma_dev,
+			GDMA_REG_CTRL1(chan->chain->id)) & GDMA_REG_CTRL1_MASK))
+		gdma_dma_write(dma_dev, GDMA_REG_CTRL0(chan->chain->id), 0);
+	if (gdma_dma_read(dma_dev, GDMA_REG_CTRL1(chan->id)) &
+			GDMA_REG_CTRL1_MASK)
+		gdma_dma_write(dma_dev, GDMA_REG_CTRL0(chan->id), 0);
+
+	gdma_dma_wait_idle(dma_dev, chan);
+	if (chan->chain)
+		gdma_dma_wait_idle(dma_dev, chan->chain);
+
+	spin_lock_irqsave(&chan->vchan.lock, flags);
+	gdma_dma_hw_idle(dma_dev, chan);
+	if (chan->chain)
+		gdma_dma_hw_idle(dma_dev, chan->chain);
+	spin_unlock_irqrestore(&chan->vchan.lock, flags);
 
 	return 0;
 }
@@ -280,7 +367,8 @@ static void rt305x_dump_reg(struct gdma_dma_dev *dma_dev, int id)
 			gdma_dma_read(dma_dev, GDMA_RT305X_STATUS_SIGNAL));
 }
 
-static int rt305x_gdma_start_transfer(struct gdma_dmaengine_chan *chan)
+static int rt305x_gdma_start_transfer(struct gdma_dmaengine_chan *chan,
+		struct gdma_dmaengine_chan *hw, bool masked)
 {
 	struct gdma_dma_dev *dma_dev = gdma_dma_chan_get_dev(chan);
 	dma_addr_t src_addr, dst_addr;
@@ -288,11 +376,11 @@ static int rt305x_gdma_start_transfer(struct gdma_dmaengine_chan *chan)
 	uint32_t ctrl0, ctrl1;
 
 	/* verify chan is already stopped */
-	ctrl0 = gdma_dma_read(dma_dev, GDMA_REG_CTRL0(chan->id));
+	ctrl0 = gdma_dma_read(dma_dev, GDMA_REG_CTRL0(hw->id));
 	if (unlikely(ctrl0 & GDMA_REG_CTRL0_ENABLE)) {
 		dev_err(dma_dev->ddev.dev, "chan %d is start(%08x).\n",
-				chan->id, ctrl0);
-		rt305x_dump_reg(dma_dev, chan->id);
+				hw->id, ctrl0);
+		rt305x_dump_reg(dma_dev, hw->id);
 		return -EINVAL;
 	}
 
@@ -328,16 +416,20 @@ static int rt305x_gdma_start_transfer(struct gdma_dmaengine_chan *chan)
 	ctrl0 |= (sg->len << GDMA_REG_CTRL0_TX_SHIFT) | \
 		 (chan->burst_size << GDMA_REG_CTRL0_BURST_SHIFT) | \
 		 GDMA_REG_CTRL0_DONE_INT | GDMA_REG_CTRL0_ENABLE;
-	ctrl1 = chan->id << GDMA_REG_CTRL1_NEXT_SHIFT;
+	/* done unmasks the chained partner, or itself when not chained */
+	ctrl1 = (hw->chain ? hw->chain->id : hw->id) <<
+		GDMA_RT305X_CTRL1_NEXT_SHIFT;
+	if (masked)
+		ctrl1 |= GDMA_REG_CTRL1_MASK;
 
 	chan->next_sg++;
-	gdma_dma_write(dma_dev, GDMA_REG_SRC_ADDR(chan->id), src_addr);
-	gdma_dma_write(dma_dev, GDMA_REG_DST_ADDR(chan->id), dst_addr);
-	gdma_dma_write(dma_dev, GDMA_REG_CTRL1(chan->id), ctrl1);
+	gdma_dma_write(dma_dev, GDMA_REG_SRC_ADDR(hw->id), src_addr);
+	gdma_dma_write(dma_dev, GDMA_REG_DST_ADDR(hw->id), dst_addr);
+	gdma_dma_write(dma_dev, GDMA_REG_CTRL1(hw->id), ctrl1);
 
 	/* make sure next_sg is update */
 	wmb();
-	gdma_dma_write(dma_dev, GDMA_REG_CTRL0(chan->id), ctrl0);
+	gdma_dma_write(dma_dev, GDMA_REG_CTRL0(hw->id), ctrl0);
 
 	return 0;
 }
@@ -358,7 +450,8 @@ static void rt3883_dump_reg(struct gdma_dma_dev *dma_dev, int id)
 			gdma_dma_read(dma_dev, GDMA_REG_FINSTS));
 }
 
-static int rt3883_gdma_start_transfer(struct gdma_dmaengine_chan *chan)
+static int rt3883_gdma_start_transfer(struct gdma_dmaengine_chan *chan,
+		struct gdma_dmaengine_chan *hw, bool masked)
 {
 	struct gdma_dma_dev *dma_dev = gdma_dma_chan_get_dev(chan);
 	dma_addr_t src_addr, dst_addr;
@@ -366,11 +459,11 @@ static int rt3883_gdma_start_transfer(struct gdma_dmaengine_chan *chan)
 	uint32_t ctrl0, ctrl1;
 
 	/* verify chan is already stopped */
-	ctrl0 = gdma_dma_read(dma_dev, GDMA_REG_CTRL0(chan->id));
+	ctrl0 = gdma_dma_read(dma_dev, GDMA_REG_CTRL0(hw->id));
 	if (unlikely(ctrl0 & GDMA_REG_CTRL0_ENABLE)) {
 		dev_err(dma_dev->ddev.dev, "chan %d is start(%08x).\n",
-				chan->id, ctrl0);
-		rt3883_dump_reg(dma_dev, chan->id);
+				hw->id, ctrl0);
+		rt3883_dump_reg(dma_dev, hw->id);
 		return -EINVAL;
 	}
 
@@ -404,24 +497,117 @@ static int rt3883_gdma_start_transfer(struct gdma_dmaengine_chan *chan)
 	ctrl0 |= (sg->len << GDMA_REG_CTRL0_TX_SHIFT) | \
 		 (chan->burst_size << GDMA_REG_CTRL0_BURST_SHIFT) | \
 		 GDMA_REG_CTRL0_DONE_INT | GDMA_REG_CTRL0_ENABLE;
-	ctrl1 |= chan->id << GDMA_REG_CTRL1_NEXT_SHIFT;
+	/* done unmasks the chained partner, or itself when not chained */
+	ctrl1 |= (hw->chain ? hw->chain->id : hw->id) <<
+		GDMA_REG_CTRL1_NEXT_SHIFT;
+	if (masked)
+		ctrl1 |= GDMA_REG_CTRL1_MASK;
 
 	chan->next_sg++;
-	gdma_dma_write(dma_dev, GDMA_REG_SRC_ADDR(chan->id), src_addr);
-	gdma_dma_write(dma_dev, GDMA_REG_DST_ADDR(chan->id), dst_addr);
-	gdma_dma_write(dma_dev, GDMA_REG_CTRL1(chan->id), ctrl1);
+	gdma_dma_write(dma_dev, GDMA_REG_SRC_ADDR(hw->id), src_addr);
+	gdma_dma_write(dma_dev, GDMA_REG_DST_ADDR(hw->id), dst_addr);
+	gdma_dma_write(dma_dev, GDMA_REG_CTRL1(hw->id), ctrl1);
 
 	/* make sure next_sg is update */
 	wmb();
-	gdma_dma_write(dma_dev, GDMA_REG_CTRL0(chan->id), ctrl0);
+	gdma_dma_write(dma_dev, GDMA_REG_CTRL0(hw->id), ctrl0);
 
 	return 0;
 }
 
-static inline int gdma_start_transfer(struct gdma_dma_dev *dma_dev,
-		struct gdma_dmaengine_chan *chan)
+static int gdma_start_transfer(struct gdma_dma_dev *dma_dev,
+		struct gdma_dmaengine_chan *chan,
+		struct gdma_dmaengine_chan *hw, bool masked)
+{
+	int ret;
+
+	ret = dma_dev->data->start_transfer(chan, hw, masked);
+	if (ret)
+		return ret;
+
+	if (chan->desc->cyclic && chan->next_sg == chan->desc->num_sgs)
+		chan->next_sg = 0;
+	hw->hw_busy = true;
+	/* masked segments are continuations, don't count them as starts */
+	if (!masked) {
+		hw->hw_counted = true;
+		atomic_inc(&dma_dev->cnt);
+	}
+
+	return 0;
+}
+
+static bool gdma_more_sgs(struct gdma_dmaengine_chan *chan)
+{
+	return chan->desc->cyclic || chan->next_sg < chan->desc->num_sgs;
+}
+
+static void gdma_update_latency(struct gdma_dmaengine_chan *chan,
+		struct gdma_dmaengine_chan *hw)
+{
+	u32 lat;
+
+	if (!ktime_to_ns(hw->done_ts))
+		return;
+
+	lat = ktime_to_ns(ktime_sub(ktime_get(), hw->done_ts));
+	hw->done_ts = ktime_set(0, 0);
+	chan->stats.lat_total += lat;
+	chan->stats.lat_cnt++;
+	if (lat > chan->stats.lat_max)
+		chan->stats.lat_max = lat;
+}
+
+/*
+ * queue the next segment of a chained channel on hw, masked behind the
+ * segment running on the other channel of the pair. If that one already
+ * finished, its unmask went nowhere and the segment is started by hand.
+ */
+static void gdma_chain_transfer(struct gdma_dma_dev *dma_dev,
+		struct gdma_dmaengine_chan *chan,
+		struct gdma_dmaengine_chan *hw)
+{
+	u32 ctrl1;
+
+	if (gdma_start_transfer(dma_dev, chan, hw, true))
+		return;
+
+	if (gdma_dma_read(dma_dev, GDMA_REG_CTRL0(hw->chain->id)) &
+			GDMA_REG_CTRL0_ENABLE) {
+		chan->stats.chained++;
+		return;
+	}
+
+	ctrl1 = gdma_dma_read(dma_dev, GDMA_REG_CTRL1(hw->id));
+	if (ctrl1 & GDMA_REG_CTRL1_MASK)
+		gdma_dma_write(dma_dev, GDMA_REG_CTRL1(hw->id),
+				ctrl1 & ~GDMA_REG_CTRL1_MASK);
+	chan->stats.underrun++;
+}
+
+/* must be called with the owner's vchan lock held */
+static void gdma_issue_transfer(struct gdma_dma_dev *dma_dev,
+		struct gdma_dmaengine_chan *chan,
+		struct gdma_dmaengine_chan *hw)
 {
-	return dma_dev->data->start_transfer(chan);
+	gdma_update_latency(chan, hw);
+
+	if (!chan->chain) {
+		chan->stats.restarts++;
+		gdma_start_transfer(dma_dev, chan, chan, false);
+		return;
+	}
+
+	if (!chan->hw_busy && !chan->chain->hw_busy) {
+		/* new descriptor, prime both channels of the pair */
+		chan->stats.restarts++;
+		if (gdma_start_transfer(dma_dev, chan, chan, false))
+			return;
+		if (gdma_more_sgs(chan))
+			gdma_chain_transfer(dma_dev, chan, chan->chain);
+	} else if (!hw->hw_busy && gdma_more_sgs(chan)) {
+		gdma_chain_transfer(dma_dev, chan, hw);
+	}
 }
 
 static int gdma_next_desc(struct gdma_dmaengine_chan *chan)
@@ -435,40 +621,83 @@ static int gdma_next_desc(struct gdma_dmaengine_chan *chan)
 	}
 	chan->desc = to_gdma_dma_desc(vdesc);
 	chan->next_sg = 0;
+	chan->done_sg = 0;
+	chan->stats.last_period = ktime_set(0, 0);
+	chan->stats.last_interval = 0;
 
 	return 1;
 }
 
+/*
+ * Called at the end of every period of a cyclic descriptor, with the
+ * time the irq came in. The nominal period isn't known here, so the
+ * jitter is how much a period differs from the one before it.
+ */
+static void gdma_update_jitter(struct gdma_dmaengine_chan *chan,
+		ktime_t now)
+{
+	struct gdma_dma_stats *stats = &chan->stats;
+	s64 interval, delta;
+	u32 us;
+
+	if (ktime_to_ns(stats->last_period)) {
+		interval = ktime_to_ns(ktime_sub(now, stats->last_period));
+		if (stats->last_interval) {
+			delta = interval - stats->last_interval;
+			us = div_u64(abs(delta), NSEC_PER_USEC);
+			if (us > stats->jitter_max)
+				stats->jitter_max = us;
+			us = us ? min_t(u32, ilog2(us) + 1,
+					GDMA_HIST_SIZE - 1) : 0;
+			if (delta < 0)
+				stats->early[us]++;
+			else
+				stats->late[us]++;
+			stats->periods++;
+		}
+		stats->last_interval = interval;
+	}
+	stats->last_period = now;
+}
+
 static void gdma_dma_chan_irq(struct gdma_dma_dev *dma_dev,
-		struct gdma_dmaengine_chan *chan)
+		struct gdma_dmaengine_chan *hw, ktime_t now)
 {
+	struct gdma_dmaengine_chan *chan;
+	struct gdma_dmaengine_chan *issue;
 	struct gdma_dma_desc *desc;
 	unsigned long flags;
-	int chan_issued;
 
-	chan_issued = 0;
+	chan = hw->chain_slave ? hw->chain : hw;
+	issue = NULL;
 	spin_lock_irqsave(&chan->vchan.lock, flags);
+	gdma_dma_hw_idle(dma_dev, hw);
 	desc = chan->desc;
 	if (desc) {
+		chan->stats.segments++;
 		if (desc->cyclic) {
+			gdma_update_jitter(chan, now);
 			vchan_cyclic_callback(&desc->vdesc);
-			if (chan->next_sg == desc->num_sgs)
-				chan->next_sg = 0;
-			chan_issued = 1;
+			if (++chan->done_sg == desc->num_sgs)
+				chan->done_sg = 0;
+			issue = hw;
 		} else {
-			desc->residue -= desc->sg[chan->next_sg - 1].len;
-			if (chan->next_sg == desc->num_sgs) {
+			desc->residue -= desc->sg[chan->done_sg++].len;
+			if (chan->done_sg == desc->num_sgs) {
 				list_del(&desc->vdesc.node);
 				vchan_cookie_complete(&desc->vdesc);
-				chan_issued = gdma_next_desc(chan);
-			} else
-				chan_issued = 1;
+				if (gdma_next_desc(chan))
+					issue = chan;
+			} else if (chan->next_sg < desc->num_sgs)
+				issue = hw;
 		}
 	} else
 		dev_dbg(dma_dev->ddev.dev, "chan %d no desc to complete\n",
-				chan->id);
-	if (chan_issued)
-		set_bit(chan->id, &dma_dev->chan_issued);
+				hw->id);
+	if (issue) {
+		issue->done_ts = now;
+		set_bit(issue->id, &dma_dev->chan_issued);
+	}
 	spin_unlock_irqrestore(&chan->vchan.lock, flags);
 }
 
@@ -477,6 +706,7 @@ static irqreturn_t gdma_dma_irq(int irq, void *devid)
 	struct gdma_dma_dev *dma_dev = devid;
 	u32 done, done_reg;
 	unsigned int i;
+	ktime_t now;
 
 	done_reg = dma_dev->data->done_int_reg;
 	done = gdma_dma_read(dma_dev, done_reg);
@@ -486,12 +716,11 @@ static irqreturn_t gdma_dma_irq(int irq, void *devid)
 	/* clean done bits */
 	gdma_dma_write(dma_dev, done_reg, done);
 
+	now = ktime_get();
 	i = 0;
 	while (done) {
-		if (done & 0x1) {
-			gdma_dma_chan_irq(dma_dev, &dma_dev->chan[i]);
-			atomic_dec(&dma_dev->cnt);
-		}
+		if (done & 0x1)
+			gdma_dma_chan_irq(dma_dev, &dma_dev->chan[i], now);
 		done >>= 1;
 		i++;
 	}
@@ -528,8 +757,16 @@ static struct dma_async_tx_descriptor *gdma_dma_prep_slave_sg(
 {
 	struct gdma_dmaengine_chan *chan = to_gdma_dma_chan(c);
 	struct gdma_dma_desc *desc;
+	struct gdma_dma_sg *hw_sg;
 	struct scatterlist *sg;
-	unsigned int i;
+	dma_addr_t addr;
+	unsigned int i, n;
+
+	if (direction != DMA_MEM_TO_DEV && direction != DMA_DEV_TO_MEM) {
+		dev_err(c->device->dev, "direction type %d error\n",
+				direction);
+		return NULL;
+	}
 
 	desc = gdma_dma_alloc_desc(sg_len);
 	if (!desc) {
@@ -538,27 +775,37 @@ static struct dma_async_tx_descriptor *gdma_dma_prep_slave_sg(
 	}
 	desc->residue = 0;
 
+	n = 0;
+	hw_sg = NULL;
 	for_each_sg(sgl, sg, sg_len, i) {
-		if (direction == DMA_MEM_TO_DEV)
-			desc->sg[i].src_addr = sg_dma_address(sg);
-		else if (direction == DMA_DEV_TO_MEM)
-			desc->sg[i].dst_addr = sg_dma_address(sg);
-		else {
-			dev_err(c->device->dev, "direction type %d error\n",
-					direction);
-			goto free_desc;
-		}
-
 		if (unlikely(sg_dma_len(sg) > GDMA_REG_CTRL0_TX_MASK)) {
 			dev_err(c->device->dev, "sg len too large %d\n",
 					sg_dma_len(sg));
 			goto free_desc;
 		}
-		desc->sg[i].len = sg_dma_len(sg);
+		addr = sg_dma_address(sg);
 		desc->residue += sg_dma_len(sg);
+
+		/* merge physically contiguous entries into one segment */
+		if (hw_sg && hw_sg->len + sg_dma_len(sg) <=
+				GDMA_REG_CTRL0_TX_MASK &&
+				((direction == DMA_MEM_TO_DEV &&
+				  hw_sg->src_addr + hw_sg->len == addr) ||
+				 (direction == DMA_DEV_TO_MEM &&
+				  hw_sg->dst_addr + hw_sg->len == addr))) {
+			hw_sg->len += sg_dma_len(sg);
+			continue;
+		}
+
+		hw_sg = &desc->sg[n++];
+		if (direction == DMA_MEM_TO_DEV)
+			hw_sg->src_addr = addr;
+		else
+			hw_sg->dst_addr = addr;
+		hw_sg->len = sg_dma_len(sg);
 	}
 
-	desc->num_sgs = sg_len;
+	desc->num_sgs = n;
 	desc->direction = direction;
 	desc->cyclic = false;
 
@@ -687,7 +934,7 @@ static enum dma_status gdma_dma_tx_status(struct dma_chan *c,
 		 */
 		if (desc->cyclic)
 			state->residue = desc->residue -
-				((chan->next_sg - 1) * desc->sg[0].len);
+				(chan->done_sg * desc->sg[0].len);
 		else
 			state->residue = desc->residue;
 	} else if ((vdesc = vchan_find_desc(&chan->vchan, cookie)))
@@ -699,6 +946,17 @@ static enum dma_status gdma_dma_tx_status(struct dma_chan *c,
 	return status;
 }
 
+static int gdma_dma_alloc_chan_resources(struct dma_chan *c)
+{
+	struct gdma_dmaengine_chan *chan = to_gdma_dma_chan(c);
+
+	/* reserved as the second half of a chained pair */
+	if (chan->chain_slave)
+		return -EBUSY;
+
+	return 0;
+}
+
 static void gdma_dma_free_chan_resources(struct dma_chan *c)
 {
 	vchan_free_chan_resources(to_virt_chan(c));
@@ -712,9 +970,10 @@ static void gdma_dma_desc_free(struct virt_dma_desc *vdesc)
 static void gdma_dma_tasklet(unsigned long arg)
 {
 	struct gdma_dma_dev *dma_dev = (struct gdma_dma_dev *)arg;
-	struct gdma_dmaengine_chan *chan;
+	struct gdma_dmaengine_chan *chan, *hw;
 	static unsigned int last_chan;
 	unsigned int i, chan_mask;
+	unsigned long flags;
 
 	/* record last chan to round robin all chans */
 	i = last_chan;
@@ -732,12 +991,14 @@ static void gdma_dma_tasklet(unsigned long arg)
 		}
 
 		if (test_and_clear_bit(i, &dma_dev->chan_issued)) {
-			chan = &dma_dev->chan[i];
-			if (chan->desc) {
-				atomic_inc(&dma_dev->cnt);
-				gdma_start_transfer(dma_dev, chan);
-			} else
+			hw = &dma_dev->chan[i];
+			chan = hw->chain_slave ? hw->chain : hw;
+			spin_lock_irqsave(&chan->vchan.lock, flags);
+			if (chan->desc)
+				gdma_issue_transfer(dma_dev, chan, hw);
+			else
 				dev_dbg(dma_dev->ddev.dev, "chan %d no desc to issue\n", chan->id);
+			spin_unlock_irqrestore(&chan->vchan.lock, flags);
 
 			if (!dma_dev->chan_issued)
 				break;
@@ -789,6 +1050,168 @@ static struct gdma_data rt3883_gdma_data = {
 	.start_transfer = rt3883_gdma_start_transfer,
 };
 
+#if IS_ENABLED(CONFIG_DEBUG_FS)
+static void gdma_dma_chan_jitter_show(struct seq_file *s,
+		struct gdma_dmaengine_chan *chan)
+{
+	unsigned int j;
+
+	seq_printf(s, "%u\t%u\t%u\n", chan->id,
+			chan->stats.periods, chan->stats.jitter_max);
+	seq_puts(s, "\tjitter(us)\tearly\tlate\n");
+	for (j = 0; j < GDMA_HIST_SIZE; j++) {
+		if (!chan->stats.early[j] && !chan->stats.late[j])
+			continue;
+		seq_printf(s, "\t< %u\t\t%u\t%u\n", 1 << j,
+				chan->stats.early[j],
+				chan->stats.late[j]);
+	}
+}
+
+void gdma_dma_jitter_show(struct seq_file *s, struct dma_chan *c)
+{
+	struct gdma_dmaengine_chan *chan;
+
+	if (c->device->device_prep_dma_cyclic != gdma_dma_prep_dma_cyclic)
+		return;
+
+	chan = to_gdma_dma_chan(c);
+	seq_puts(s, "chan\tperiods\tjitter max(us)\n");
+	gdma_dma_chan_jitter_show(s, chan);
+}
+EXPORT_SYMBOL_GPL(gdma_dma_jitter_show);
+
+static int gdma_dma_stats_show(struct seq_file *s, void *unused)
+{
+	struct gdma_dma_dev *dma_dev = s->private;
+	struct gdma_dmaengine_chan *chan;
+	unsigned int i;
+
+	seq_puts(s, "chan\tpair\tsegments\tchained\trestarts\tunderrun" \
+			"\tlat avg(ns)\tlat max(ns)\n");
+	for (i = 0; i < dma_dev->data->chancnt; i++) {
+		chan = &dma_dev->chan[i];
+		if (chan->chain_slave)
+			continue;
+
+		seq_printf(s, "%u\t", chan->id);
+		if (chan->chain)
+			seq_printf(s, "%u", chan->chain->id);
+		else
+			seq_puts(s, "-");
+		seq_printf(s, "\t%u\t%u\t%u\t%u\t%llu\t%u\n",
+				chan->stats.segments, chan->stats.chained,
+				chan->stats.restarts, chan->stats.underrun,
+				chan->stats.lat_cnt ?
+				div_u64(chan->stats.lat_total,
+					chan->stats.lat_cnt) : 0,
+				chan->stats.lat_max);
+	}
+
+	seq_puts(s, "\nchan\tperiods\tjitter max(us)\n");
+	for (i = 0; i < dma_dev->data->chancnt; i++) {
+		chan = &dma_dev->chan[i];
+		if (chan->chain_slave || !chan->stats.periods)
+			continue;
+
+		gdma_dma_chan_jitter_show(s, chan);
+	}
+
+	return 0;
+}
+
+static int gdma_dma_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, gdma_dma_stats_show, inode->i_private);
+}
+
+static const struct file_operations gdma_dma_stats_ops = {
+	.open = gdma_dma_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static inline int gdma_dma_debugfs_create(struct gdma_dma_dev *dma_dev)
+{
+	dma_dev->dbg_dir = debugfs_create_dir(dev_name(dma_dev->ddev.dev),
+			NULL);
+	if (!dma_dev->dbg_dir)
+		return -ENOMEM;
+
+	dma_dev->dbg_stats = debugfs_create_file("stats", S_IRUGO,
+			dma_dev->dbg_dir, dma_dev, &gdma_dma_stats_ops);
+	if (!dma_dev->dbg_stats) {
+		debugfs_remove(dma_dev->dbg_dir);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static inline void gdma_dma_debugfs_remove(struct gdma_dma_dev *dma_dev)
+{
+	debugfs_remove(dma_dev->dbg_stats);
+	debugfs_remove(dma_dev->dbg_dir);
+}
+#else
+static inline int gdma_dma_debugfs_create(struct gdma_dma_dev *dma_dev)
+{
+	return 0;
+}
+
+static inline void gdma_dma_debugfs_remove(struct gdma_dma_dev *dma_dev)
+{
+}
+#endif
+
+/*
+ * "ralink,chain-pairs" lists <chan partner> tuples. The partner channel
+ * is taken over by chan for hardware chaining of consecutive segments.
+ */
+static int gdma_dma_setup_chains(struct gdma_dma_dev *dma_dev,
+		struct device_node *np)
+{
+	struct gdma_dmaengine_chan *chan, *partner;
+	u32 id, pid;
+	int i, cnt;
+
+	cnt = of_property_count_u32_elems(np, "ralink,chain-pairs");
+	if (cnt <= 0)
+		return 0;
+	if (cnt % 2) {
+		dev_err(dma_dev->ddev.dev, "invalid chain-pairs\n");
+		return -EINVAL;
+	}
+
+	for (i = 0; i < cnt; i += 2) {
+		of_property_read_u32_index(np, "ralink,chain-pairs", i, &id);
+		of_property_read_u32_index(np, "ralink,chain-pairs", i + 1,
+				&pid);
+		if (id >= dma_dev->data->chancnt ||
+				pid >= dma_dev->data->chancnt || id == pid) {
+			dev_err(dma_dev->ddev.dev, "invalid chain pair %u %u\n",
+					id, pid);
+			return -EINVAL;
+		}
+
+		chan = &dma_dev->chan[id];
+		partner = &dma_dev->chan[pid];
+		if (chan->chain || partner->chain) {
+			dev_err(dma_dev->ddev.dev, "chan %u or %u already chained\n",
+					id, pid);
+			return -EINVAL;
+		}
+		chan->chain = partner;
+		partner->chain = chan;
+		partner->chain_slave = true;
+		dev_info(dma_dev->ddev.dev, "chan %u chained with %u\n",
+				id, pid);
+	}
+
+	return 0;
+}
+
 static const struct of_device_id gdma_of_match_table[] = {
 	{ .compatible = "ralink,rt305x-gdma", .data = &rt305x_gdma_data },
 	{ .compatible = "ralink,rt3883-gdma", .data = &rt3883_gdma_data },
@@ -851,6 +1274,7 @@ static int gdma_dma_probe(struct platform_device *pdev)
 	dma_cap_set(DMA_MEMCPY, dd->cap_mask);
 	dma_cap_set(DMA_SLAVE, dd->cap_mask);
 	dma_cap_set(DMA_CYCLIC, dd->cap_mask);
+	dd->device_alloc_chan_resources = gdma_dma_alloc_chan_resources;
 	dd->device_free_chan_resources = gdma_dma_free_chan_resources;
 	dd->device_prep_dma_memcpy = gdma_dma_prep_dma_memcpy;
 	dd->device_prep_slave_sg = gdma_dma_prep_slave_sg;
@@ -877,6 +1301,10 @@ static int gdma_dma_probe(struct platform_device *pdev)
 		vchan_init(&chan->vchan, dd);
 	}
 
+	ret = gdma_dma_setup_chains(dma_dev, pdev->dev.of_node);
+	if (ret)
+		return ret;
+
 	/* init hardware */
 	data->init(dma_dev);
 
@@ -895,6 +1323,9 @@ static int gdma_dma_probe(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, dma_dev);
 
+	if (gdma_dma_debugfs_create(dma_dev))
+		dev_warn(&pdev->dev, "create debugfs failed\n");
+
 	return 0;
 
 err_unregister:
@@ -906,6 +1337,7 @@ static int gdma_dma_remove(struct platform_device *pdev)
 {
 	struct gdma_dma_dev *dma_dev = platform_get_drvdata(pdev);
 
+	gdma_dma_debugfs_remove(dma_dev);
 	tasklet_kill(&dma_dev->task);
         of_dma_controller_free(pdev->dev.of_node);
 	dma_async_device_unregister(&dma_dev->ddev);
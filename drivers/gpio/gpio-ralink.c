@@ -81,6 +81,31 @@ static int ralink_gpio_get(struct gpio_chip *chip, unsigned offset)
 	return !!(rt_gpio_r32(rg, GPIO_REG_DATA) & BIT(offset));
 }
 
+/* a bank is at most 32 pins, so one SET and one RESET write cover it */
+static void ralink_gpio_set_multiple(struct gpio_chip *chip,
+				     unsigned long *mask, unsigned long *bits)
+{
+	struct ralink_gpio_chip *rg = to_ralink_gpio(chip);
+	u32 set = mask[0] & bits[0];
+	u32 reset = mask[0] & ~bits[0];
+
+	if (set)
+		rt_gpio_w32(rg, GPIO_REG_SET, set);
+	if (reset)
+		rt_gpio_w32(rg, GPIO_REG_RESET, reset);
+}
+
+static int ralink_gpio_get_multiple(struct gpio_chip *chip,
+				    unsigned long *mask, unsigned long *bits)
+{
+	struct ralink_gpio_chip *rg = to_ralink_gpio(chip);
+
+	bits[0] = (bits[0] & ~mask[0]) |
+		  (rt_gpio_r32(rg, GPIO_REG_DATA) & mask[0]);
+
+	return 0;
+}
+
 static int ralink_gpio_direction_input(struct gpio_chip *chip, unsigned offset)
 {
 	struct ralink_gpio_chip *rg = to_ralink_gpio(chip);
@@ -135,11 +160,18 @@ static void ralink_gpio_irq_handler(struct irq_desc *desc)
 
 		rg = (struct ralink_gpio_chip *) domain->host_data;
 		pending = rt_gpio_r32(rg, GPIO_REG_INT);
+		if (!pending)
+			continue;
+
+		/*
+		 * ack the whole bank at once, edges arriving while the
+		 * handlers run latch again and bring us back here
+		 */
+		rt_gpio_w32(rg, GPIO_REG_INT, pending);
 
 		for_each_set_bit(bit, &pending, rg->chip.ngpio) {
 			u32 map = irq_find_mapping(domain, bit);
 			generic_handle_irq(map);
-			rt_gpio_w32(rg, GPIO_REG_INT, BIT(bit));
 		}
 	}
 }
@@ -318,6 +350,8 @@ static int ralink_gpio_probe(struct platform_device *pdev)
 	rg->chip.direction_output = ralink_gpio_direction_output;
 	rg->chip.get = ralink_gpio_get;
 	rg->chip.set = ralink_gpio_set;
+	rg->chip.get_multiple = ralink_gpio_get_multiple;
+	rg->chip.set_multiple = ralink_gpio_set_multiple;
 	rg->chip.request = ralink_gpio_request;
 	rg->chip.to_irq = ralink_gpio_to_irq;
 	rg->chip.free = ralink_gpio_free;
@@ -350,17 +350,21 @@ static long linehandle_ioctl(struct file *filep, unsigned int cmd,
 	int i;
 
 	if (cmd == GPIOHANDLE_GET_LINE_VALUES_IOCTL) {
-		int val;
-
-		memset(&ghd, 0, sizeof(ghd));
+		int vals[GPIOHANDLES_MAX];
+		int ret;
 
 		/* TODO: check if descriptors are really input */
-		for (i = 0; i < lh->numdescs; i++) {
-			val = gpiod_get_value_cansleep(lh->descs[i]);
-			if (val < 0)
-				return val;
-			ghd.values[i] = val;
-		}
+		ret = gpiod_get_array_value_complex(false,
+						    true,
+						    lh->numdescs,
+						    lh->descs,
+						    vals);
+		if (ret)
+			return ret;
+
+		memset(&ghd, 0, sizeof(ghd));
+		for (i = 0; i < lh->numdescs; i++)
+			ghd.values[i] = vals[i];
 
 		if (copy_to_user(ip, &ghd, sizeof(ghd)))
 			return -EFAULT;
@@ -561,6 +565,8 @@ out_free_lh:
  * @events: KFIFO for the GPIO events
  * @read_lock: mutex lock to protect reads from colliding with adding
  * new events to the FIFO
+ * @timestamp: cache for the timestamp storing it between hardirq and IRQ
+ * thread, used to bring the timestamp close to the actual event
  */
 struct lineevent_state {
 	struct gpio_device *gdev;
@@ -569,8 +575,9 @@ struct lineevent_state {
 	u32 eflags;
 	int irq;
 	wait_queue_head_t wait;
-	DECLARE_KFIFO(events, struct gpioevent_data, 16);
+	DECLARE_KFIFO(events, struct gpioevent_data, 64);
 	struct mutex read_lock;
+	u64 timestamp;
 };
 
 #define GPIOEVENT_REQUEST_VALID_FLAGS \
@@ -699,14 +706,12 @@ static const struct file_operations lineevent_fileops = {
 #endif
 };
 
-static irqreturn_t lineevent_irq_thread(int irq, void *p)
+static irqreturn_t lineevent_queue(struct lineevent_state *le, int level)
 {
-	struct lineevent_state *le = p;
 	struct gpioevent_data ge;
-	int ret, level;
+	int ret;
 
-	ge.timestamp = ktime_get_real_ns();
-	level = gpiod_get_value_cansleep(le->desc);
+	ge.timestamp = le->timestamp;
 
 	if (le->eflags & GPIOEVENT_REQUEST_RISING_EDGE
 	    && le->eflags & GPIOEVENT_REQUEST_FALLING_EDGE) {
@@ -733,6 +738,29 @@ static irqreturn_t lineevent_irq_thread(int irq, void *p)
 	return IRQ_HANDLED;
 }
 
+static irqreturn_t lineevent_irq_thread(int irq, void *p)
+{
+	struct lineevent_state *le = p;
+
+	return lineevent_queue(le, gpiod_get_value_cansleep(le->desc));
+}
+
+/*
+ * The kfifo has a single producer, so events of lines on chips that
+ * don't sleep are queued from here without any locking, which keeps
+ * bursts of edges from being merged by the oneshot thread.
+ */
+static irqreturn_t lineevent_irq_handler(int irq, void *p)
+{
+	struct lineevent_state *le = p;
+
+	le->timestamp = ktime_get_real_ns();
+	if (!le->desc->gdev->chip->can_sleep)
+		return lineevent_queue(le, gpiod_get_value(le->desc));
+
+	return IRQ_WAKE_THREAD;
+}
+
 static int lineevent_create(struct gpio_device *gdev, void __user *ip)
 {
 	struct gpioevent_request eventreq;
@@ -825,7 +853,7 @@ static int lineevent_create(struct gpio_device *gdev, void __user *ip)
 
 	/* Request a thread to read the events */
 	ret = request_threaded_irq(le->irq,
-			NULL,
+			lineevent_irq_handler,
 			lineevent_irq_thread,
 			irqflags,
 			le->label,
@@ -2539,6 +2567,77 @@ static void gpio_chip_set_multiple(struct gpio_chip *chip,
 	}
 }
 
+/*
+ * read multiple inputs on the same chip;
+ * use the chip's get_multiple function if available;
+ * otherwise read the inputs sequentially
+ */
+static int gpio_chip_get_multiple(struct gpio_chip *chip,
+				  unsigned long *mask, unsigned long *bits)
+{
+	int i, value;
+
+	if (chip->get_multiple)
+		return chip->get_multiple(chip, mask, bits);
+	if (!chip->get)
+		return -EIO;
+
+	for_each_set_bit(i, mask, chip->ngpio) {
+		value = chip->get(chip, i);
+		if (value < 0)
+			return value;
+		if (value)
+			__set_bit(i, bits);
+		else
+			__clear_bit(i, bits);
+	}
+	return 0;
+}
+
+int gpiod_get_array_value_complex(bool raw, bool can_sleep,
+				  unsigned int array_size,
+				  struct gpio_desc **desc_array,
+				  int *value_array)
+{
+	int i = 0;
+
+	while (i < array_size) {
+		struct gpio_chip *chip = desc_array[i]->gdev->chip;
+		unsigned long mask[BITS_TO_LONGS(chip->ngpio)];
+		unsigned long bits[BITS_TO_LONGS(chip->ngpio)];
+		int first, j, ret;
+
+		if (!can_sleep)
+			WARN_ON(chip->can_sleep);
+
+		memset(mask, 0, sizeof(mask));
+		memset(bits, 0, sizeof(bits));
+
+		/* collect all inputs belonging to the same chip */
+		first = i;
+		do {
+			__set_bit(gpio_chip_hwgpio(desc_array[i]), mask);
+			i++;
+		} while ((i < array_size) &&
+			 (desc_array[i]->gdev->chip == chip));
+
+		ret = gpio_chip_get_multiple(chip, mask, bits);
+		if (ret)
+			return ret;
+
+		for (j = first; j < i; j++) {
+			struct gpio_desc *desc = desc_array[j];
+			int value = test_bit(gpio_chip_hwgpio(desc), bits);
+
+			if (!raw && test_bit(FLAG_ACTIVE_LOW, &desc->flags))
+				value = !value;
+			value_array[j] = value;
+			trace_gpio_value(desc_to_gpio(desc), 1, value);
+		}
+	}
+	return 0;
+}
+
 void gpiod_set_array_value_complex(bool raw, bool can_sleep,
 				   unsigned int array_size,
 				   struct gpio_desc **desc_array,
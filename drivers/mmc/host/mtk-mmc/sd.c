@@ -1605,7 +1605,9 @@ static int msdc_do_request(struct mmc_host*mmc, struct mmc_request*mrq)
                 goto done;            
 
             dir = read ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
-            (void)dma_map_sg(mmc_dev(mmc), data->sg, data->sg_len, dir);
+            /* reads overwrite the whole buffer, nothing to write back */
+            (void)dma_map_sg_attrs(mmc_dev(mmc), data->sg, data->sg_len, dir,
+                                   read ? DMA_ATTR_CPU_CLEAN : 0);
             msdc_dma_setup(host, &host->dma, data->sg, data->sg_len);            
                         
             /* then wait command done */
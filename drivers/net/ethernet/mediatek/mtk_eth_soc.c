@@ -933,10 +933,11 @@ static int mtk_poll_rx(struct napi_struct *napi, int budget,
 			netdev->stats.rx_dropped++;
 			goto release_desc;
 		}
-		dma_addr = dma_map_single(eth->dev,
-					  new_data + NET_SKB_PAD,
-					  ring->buf_size,
-					  DMA_FROM_DEVICE);
+		dma_addr = dma_map_single_attrs(eth->dev,
+						new_data + NET_SKB_PAD,
+						ring->buf_size,
+						DMA_FROM_DEVICE,
+						DMA_ATTR_CPU_CLEAN);
 		if (unlikely(dma_mapping_error(eth->dev, dma_addr))) {
 			skb_free_frag(new_data);
 			netdev->stats.rx_dropped++;
@@ -1244,10 +1245,11 @@ static int mtk_rx_alloc(struct mtk_eth *eth, int ring_no, int rx_flag)
 		return -ENOMEM;
 
 	for (i = 0; i < rx_dma_size; i++) {
-		dma_addr_t dma_addr = dma_map_single(eth->dev,
+		dma_addr_t dma_addr = dma_map_single_attrs(eth->dev,
 				ring->data[i] + NET_SKB_PAD,
 				ring->buf_size,
-				DMA_FROM_DEVICE);
+				DMA_FROM_DEVICE,
+				DMA_ATTR_CPU_CLEAN);
 		if (unlikely(dma_mapping_error(eth->dev, dma_addr)))
 			return -ENOMEM;
 		ring->dma[i].rxd1 = (unsigned int)dma_addr;
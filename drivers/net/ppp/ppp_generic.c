@@ -47,6 +47,7 @@
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/file.h>
+#include <linux/u64_stats_sync.h>
 #include <asm/unaligned.h>
 #include <net/slhc_vj.h>
 #include <linux/atomic.h>
@@ -150,6 +151,8 @@ struct ppp {
 #endif /* CONFIG_PPP_FILTER */
 	struct net	*ppp_net;	/* the net we belong to */
 	struct ppp_link_stats stats64;	/* 64 bit network stats */
+	struct channel __rcu *fast_chan; /* the only channel, if fast */
+	struct pcpu_sw_netstats __percpu *fast_stats; /* fast path stats */
 };
 
 /*
@@ -163,6 +166,13 @@ struct ppp {
 			 |SC_MULTILINK|SC_MP_SHORTSEQ|SC_MP_XSHORTSEQ \
 			 |SC_COMP_TCP|SC_REJ_COMP_TCP|SC_MUST_COMP)
 
+/*
+ * Any of these flags sends the data frames through the full transmit and
+ * receive paths.
+ */
+#define SC_SLOW_PATH	(SC_CCP_OPEN|SC_CCP_UP|SC_LOOP_TRAFFIC|SC_MULTILINK \
+			 |SC_COMP_TCP|SC_MUST_COMP)
+
 /*
  * Private data structure for each channel.
  * This includes the data structure used for multilink.
@@ -177,6 +187,7 @@ struct channel {
 	struct net	*chan_net;	/* the net channel belongs to */
 	struct list_head clist;		/* link in list of channels per unit */
 	rwlock_t	upl;		/* protects `ppp' */
+	bool		fast;		/* channel has a fast_xmit routine */
 #ifdef CONFIG_PPP_MULTILINK
 	u8		avail;		/* flag used in multilink stuff */
 	u8		had_frag;	/* >= 1 fragments have been sent */
@@ -1050,6 +1061,12 @@ static int ppp_dev_configure(struct net *src_net, struct net_device *dev,
 	for_each_possible_cpu(cpu)
 		(*per_cpu_ptr(ppp->xmit_recursion, cpu)) = 0;
 
+	ppp->fast_stats = netdev_alloc_pcpu_stats(struct pcpu_sw_netstats);
+	if (!ppp->fast_stats) {
+		err = -ENOMEM;
+		goto err2;
+	}
+
 #ifdef CONFIG_PPP_MULTILINK
 	ppp->minseq = -1;
 	skb_queue_head_init(&ppp->mrq);
@@ -1061,11 +1078,13 @@ static int ppp_dev_configure(struct net *src_net, struct net_device *dev,
 
 	err = ppp_unit_register(ppp, conf->unit, conf->ifname_is_set);
 	if (err < 0)
-		goto err2;
+		goto err3;
 
 	conf->file->private_data = &ppp->file;
 
 	return 0;
+err3:
+	free_percpu(ppp->fast_stats);
 err2:
 	free_percpu(ppp->xmit_recursion);
 err1:
@@ -1223,6 +1242,114 @@ out:
 	return err;
 }
 
+/*
+ * Fast path.
+ *
+ * Data frames on a unit with a single channel that has a fast_xmit
+ * routine, and nothing to do to them (compression, multilink, filters,
+ * demand dialling), skip the unit and channel locks and queues: they go
+ * straight between the network stack and the channel. Everything else,
+ * including all control frames, takes the full path.
+ *
+ * ppp->fast_chan is only set while there is a single channel and is
+ * changed with the unit locked. The channel and unit stay around for
+ * an RCU grace period after it is cleared, see ppp_unregister_channel
+ * and ppp_disconnect_channel.
+ */
+static struct channel *ppp_fast_channel(struct ppp *ppp)
+{
+	struct channel *pch = rcu_dereference_bh(ppp->fast_chan);
+
+	if (!pch || (READ_ONCE(ppp->flags) & SC_SLOW_PATH) ||
+	    (READ_ONCE(ppp->xstate) & SC_COMP_RUN) ||
+	    (READ_ONCE(ppp->rstate) & SC_DECOMP_RUN) ||
+	    READ_ONCE(ppp->closing))
+		return NULL;
+#ifdef CONFIG_PPP_FILTER
+	if (ppp->pass_filter || ppp->active_filter)
+		return NULL;
+#endif /* CONFIG_PPP_FILTER */
+
+	return pch;
+}
+
+/* Called with the unit locked when its list of channels changes */
+static void ppp_update_fast_chan(struct ppp *ppp)
+{
+	struct channel *pch = NULL;
+
+	if (ppp->n_channels == 1) {
+		pch = list_first_entry(&ppp->channels, struct channel, clist);
+		if (!pch->fast || !pch->chan)
+			pch = NULL;
+	}
+	rcu_assign_pointer(ppp->fast_chan, pch);
+}
+
+static void ppp_fast_xmit(struct ppp *ppp, struct channel *pch,
+			  struct sk_buff *skb)
+{
+	struct pcpu_sw_netstats *stats = this_cpu_ptr(ppp->fast_stats);
+	struct ppp_channel *chan = READ_ONCE(pch->chan);
+
+	/* being unregistered, fast_chan is cleared right after */
+	if (unlikely(!chan)) {
+		kfree_skb(skb);
+		++ppp->dev->stats.tx_dropped;
+		return;
+	}
+
+	ppp->last_xmit = jiffies;
+
+	u64_stats_update_begin(&stats->syncp);
+	stats->tx_packets++;
+	stats->tx_bytes += skb->len - 2;
+	u64_stats_update_end(&stats->syncp);
+
+	chan->ops->fast_xmit(chan, skb);
+}
+
+bool
+ppp_fast_input(struct ppp_channel *chan, struct sk_buff *skb)
+{
+	struct channel *pch = READ_ONCE(chan->ppp);
+	struct pcpu_sw_netstats *stats;
+	struct ppp *ppp;
+	int npi;
+
+	if (!pch || !pskb_may_pull(skb, 2))
+		return false;
+
+	ppp = READ_ONCE(pch->ppp);
+	if (!ppp || ppp_fast_channel(ppp) != pch)
+		return false;
+
+	/* control, VJ and CCP frames take the full path */
+	npi = proto_to_npindex(PPP_PROTO(skb));
+	if (npi < 0 || ppp->npmode[npi] != NPMODE_PASS ||
+	    !(ppp->dev->flags & IFF_UP))
+		return false;
+
+	ppp->last_recv = jiffies;
+
+	stats = this_cpu_ptr(ppp->fast_stats);
+	u64_stats_update_begin(&stats->syncp);
+	stats->rx_packets++;
+	stats->rx_bytes += skb->len - 2;
+	u64_stats_update_end(&stats->syncp);
+
+	skb_checksum_complete_unset(skb);
+	/* chop off protocol */
+	skb_pull_rcsum(skb, 2);
+	skb->dev = ppp->dev;
+	skb->protocol = htons(npindex_to_ethertype[npi]);
+	skb_reset_mac_header(skb);
+	skb_scrub_packet(skb, !net_eq(ppp->ppp_net, dev_net(ppp->dev)));
+	netif_rx(skb);
+
+	return true;
+}
+
 /*
  * Network interface unit routines.
  */
@@ -1230,6 +1357,7 @@ static netdev_tx_t
 ppp_start_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct ppp *ppp = netdev_priv(dev);
+	struct channel *pch;
 	int npi, proto;
 	unsigned char *pp;
 
@@ -1260,6 +1388,15 @@ ppp_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	put_unaligned_be16(proto, pp);
 
 	skb_scrub_packet(skb, !net_eq(ppp->ppp_net, dev_net(dev)));
+
+	/* don't overtake frames still waiting for the full path */
+	pch = ppp_fast_channel(ppp);
+	if (pch && !READ_ONCE(ppp->xmit_pending) &&
+	    skb_queue_empty(&ppp->file.xq)) {
+		ppp_fast_xmit(ppp, pch, skb);
+		return NETDEV_TX_OK;
+	}
+
 	skb_queue_tail(&ppp->file.xq, skb);
 	ppp_xmit_process(ppp);
 	return NETDEV_TX_OK;
@@ -1317,6 +1454,7 @@ static struct rtnl_link_stats64*
 ppp_get_stats64(struct net_device *dev, struct rtnl_link_stats64 *stats64)
 {
 	struct ppp *ppp = netdev_priv(dev);
+	int cpu;
 
 	ppp_recv_lock(ppp);
 	stats64->rx_packets = ppp->stats64.rx_packets;
@@ -1328,6 +1466,26 @@ ppp_get_stats64(struct net_device *dev, struct rtnl_link_stats64 *stats64)
 	stats64->tx_bytes   = ppp->stats64.tx_bytes;
 	ppp_xmit_unlock(ppp);
 
+	for_each_possible_cpu(cpu) {
+		struct pcpu_sw_netstats *stats;
+		u64 rx_packets, rx_bytes, tx_packets, tx_bytes;
+		unsigned int start;
+
+		stats = per_cpu_ptr(ppp->fast_stats, cpu);
+		do {
+			start = u64_stats_fetch_begin_irq(&stats->syncp);
+			rx_packets = stats->rx_packets;
+			rx_bytes = stats->rx_bytes;
+			tx_packets = stats->tx_packets;
+			tx_bytes = stats->tx_bytes;
+		} while (u64_stats_fetch_retry_irq(&stats->syncp, start));
+
+		stats64->rx_packets += rx_packets;
+		stats64->rx_bytes += rx_bytes;
+		stats64->tx_packets += tx_packets;
+		stats64->tx_bytes += tx_bytes;
+	}
+
 	stats64->rx_errors        = dev->stats.rx_errors;
 	stats64->tx_errors        = dev->stats.tx_errors;
 	stats64->rx_dropped       = dev->stats.rx_dropped;
@@ -2576,6 +2734,7 @@ int ppp_register_net_channel(struct net *net, struct ppp_channel *chan)
 
 	pch->ppp = NULL;
 	pch->chan = chan;
+	pch->fast = chan->ops->fast_xmit != NULL;
 	pch->chan_net = get_net(net);
 	chan->ppp = pch;
 	init_ppp_file(&pch->file, CHANNEL);
@@ -2667,6 +2826,26 @@ ppp_unregister_channel(struct ppp_channel *chan)
 	pch->chan = NULL;
 	spin_unlock_bh(&pch->downl);
 	up_write(&pch->chan_sem);
+
+	/*
+	 * Take the channel off the fast path and wait for ppp_fast_input
+	 * and the fast_xmit calls to be done with it. With pch->chan
+	 * already cleared, ppp_update_fast_chan can't put it back.
+	 */
+	if (pch->fast) {
+		struct ppp *ppp;
+
+		read_lock_bh(&pch->upl);
+		ppp = pch->ppp;
+		if (ppp) {
+			ppp_lock(ppp);
+			if (rcu_access_pointer(ppp->fast_chan) == pch)
+				RCU_INIT_POINTER(ppp->fast_chan, NULL);
+			ppp_unlock(ppp);
+		}
+		read_unlock_bh(&pch->upl);
+		synchronize_net();
+	}
 	ppp_disconnect_channel(pch);
 
 	pn = ppp_pernet(pch->chan_net);
@@ -3091,6 +3270,7 @@ static void ppp_destroy_interface(struct ppp *ppp)
 
 	kfree_skb(ppp->xmit_pending);
 	free_percpu(ppp->xmit_recursion);
+	free_percpu(ppp->fast_stats);
 
 	free_netdev(ppp->dev);
 }
@@ -3164,6 +3344,7 @@ ppp_connect_channel(struct channel *pch, int unit)
 	list_add_tail(&pch->clist, &ppp->channels);
 	++ppp->n_channels;
 	pch->ppp = ppp;
+	ppp_update_fast_chan(ppp);
 	atomic_inc(&ppp->file.refcnt);
 	ppp_unlock(ppp);
 	ret = 0;
@@ -3194,7 +3375,11 @@ ppp_disconnect_channel(struct channel *pch)
 		list_del(&pch->clist);
 		if (--ppp->n_channels == 0)
 			wake_up_interruptible(&ppp->file.rwait);
+		ppp_update_fast_chan(ppp);
 		ppp_unlock(ppp);
+		/* the fast path may still be looking at the unit */
+		if (pch->fast)
+			synchronize_net();
 		if (atomic_dec_and_test(&ppp->file.refcnt))
 			ppp_destroy_interface(ppp);
 		err = 0;
@@ -3280,6 +3465,7 @@ EXPORT_SYMBOL(ppp_channel_index);
 EXPORT_SYMBOL(ppp_unit_number);
 EXPORT_SYMBOL(ppp_dev_name);
 EXPORT_SYMBOL(ppp_input);
+EXPORT_SYMBOL(ppp_fast_input);
 EXPORT_SYMBOL(ppp_input_error);
 EXPORT_SYMBOL(ppp_output_wakeup);
 EXPORT_SYMBOL(ppp_register_compressor);
@@ -77,6 +77,7 @@
 #include <linux/file.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
+#include <linux/u64_stats_sync.h>
 
 #include <linux/nsproxy.h>
 #include <net/net_namespace.h>
@@ -85,10 +86,6 @@
 
 #include <asm/uaccess.h>
 
-#define PPPOE_HASH_BITS 4
-#define PPPOE_HASH_SIZE (1 << PPPOE_HASH_BITS)
-#define PPPOE_HASH_MASK	(PPPOE_HASH_SIZE - 1)
-
 static int __pppoe_xmit(struct sock *sk, struct sk_buff *skb);
 
 static const struct proto_ops pppoe_ops;
@@ -98,15 +95,22 @@ static const struct ppp_channel_ops pppoe_chan_ops;
 static int pppoe_net_id __read_mostly;
 struct pppoe_net {
 	/*
-	 * we could use _single_ hash table for all
-	 * nets by injecting net id into the hash but
-	 * it would increase hash chains and add
-	 * a few additional math comparations messy
-	 * as well, moreover in case of SMP less locking
-	 * controversy here
+	 * Sessions are looked up by (ifindex, sid, peer address) without
+	 * locks. The table grows and shrinks with the number of sessions,
+	 * there may be hundreds of them on an access concentrator. The
+	 * list of all sessions is for the device notifier and /proc.
+	 * hash_lock serialises the updates of both.
 	 */
-	struct pppox_sock *hash_table[PPPOE_HASH_SIZE];
-	rwlock_t hash_lock;
+	struct rhashtable hash_table;
+	struct hlist_head sessions;
+	spinlock_t hash_lock;
+};
+
+static const struct rhashtable_params pppoe_rht_params = {
+	.key_len		= sizeof(struct pppoe_key),
+	.key_offset		= offsetof(struct pppox_sock, proto.pppoe.key),
+	.head_offset		= offsetof(struct pppox_sock, proto.pppoe.node),
+	.automatic_shrinking	= true,
 };
 
 /*
@@ -129,102 +133,63 @@ static inline struct pppoe_net *pppoe_pernet(struct net *net)
 	return net_generic(net, pppoe_net_id);
 }
 
-static inline int cmp_2_addr(struct pppoe_addr *a, struct pppoe_addr *b)
-{
-	return a->sid == b->sid && ether_addr_equal(a->remote, b->remote);
-}
-
-static inline int cmp_addr(struct pppoe_addr *a, __be16 sid, char *addr)
-{
-	return a->sid == sid && ether_addr_equal(a->remote, addr);
-}
-
-#if 8 % PPPOE_HASH_BITS
-#error 8 must be a multiple of PPPOE_HASH_BITS
-#endif
-
-static int hash_item(__be16 sid, unsigned char *addr)
+static inline void pppoe_make_key(struct pppoe_key *key, __be16 sid,
+				  unsigned char *addr, int ifindex)
 {
-	unsigned char hash = 0;
-	unsigned int i;
-
-	for (i = 0; i < ETH_ALEN; i++)
-		hash ^= addr[i];
-	for (i = 0; i < sizeof(sid_t) * 8; i += 8)
-		hash ^= (__force __u32)sid >> i;
-	for (i = 8; (i >>= 1) >= PPPOE_HASH_BITS;)
-		hash ^= hash >> i;
-
-	return hash & PPPOE_HASH_MASK;
+	key->ifindex = ifindex;
+	key->sid = sid;
+	memcpy(key->remote, addr, ETH_ALEN);
 }
 
 /**********************************************************************
  *
- *  Set/get/delete/rehash items  (internal versions)
+ *  Set/get/delete items  (internal versions)
  *
  **********************************************************************/
 static struct pppox_sock *__get_item(struct pppoe_net *pn, __be16 sid,
 				unsigned char *addr, int ifindex)
 {
-	int hash = hash_item(sid, addr);
-	struct pppox_sock *ret;
-
-	ret = pn->hash_table[hash];
-	while (ret) {
-		if (cmp_addr(&ret->pppoe_pa, sid, addr) &&
-		    ret->pppoe_ifindex == ifindex)
-			return ret;
+	struct pppoe_key key;
 
-		ret = ret->next;
-	}
+	pppoe_make_key(&key, sid, addr, ifindex);
 
-	return NULL;
+	return rhashtable_lookup(&pn->hash_table, &key, pppoe_rht_params);
 }
 
 static int __set_item(struct pppoe_net *pn, struct pppox_sock *po)
 {
-	int hash = hash_item(po->pppoe_pa.sid, po->pppoe_pa.remote);
-	struct pppox_sock *ret;
+	int err;
 
-	ret = pn->hash_table[hash];
-	while (ret) {
-		if (cmp_2_addr(&ret->pppoe_pa, &po->pppoe_pa) &&
-		    ret->pppoe_ifindex == po->pppoe_ifindex)
-			return -EALREADY;
+	pppoe_make_key(&po->proto.pppoe.key, po->pppoe_pa.sid,
+		       po->pppoe_pa.remote, po->pppoe_ifindex);
 
-		ret = ret->next;
-	}
+	err = rhashtable_lookup_insert_fast(&pn->hash_table,
+					    &po->proto.pppoe.node,
+					    pppoe_rht_params);
+	if (err == -EEXIST)
+		return -EALREADY;
+	if (err)
+		return err;
 
-	po->next = pn->hash_table[hash];
-	pn->hash_table[hash] = po;
+	hlist_add_head_rcu(&po->proto.pppoe.list, &pn->sessions);
 
 	return 0;
 }
 
-static void __delete_item(struct pppoe_net *pn, __be16 sid,
-					char *addr, int ifindex)
+/* Only removes po itself, not another session with the same address */
+static void __delete_item(struct pppoe_net *pn, struct pppox_sock *po)
 {
-	int hash = hash_item(sid, addr);
-	struct pppox_sock *ret, **src;
-
-	ret = pn->hash_table[hash];
-	src = &pn->hash_table[hash];
-
-	while (ret) {
-		if (cmp_addr(&ret->pppoe_pa, sid, addr) &&
-		    ret->pppoe_ifindex == ifindex) {
-			*src = ret->next;
-			break;
-		}
+	if (hlist_unhashed(&po->proto.pppoe.list))
+		return;
 
-		src = &ret->next;
-		ret = ret->next;
-	}
+	rhashtable_remove_fast(&pn->hash_table, &po->proto.pppoe.node,
+			       pppoe_rht_params);
+	hlist_del_init_rcu(&po->proto.pppoe.list);
 }
 
 /**********************************************************************
  *
- *  Set/get/delete/rehash items
+ *  Set/get/delete items
  *
  **********************************************************************/
 static inline struct pppox_sock *get_item(struct pppoe_net *pn, __be16 sid,
@@ -232,11 +197,12 @@ static inline struct pppox_sock *get_item(struct pppoe_net *pn, __be16 sid,
 {
 	struct pppox_sock *po;
 
-	read_lock_bh(&pn->hash_lock);
+	/* the sockets are freed after a grace period, see pppoe_create */
+	rcu_read_lock();
 	po = __get_item(pn, sid, addr, ifindex);
-	if (po)
-		sock_hold(sk_pppox(po));
-	read_unlock_bh(&pn->hash_lock);
+	if (po && !atomic_inc_not_zero(&sk_pppox(po)->sk_refcnt))
+		po = NULL;
+	rcu_read_unlock();
 
 	return po;
 }
@@ -262,12 +228,27 @@ static inline struct pppox_sock *get_item_by_addr(struct net *net,
 	return pppox_sock;
 }
 
-static inline void delete_item(struct pppoe_net *pn, __be16 sid,
-					char *addr, int ifindex)
+static inline void delete_item(struct pppoe_net *pn, struct pppox_sock *po)
 {
-	write_lock_bh(&pn->hash_lock);
-	__delete_item(pn, sid, addr, ifindex);
-	write_unlock_bh(&pn->hash_lock);
+	spin_lock(&pn->hash_lock);
+	__delete_item(pn, po);
+	spin_unlock(&pn->hash_lock);
+}
+
+/* Session data counters, updated without the socket lock */
+static void pppoe_count(struct pppox_sock *po, unsigned int len, bool tx)
+{
+	struct pcpu_sw_netstats *stats = this_cpu_ptr(po->proto.pppoe.stats);
+
+	u64_stats_update_begin(&stats->syncp);
+	if (tx) {
+		stats->tx_packets++;
+		stats->tx_bytes += len;
+	} else {
+		stats->rx_packets++;
+		stats->rx_bytes += len;
+	}
+	u64_stats_update_end(&stats->syncp);
 }
 
 /***************************************************************************
@@ -280,58 +261,50 @@ static inline void delete_item(struct pppoe_net *pn, __be16 sid,
 static void pppoe_flush_dev(struct net_device *dev)
 {
 	struct pppoe_net *pn;
-	int i;
+	struct pppox_sock *po;
+	struct sock *sk;
 
 	pn = pppoe_pernet(dev_net(dev));
-	write_lock_bh(&pn->hash_lock);
-	for (i = 0; i < PPPOE_HASH_SIZE; i++) {
-		struct pppox_sock *po = pn->hash_table[i];
-		struct sock *sk;
-
-		while (po) {
-			while (po && po->pppoe_dev != dev) {
-				po = po->next;
-			}
-
-			if (!po)
-				break;
-
-			sk = sk_pppox(po);
-
-			/* We always grab the socket lock, followed by the
-			 * hash_lock, in that order.  Since we should hold the
-			 * sock lock while doing any unbinding, we need to
-			 * release the lock we're holding.  Hold a reference to
-			 * the sock so it doesn't disappear as we're jumping
-			 * between locks.
-			 */
-
-			sock_hold(sk);
-			write_unlock_bh(&pn->hash_lock);
-			lock_sock(sk);
-
-			if (po->pppoe_dev == dev &&
-			    sk->sk_state & (PPPOX_CONNECTED | PPPOX_BOUND)) {
-				pppox_unbind_sock(sk);
-				sk->sk_state_change(sk);
-				po->pppoe_dev = NULL;
-				dev_put(dev);
-			}
-
-			release_sock(sk);
-			sock_put(sk);
-
-			/* Restart the process from the start of the current
-			 * hash chain. We dropped locks so the world may have
-			 * change from underneath us.
-			 */
-
-			BUG_ON(pppoe_pernet(dev_net(dev)) == NULL);
-			write_lock_bh(&pn->hash_lock);
-			po = pn->hash_table[i];
+	spin_lock(&pn->hash_lock);
+restart:
+	hlist_for_each_entry(po, &pn->sessions, proto.pppoe.list) {
+		if (po->pppoe_dev != dev)
+			continue;
+
+		sk = sk_pppox(po);
+
+		/* We always grab the socket lock, followed by the
+		 * hash_lock, in that order.  Since we should hold the
+		 * sock lock while doing any unbinding, we need to
+		 * release the lock we're holding.  Hold a reference to
+		 * the sock so it doesn't disappear as we're jumping
+		 * between locks.
+		 */
+
+		sock_hold(sk);
+		spin_unlock(&pn->hash_lock);
+		lock_sock(sk);
+
+		if (po->pppoe_dev == dev &&
+		    sk->sk_state & (PPPOX_CONNECTED | PPPOX_BOUND)) {
+			pppox_unbind_sock(sk);
+			sk->sk_state_change(sk);
+			po->pppoe_dev = NULL;
+			dev_put(dev);
 		}
+
+		release_sock(sk);
+		sock_put(sk);
+
+		/* Restart the process from the start of the list. We
+		 * dropped locks so the world may have change from
+		 * underneath us.
+		 */
+
+		spin_lock(&pn->hash_lock);
+		goto restart;
 	}
-	write_unlock_bh(&pn->hash_lock);
+	spin_unlock(&pn->hash_lock);
 }
 
 static int pppoe_device_event(struct notifier_block *this,
@@ -451,6 +424,20 @@ static int pppoe_rcv(struct sk_buff *skb, struct net_device *dev,
 	if (!po)
 		goto drop;
 
+	pppoe_count(po, len, false);
+
+	/* Data frames of a plain session skip the socket backlog. With a
+	 * socket filter attached they go through sk_receive_skb, which
+	 * runs it.
+	 */
+	if (skb->pkt_type != PACKET_OTHERHOST &&
+	    (READ_ONCE(sk_pppox(po)->sk_state) & PPPOX_BOUND) &&
+	    !rcu_access_pointer(sk_pppox(po)->sk_filter) &&
+	    ppp_fast_input(&po->chan, skb)) {
+		sock_put(sk_pppox(po));
+		return NET_RX_SUCCESS;
+	}
+
 	return sk_receive_skb(sk_pppox(po), skb, 0);
 
 drop:
@@ -522,6 +509,11 @@ static struct packet_type pppoed_ptype __read_mostly = {
 	.func	= pppoe_disc_rcv,
 };
 
+static void pppoe_sk_destruct(struct sock *sk)
+{
+	free_percpu(pppox_sk(sk)->proto.pppoe.stats);
+}
+
 static struct proto pppoe_sk_proto __read_mostly = {
 	.name	  = "PPPOE",
 	.owner	  = THIS_MODULE,
@@ -535,11 +527,18 @@ static struct proto pppoe_sk_proto __read_mostly = {
  **********************************************************************/
 static int pppoe_create(struct net *net, struct socket *sock, int kern)
 {
+	struct pcpu_sw_netstats __percpu *stats;
 	struct sock *sk;
 
+	stats = netdev_alloc_pcpu_stats(struct pcpu_sw_netstats);
+	if (!stats)
+		return -ENOMEM;
+
 	sk = sk_alloc(net, PF_PPPOX, GFP_KERNEL, &pppoe_sk_proto, kern);
-	if (!sk)
+	if (!sk) {
+		free_percpu(stats);
 		return -ENOMEM;
+	}
 
 	sock_init_data(sock, sk);
 
@@ -551,9 +550,15 @@ static int pppoe_create(struct net *net, struct socket *sock, int kern)
 	sk->sk_type		= SOCK_STREAM;
 	sk->sk_family		= PF_PPPOX;
 	sk->sk_protocol		= PX_PROTO_OE;
+	sk->sk_destruct		= pppoe_sk_destruct;
+
+	/* the session table is read under RCU */
+	sock_set_flag(sk, SOCK_RCU_FREE);
 
 	INIT_WORK(&pppox_sk(sk)->proto.pppoe.padt_work,
 		  pppoe_unbind_sock_work);
+	INIT_HLIST_NODE(&pppox_sk(sk)->proto.pppoe.list);
+	pppox_sk(sk)->proto.pppoe.stats = stats;
 
 	return 0;
 }
@@ -593,8 +598,7 @@ static int pppoe_release(struct socket *sock)
 	 * protect "po" from concurrent updates
 	 * on pppoe_flush_dev
 	 */
-	delete_item(pn, po->pppoe_pa.sid, po->pppoe_pa.remote,
-		    po->pppoe_ifindex);
+	delete_item(pn, po);
 
 	sock_orphan(sk);
 	sock->sk = NULL;
@@ -641,8 +645,7 @@ static int pppoe_connect(struct socket *sock, struct sockaddr *uservaddr,
 	if (stage_session(po->pppoe_pa.sid)) {
 		pppox_unbind_sock(sk);
 		pn = pppoe_pernet(sock_net(sk));
-		delete_item(pn, po->pppoe_pa.sid,
-			    po->pppoe_pa.remote, po->pppoe_ifindex);
+		delete_item(pn, po);
 		if (po->pppoe_dev) {
 			dev_put(po->pppoe_dev);
 			po->pppoe_dev = NULL;
@@ -652,7 +655,6 @@ static int pppoe_connect(struct socket *sock, struct sockaddr *uservaddr,
 		memset(&po->pppoe_pa, 0, sizeof(po->pppoe_pa));
 		memset(&po->pppoe_relay, 0, sizeof(po->pppoe_relay));
 		memset(&po->chan, 0, sizeof(po->chan));
-		po->next = NULL;
 		po->num = 0;
 
 		sk->sk_state = PPPOX_NONE;
@@ -677,9 +679,9 @@ static int pppoe_connect(struct socket *sock, struct sockaddr *uservaddr,
 		       &sp->sa_addr.pppoe,
 		       sizeof(struct pppoe_addr));
 
-		write_lock_bh(&pn->hash_lock);
+		spin_lock(&pn->hash_lock);
 		error = __set_item(pn, po);
-		write_unlock_bh(&pn->hash_lock);
+		spin_unlock(&pn->hash_lock);
 		if (error < 0)
 			goto err_put;
 
@@ -692,8 +694,7 @@ static int pppoe_connect(struct socket *sock, struct sockaddr *uservaddr,
 
 		error = ppp_register_net_channel(dev_net(dev), &po->chan);
 		if (error) {
-			delete_item(pn, po->pppoe_pa.sid,
-				    po->pppoe_pa.remote, po->pppoe_ifindex);
+			delete_item(pn, po);
 			goto err_put;
 		}
 
@@ -949,6 +950,7 @@ static int __pppoe_xmit(struct sock *sk, struct sk_buff *skb)
 	dev_hard_header(skb, dev, ETH_P_PPP_SES,
 			po->pppoe_pa.remote, NULL, data_len);
 
+	pppoe_count(po, data_len, true);
 	dev_queue_xmit(skb);
 	return 1;
 
@@ -969,8 +971,14 @@ static int pppoe_xmit(struct ppp_channel *chan, struct sk_buff *skb)
 	return __pppoe_xmit(sk, skb);
 }
 
+static void pppoe_fast_xmit(struct ppp_channel *chan, struct sk_buff *skb)
+{
+	__pppoe_xmit((struct sock *)chan->private, skb);
+}
+
 static const struct ppp_channel_ops pppoe_chan_ops = {
 	.start_xmit = pppoe_xmit,
+	.fast_xmit = pppoe_fast_xmit,
 };
 
 static int pppoe_recvmsg(struct socket *sock, struct msghdr *m,
@@ -1007,84 +1015,67 @@ end:
 #ifdef CONFIG_PROC_FS
 static int pppoe_seq_show(struct seq_file *seq, void *v)
 {
+	u64 rx_packets = 0, rx_bytes = 0, tx_packets = 0, tx_bytes = 0;
 	struct pppox_sock *po;
 	char *dev_name;
+	int cpu;
 
 	if (v == SEQ_START_TOKEN) {
-		seq_puts(seq, "Id       Address              Device\n");
+		seq_puts(seq, "Id       Address              Device"
+			 "   RxPackets    RxBytes  TxPackets    TxBytes\n");
 		goto out;
 	}
 
-	po = v;
+	po = hlist_entry(v, struct pppox_sock, proto.pppoe.list);
 	dev_name = po->pppoe_pa.dev;
 
-	seq_printf(seq, "%08X %pM %8s\n",
-		po->pppoe_pa.sid, po->pppoe_pa.remote, dev_name);
-out:
-	return 0;
-}
-
-static inline struct pppox_sock *pppoe_get_idx(struct pppoe_net *pn, loff_t pos)
-{
-	struct pppox_sock *po;
-	int i;
-
-	for (i = 0; i < PPPOE_HASH_SIZE; i++) {
-		po = pn->hash_table[i];
-		while (po) {
-			if (!pos--)
-				goto out;
-			po = po->next;
-		}
+	for_each_possible_cpu(cpu) {
+		struct pcpu_sw_netstats *stats;
+		u64 rxp, rxb, txp, txb;
+		unsigned int start;
+
+		stats = per_cpu_ptr(po->proto.pppoe.stats, cpu);
+		do {
+			start = u64_stats_fetch_begin_irq(&stats->syncp);
+			rxp = stats->rx_packets;
+			rxb = stats->rx_bytes;
+			txp = stats->tx_packets;
+			txb = stats->tx_bytes;
+		} while (u64_stats_fetch_retry_irq(&stats->syncp, start));
+
+		rx_packets += rxp;
+		rx_bytes += rxb;
+		tx_packets += txp;
+		tx_bytes += txb;
 	}
 
+	seq_printf(seq, "%08X %pM %8s %11llu %10llu %10llu %10llu\n",
+		po->pppoe_pa.sid, po->pppoe_pa.remote, dev_name,
+		rx_packets, rx_bytes, tx_packets, tx_bytes);
 out:
-	return po;
+	return 0;
 }
 
 static void *pppoe_seq_start(struct seq_file *seq, loff_t *pos)
-	__acquires(pn->hash_lock)
+	__acquires(RCU)
 {
 	struct pppoe_net *pn = pppoe_pernet(seq_file_net(seq));
-	loff_t l = *pos;
 
-	read_lock_bh(&pn->hash_lock);
-	return l ? pppoe_get_idx(pn, --l) : SEQ_START_TOKEN;
+	rcu_read_lock();
+	return seq_hlist_start_head_rcu(&pn->sessions, *pos);
 }
 
 static void *pppoe_seq_next(struct seq_file *seq, void *v, loff_t *pos)
 {
 	struct pppoe_net *pn = pppoe_pernet(seq_file_net(seq));
-	struct pppox_sock *po;
 
-	++*pos;
-	if (v == SEQ_START_TOKEN) {
-		po = pppoe_get_idx(pn, 0);
-		goto out;
-	}
-	po = v;
-	if (po->next)
-		po = po->next;
-	else {
-		int hash = hash_item(po->pppoe_pa.sid, po->pppoe_pa.remote);
-
-		po = NULL;
-		while (++hash < PPPOE_HASH_SIZE) {
-			po = pn->hash_table[hash];
-			if (po)
-				break;
-		}
-	}
-
-out:
-	return po;
+	return seq_hlist_next_rcu(v, &pn->sessions, pos);
 }
 
 static void pppoe_seq_stop(struct seq_file *seq, void *v)
-	__releases(pn->hash_lock)
+	__releases(RCU)
 {
-	struct pppoe_net *pn = pppoe_pernet(seq_file_net(seq));
-	read_unlock_bh(&pn->hash_lock);
+	rcu_read_unlock();
 }
 
 static const struct seq_operations pppoe_seq_ops = {
@@ -1140,13 +1131,20 @@ static __net_init int pppoe_init_net(struct net *net)
 {
 	struct pppoe_net *pn = pppoe_pernet(net);
 	struct proc_dir_entry *pde;
+	int err;
 
-	rwlock_init(&pn->hash_lock);
+	spin_lock_init(&pn->hash_lock);
+	INIT_HLIST_HEAD(&pn->sessions);
+	err = rhashtable_init(&pn->hash_table, &pppoe_rht_params);
+	if (err)
+		return err;
 
 	pde = proc_create("pppoe", S_IRUGO, net->proc_net, &pppoe_seq_fops);
 #ifdef CONFIG_PROC_FS
-	if (!pde)
+	if (!pde) {
+		rhashtable_destroy(&pn->hash_table);
 		return -ENOMEM;
+	}
 #endif
 
 	return 0;
@@ -1154,7 +1152,10 @@ static __net_init int pppoe_init_net(struct net *net)
 
 static __net_exit void pppoe_exit_net(struct net *net)
 {
+	struct pppoe_net *pn = pppoe_pernet(net);
+
 	remove_proc_entry("pppoe", net->proc_net);
+	rhashtable_destroy(&pn->hash_table);
 }
 
 static struct pernet_operations pppoe_net_ops = {
@@ -72,6 +72,10 @@
 #include <linux/seq_file.h>
 #include <linux/uio.h>
 #include <linux/skb_array.h>
+#include <linux/eventfd.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
 
 #include <asm/uaccess.h>
 
@@ -132,6 +136,26 @@ struct tap_filter {
 
 #define TUN_FLOW_EXPIRE (3 * HZ)
 
+#define TUN_RING_MAX_FRAMES	1024
+#define TUN_RING_MAX_FRAME_SIZE	(65536 + TUN_FRAME_HDRLEN)
+#define TUN_RING_MAX_SIZE	(8 << 20)
+
+/* Shared memory rings, see TUNSETRING. They are set up before the file is
+ * attached and stay until it is released, which the mappings delay.
+ */
+struct tun_ring {
+	void			*base;
+	size_t			size;
+	unsigned int		frame_size;
+	unsigned int		frame_nr;
+	spinlock_t		rx_lock;
+	unsigned int		rx_head;	/* next RX frame to fill */
+	struct mutex		tx_mutex;
+	unsigned int		tx_head;	/* next TX frame to send */
+	struct eventfd_ctx	*eventfd;
+	struct user_struct	*user;		/* charged for the pages */
+};
+
 struct tun_pcpu_stats {
 	u64 rx_packets;
 	u64 rx_bytes;
@@ -169,6 +193,9 @@ struct tun_file {
 	struct list_head next;
 	struct tun_struct *detached;
 	struct skb_array tx_array;
+	struct tun_ring *ring;
+	struct napi_struct napi;
+	bool napi_enabled;
 };
 
 struct tun_flow_entry {
@@ -285,6 +312,20 @@ static inline __virtio16 cpu_to_tun16(struct tun_struct *tun, u16 val)
 	return __cpu_to_virtio16(tun_is_little_endian(tun), val);
 }
 
+static inline struct tun_frame_hdr *tun_ring_frame(struct tun_ring *ring,
+						   unsigned int n)
+{
+	return ring->base + n * ring->frame_size;
+}
+
+/* The RX frame filled last is still with userspace */
+static inline bool tun_ring_readable(struct tun_ring *ring)
+{
+	unsigned int n = (READ_ONCE(ring->rx_head) - 1) & (ring->frame_nr - 1);
+
+	return READ_ONCE(tun_ring_frame(ring, n)->status) & TUN_FRAME_USER;
+}
+
 static inline u32 tun_hashfn(u32 rxhash)
 {
 	return rxhash & 0x3ff;
@@ -522,9 +563,72 @@ static void tun_queue_purge(struct tun_file *tfile)
 	while ((skb = skb_array_consume(&tfile->tx_array)) != NULL)
 		kfree_skb(skb);
 
+	skb_queue_purge(&tfile->sk.sk_write_queue);
 	skb_queue_purge(&tfile->sk.sk_error_queue);
 }
 
+/* Packets sent from a ring are queued on sk_write_queue and handed to GRO
+ * from a NAPI context of the queue.
+ */
+static int tun_napi_poll(struct napi_struct *napi, int budget)
+{
+	struct tun_file *tfile = container_of(napi, struct tun_file, napi);
+	struct sk_buff_head *queue = &tfile->sk.sk_write_queue;
+	struct sk_buff_head process_queue;
+	struct sk_buff *skb;
+	int received = 0;
+
+	__skb_queue_head_init(&process_queue);
+
+	spin_lock(&queue->lock);
+	skb_queue_splice_tail_init(queue, &process_queue);
+	spin_unlock(&queue->lock);
+
+	while (received < budget && (skb = __skb_dequeue(&process_queue))) {
+		napi_gro_receive(napi, skb);
+		received++;
+	}
+
+	if (!skb_queue_empty(&process_queue)) {
+		spin_lock(&queue->lock);
+		skb_queue_splice(&process_queue, queue);
+		spin_unlock(&queue->lock);
+	}
+
+	if (received < budget) {
+		napi_complete_done(napi, received);
+		/* a napi_schedule() between the splice and the completion
+		 * found the queue still scheduled and was lost
+		 */
+		smp_mb();
+		if (!skb_queue_empty(queue))
+			napi_schedule(napi);
+	}
+
+	return received;
+}
+
+static void tun_napi_init(struct tun_struct *tun, struct tun_file *tfile)
+{
+	if (!tfile->ring)
+		return;
+
+	netif_napi_add(tun->dev, &tfile->napi, tun_napi_poll,
+		       NAPI_POLL_WEIGHT);
+	napi_enable(&tfile->napi);
+	tfile->napi_enabled = true;
+}
+
+static void tun_napi_del(struct tun_file *tfile)
+{
+	if (!tfile->napi_enabled)
+		return;
+
+	tfile->napi_enabled = false;
+	napi_disable(&tfile->napi);
+	netif_napi_del(&tfile->napi);
+}
+
 static void __tun_detach(struct tun_file *tfile, bool clean)
 {
 	struct tun_file *ntfile;
@@ -550,11 +654,15 @@ static void __tun_detach(struct tun_file *tfile, bool clean)
 
 		synchronize_net();
 		tun_flow_delete_by_queue(tun, tun->numqueues + 1);
+		if (clean)
+			tun_napi_del(tfile);
 		/* Drop read queue */
 		tun_queue_purge(tfile);
 		tun_set_real_num_queues(tun);
 	} else if (tfile->detached && clean) {
 		tun = tun_enable_queue(tfile);
+		tun_napi_del(tfile);
+		tun_queue_purge(tfile);
 		sock_put(&tfile->sk);
 	}
 
@@ -603,12 +711,14 @@ static void tun_detach_all(struct net_device *dev)
 	synchronize_net();
 	for (i = 0; i < n; i++) {
 		tfile = rtnl_dereference(tun->tfiles[i]);
+		tun_napi_del(tfile);
 		/* Drop read queue */
 		tun_queue_purge(tfile);
 		sock_put(&tfile->sk);
 	}
 	list_for_each_entry_safe(tfile, tmp, &tun->disabled, next) {
 		tun_enable_queue(tfile);
+		tun_napi_del(tfile);
 		tun_queue_purge(tfile);
 		sock_put(&tfile->sk);
 	}
@@ -664,10 +774,12 @@ static int tun_attach(struct tun_struct *tun, struct file *file, bool skip_filte
 	rcu_assign_pointer(tun->tfiles[tun->numqueues], tfile);
 	tun->numqueues++;
 
-	if (tfile->detached)
+	if (tfile->detached) {
 		tun_enable_queue(tfile);
-	else
+	} else {
 		sock_hold(&tfile->sk);
+		tun_napi_init(tun, tfile);
+	}
 
 	tun_set_real_num_queues(tun);
 
@@ -841,11 +953,26 @@ static int tun_net_close(struct net_device *dev)
 	return 0;
 }
 
+static int tun_ring_xmit(struct tun_struct *tun, struct tun_file *tfile,
+			 struct sk_buff *skb);
+static ssize_t tun_ring_send(struct tun_struct *tun, struct tun_file *tfile,
+			     int noblock);
+
+static void tun_notify_read(struct tun_file *tfile)
+{
+	if (tfile->flags & TUN_FASYNC)
+		kill_fasync(&tfile->fasync, SIGIO, POLL_IN);
+	tfile->socket.sk->sk_data_ready(tfile->socket.sk);
+	if (tfile->ring && tfile->ring->eventfd)
+		eventfd_signal(tfile->ring->eventfd, 1);
+}
+
 /* Net device start xmit */
 static netdev_tx_t tun_net_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct tun_struct *tun = netdev_priv(dev);
 	int txq = skb->queue_mapping;
+	bool more = skb->xmit_more;
 	struct tun_file *tfile;
 	u32 numqueues = 0;
 
@@ -908,13 +1035,22 @@ static netdev_tx_t tun_net_xmit(struct sk_buff *skb, struct net_device *dev)
 
 	nf_reset(skb);
 
+	if (tfile->ring) {
+		if (tun_ring_xmit(tun, tfile, skb))
+			goto drop;
+		consume_skb(skb);
+		/* A ring reader is woken once per burst */
+		if (!more)
+			tun_notify_read(tfile);
+		rcu_read_unlock();
+		return NETDEV_TX_OK;
+	}
+
 	if (skb_array_produce(&tfile->tx_array, skb))
 		goto drop;
 
 	/* Notify and wake up reader process */
-	if (tfile->flags & TUN_FASYNC)
-		kill_fasync(&tfile->fasync, SIGIO, POLL_IN);
-	tfile->socket.sk->sk_data_ready(tfile->socket.sk);
+	tun_notify_read(tfile);
 
 	rcu_read_unlock();
 	return NETDEV_TX_OK;
@@ -923,6 +1059,9 @@ drop:
 	this_cpu_inc(tun->pcpu_stats->tx_dropped);
 	skb_tx_error(skb);
 	kfree_skb(skb);
+	/* Don't leave the frames of this burst unannounced */
+	if (txq < numqueues && tfile->ring && !more)
+		tun_notify_read(tfile);
 	rcu_read_unlock();
 	return NET_XMIT_DROP;
 }
@@ -1124,7 +1263,8 @@ static unsigned int tun_chr_poll(struct file *file, poll_table *wait)
 
 	poll_wait(file, sk_sleep(sk), wait);
 
-	if (!skb_array_empty(&tfile->tx_array))
+	if (tfile->ring ? tun_ring_readable(tfile->ring) :
+			  !skb_array_empty(&tfile->tx_array))
 		mask |= POLLIN | POLLRDNORM;
 
 	if (tun->dev->flags & IFF_UP &&
@@ -1170,7 +1310,7 @@ static struct sk_buff *tun_alloc_skb(struct tun_file *tfile,
 /* Get packet from user space buffer */
 static ssize_t tun_get_user(struct tun_struct *tun, struct tun_file *tfile,
 			    void *msg_control, struct iov_iter *from,
-			    int noblock)
+			    int noblock, bool more)
 {
 	struct tun_pi pi = { 0, cpu_to_be16(ETH_P_IP) };
 	struct sk_buff *skb;
@@ -1318,14 +1458,31 @@ static ssize_t tun_get_user(struct tun_struct *tun, struct tun_file *tfile,
 	skb_probe_transport_header(skb, 0);
 
 	rxhash = skb_get_hash(skb);
-	netif_rx_ni(skb);
+	if (tfile->napi_enabled) {
+		struct sk_buff_head *queue = &tfile->sk.sk_write_queue;
+		int queue_len;
+
+		spin_lock_bh(&queue->lock);
+		__skb_queue_tail(queue, skb);
+		queue_len = skb_queue_len(queue);
+		spin_unlock(&queue->lock);
 
-	stats = get_cpu_ptr(tun->pcpu_stats);
+		if (!more || queue_len > NAPI_POLL_WEIGHT)
+			napi_schedule(&tfile->napi);
+
+		local_bh_enable();
+	} else {
+		netif_rx_ni(skb);
+	}
+
+	/* tun_put_user() updates the same syncp from the ring xmit path */
+	local_bh_disable();
+	stats = this_cpu_ptr(tun->pcpu_stats);
 	u64_stats_update_begin(&stats->syncp);
 	stats->rx_packets++;
 	stats->rx_bytes += len;
 	u64_stats_update_end(&stats->syncp);
-	put_cpu_ptr(stats);
+	local_bh_enable();
 
 	tun_flow_update(tun, rxhash, tfile);
 	return total_len;
@@ -1341,7 +1498,12 @@ static ssize_t tun_chr_write_iter(struct kiocb *iocb, struct iov_iter *from)
 	if (!tun)
 		return -EBADFD;
 
-	result = tun_get_user(tun, tfile, NULL, from, file->f_flags & O_NONBLOCK);
+	/* an empty write sends the TX ring */
+	if (tfile->ring && !iov_iter_count(from))
+		result = tun_ring_send(tun, tfile, file->f_flags & O_NONBLOCK);
+	else
+		result = tun_get_user(tun, tfile, NULL, from,
+				      file->f_flags & O_NONBLOCK, false);
 
 	tun_put(tun);
 	return result;
@@ -1435,13 +1597,14 @@ static ssize_t tun_put_user(struct tun_struct *tun,
 	skb_copy_datagram_iter(skb, vlan_offset, iter, skb->len - vlan_offset);
 
 done:
-	/* caller is in process context, */
-	stats = get_cpu_ptr(tun->pcpu_stats);
+	/* caller is in process context, or in BH for a ring */
+	local_bh_disable();
+	stats = this_cpu_ptr(tun->pcpu_stats);
 	u64_stats_update_begin(&stats->syncp);
 	stats->tx_packets++;
 	stats->tx_bytes += skb->len + vlan_hlen;
 	u64_stats_update_end(&stats->syncp);
-	put_cpu_ptr(tun->pcpu_stats);
+	local_bh_enable();
 
 	return total;
 }
@@ -1532,6 +1695,228 @@ static ssize_t tun_chr_read_iter(struct kiocb *iocb, struct iov_iter *to)
 	return ret;
 }
 
+/* Copy a packet from the device into the next RX frame */
+static int tun_ring_xmit(struct tun_struct *tun, struct tun_file *tfile,
+			 struct sk_buff *skb)
+{
+	struct tun_ring *ring = tfile->ring;
+	struct tun_frame_hdr *hdr;
+	struct iov_iter to;
+	struct kvec iov;
+	ssize_t len;
+	u32 status;
+
+	spin_lock(&ring->rx_lock);
+	hdr = tun_ring_frame(ring, ring->rx_head);
+	if (READ_ONCE(hdr->status) != TUN_FRAME_KERNEL) {
+		spin_unlock(&ring->rx_lock);
+		return -ENOBUFS;
+	}
+
+	iov.iov_base = (void *)hdr + TUN_FRAME_HDRLEN;
+	iov.iov_len = ring->frame_size - TUN_FRAME_HDRLEN;
+	iov_iter_kvec(&to, READ | ITER_KVEC, &iov, 1, iov.iov_len);
+	len = tun_put_user(tun, tfile, skb, &to);
+	if (len < 0) {
+		spin_unlock(&ring->rx_lock);
+		return len;
+	}
+
+	status = TUN_FRAME_USER;
+	if (len > iov.iov_len) {
+		status |= TUN_FRAME_TRUNC;
+		len = iov.iov_len;
+	}
+	hdr->len = len;
+	smp_wmb();
+	WRITE_ONCE(hdr->status, status);
+	WRITE_ONCE(ring->rx_head, (ring->rx_head + 1) & (ring->frame_nr - 1));
+	spin_unlock(&ring->rx_lock);
+
+	return 0;
+}
+
+/*
+ * Send the TX frames userspace handed to the kernel, in order. One pass
+ * over the ring at most, so a sender refilling it behind us can't keep
+ * the write() in the kernel.
+ */
+static ssize_t tun_ring_send(struct tun_struct *tun, struct tun_file *tfile,
+			     int noblock)
+{
+	struct tun_ring *ring = tfile->ring;
+	size_t max = ring->frame_size - TUN_FRAME_HDRLEN;
+	struct tun_frame_hdr *hdr;
+	struct iov_iter from;
+	struct kvec iov;
+	ssize_t ret = 0, total = 0;
+	unsigned int n;
+	u32 status;
+
+	mutex_lock(&ring->tx_mutex);
+	for (n = 0; n < ring->frame_nr; n++) {
+		if (n && !(n % NAPI_POLL_WEIGHT))
+			cond_resched();
+
+		hdr = tun_ring_frame(ring, ring->frame_nr + ring->tx_head);
+		if (READ_ONCE(hdr->status) != TUN_FRAME_KERNEL)
+			break;
+		smp_rmb();
+
+		iov.iov_base = (void *)hdr + TUN_FRAME_HDRLEN;
+		iov.iov_len = min_t(size_t, READ_ONCE(hdr->len), max);
+		iov_iter_kvec(&from, WRITE | ITER_KVEC, &iov, 1, iov.iov_len);
+		ret = tun_get_user(tun, tfile, NULL, &from, noblock, true);
+		/* out of sndbuf or interrupted, the frame stays queued */
+		if (ret == -EAGAIN || ret == -ERESTARTSYS || ret == -EINTR)
+			break;
+
+		status = TUN_FRAME_USER;
+		if (ret < 0)
+			status |= TUN_FRAME_DROPPED;
+		else
+			total += ret;
+		smp_wmb();
+		WRITE_ONCE(hdr->status, status);
+		ring->tx_head = (ring->tx_head + 1) & (ring->frame_nr - 1);
+		ret = 0;
+	}
+	mutex_unlock(&ring->tx_mutex);
+
+	/* flush what tun_get_user() left queued for GRO */
+	if (tfile->napi_enabled) {
+		local_bh_disable();
+		napi_schedule(&tfile->napi);
+		local_bh_enable();
+	}
+	if (total && ring->eventfd)
+		eventfd_signal(ring->eventfd, 1);
+
+	return total ? total : ret;
+}
+
+/* The rings are pinned kernel memory, charge them to RLIMIT_MEMLOCK */
+static int tun_ring_charge(struct tun_ring *ring)
+{
+	struct user_struct *user = get_current_user();
+	unsigned long memlock_limit, pages = ring->size >> PAGE_SHIFT;
+
+	memlock_limit = rlimit(RLIMIT_MEMLOCK) >> PAGE_SHIFT;
+
+	atomic_long_add(pages, &user->locked_vm);
+
+	if (atomic_long_read(&user->locked_vm) > memlock_limit &&
+	    !capable(CAP_IPC_LOCK)) {
+		atomic_long_sub(pages, &user->locked_vm);
+		free_uid(user);
+		return -EPERM;
+	}
+	ring->user = user;
+	return 0;
+}
+
+static void tun_ring_uncharge(struct tun_ring *ring)
+{
+	atomic_long_sub(ring->size >> PAGE_SHIFT, &ring->user->locked_vm);
+	free_uid(ring->user);
+}
+
+static struct tun_ring *tun_ring_alloc(struct tun_ring_req *req)
+{
+	struct tun_ring *ring;
+	unsigned int i;
+	int err;
+
+	if (req->flags || !req->frame_nr ||
+	    req->frame_nr > TUN_RING_MAX_FRAMES ||
+	    !is_power_of_2(req->frame_nr) ||
+	    req->frame_size < TUN_FRAME_HDRLEN + ETH_HLEN ||
+	    req->frame_size > TUN_RING_MAX_FRAME_SIZE ||
+	    req->frame_size & (TUN_FRAME_ALIGNMENT - 1))
+		return ERR_PTR(-EINVAL);
+
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+	if (!ring)
+		return ERR_PTR(-ENOMEM);
+
+	ring->frame_size = req->frame_size;
+	ring->frame_nr = req->frame_nr;
+	ring->size = PAGE_ALIGN((size_t)req->frame_size * req->frame_nr * 2);
+	spin_lock_init(&ring->rx_lock);
+	mutex_init(&ring->tx_mutex);
+
+	err = -EINVAL;
+	if (ring->size > TUN_RING_MAX_SIZE)
+		goto err_free;
+
+	err = tun_ring_charge(ring);
+	if (err)
+		goto err_free;
+
+	if (req->eventfd >= 0) {
+		ring->eventfd = eventfd_ctx_fdget(req->eventfd);
+		if (IS_ERR(ring->eventfd)) {
+			err = PTR_ERR(ring->eventfd);
+			ring->eventfd = NULL;
+			goto err_uncharge;
+		}
+	}
+
+	/* SHMLBA aligned, so the user mapping shares the cache colour */
+	ring->base = vmalloc_user(ring->size);
+	if (!ring->base) {
+		err = -ENOMEM;
+		goto err_eventfd;
+	}
+	for (i = 0; i < ring->frame_nr; i++)
+		tun_ring_frame(ring, ring->frame_nr + i)->status =
+			TUN_FRAME_USER;
+
+	return ring;
+
+err_eventfd:
+	if (ring->eventfd)
+		eventfd_ctx_put(ring->eventfd);
+err_uncharge:
+	tun_ring_uncharge(ring);
+err_free:
+	kfree(ring);
+	return ERR_PTR(err);
+}
+
+static void tun_ring_free(struct tun_ring *ring)
+{
+	if (!ring)
+		return;
+
+	vfree(ring->base);
+	if (ring->eventfd)
+		eventfd_ctx_put(ring->eventfd);
+	tun_ring_uncharge(ring);
+	kfree(ring);
+}
+
+static int tun_set_ring(struct tun_file *tfile, void __user *argp)
+{
+	struct net *net = sock_net(&tfile->sk);
+	struct tun_ring_req req;
+	struct tun_ring *ring;
+
+	if (!ns_capable(net->user_ns, CAP_NET_ADMIN))
+		return -EPERM;
+	if (tfile->ring)
+		return -EBUSY;
+	if (copy_from_user(&req, argp, sizeof(req)))
+		return -EFAULT;
+
+	ring = tun_ring_alloc(&req);
+	if (IS_ERR(ring))
+		return PTR_ERR(ring);
+
+	tfile->ring = ring;
+	return 0;
+}
+
 static void tun_free_netdev(struct net_device *dev)
 {
 	struct tun_struct *tun = netdev_priv(dev);
@@ -1601,7 +1986,7 @@ static int tun_sendmsg(struct socket *sock, struct msghdr *m, size_t total_len)
 		return -EBADFD;
 
 	ret = tun_get_user(tun, tfile, m->msg_control, &m->msg_iter,
-			   m->msg_flags & MSG_DONTWAIT);
+			   m->msg_flags & MSG_DONTWAIT, false);
 	tun_put(tun);
 	return ret;
 }
@@ -2055,6 +2440,15 @@ static long __tun_chr_ioctl(struct file *file, unsigned int cmd,
 		tfile->ifindex = ifindex;
 		goto unlock;
 	}
+	if (cmd == TUNSETRING) {
+		/* the rings must be there before the queue is attached */
+		ret = -EBUSY;
+		if (tun)
+			goto unlock;
+
+		ret = tun_set_ring(tfile, argp);
+		goto unlock;
+	}
 
 	ret = -EBADFD;
 	if (!tun)
@@ -2295,6 +2689,7 @@ static long tun_chr_compat_ioctl(struct file *file,
 	case TUNSETTXFILTER:
 	case TUNGETSNDBUF:
 	case TUNSETSNDBUF:
+	case TUNSETRING:
 	case SIOCGIFHWADDR:
 	case SIOCSIFHWADDR:
 		arg = (unsigned long)compat_ptr(arg);
@@ -2346,6 +2741,8 @@ static int tun_chr_open(struct inode *inode, struct file * file)
 	RCU_INIT_POINTER(tfile->tun, NULL);
 	tfile->flags = 0;
 	tfile->ifindex = 0;
+	tfile->ring = NULL;
+	tfile->napi_enabled = false;
 
 	init_waitqueue_head(&tfile->wq.wait);
 	RCU_INIT_POINTER(tfile->socket.wq, &tfile->wq);
@@ -2366,11 +2763,24 @@ static int tun_chr_open(struct inode *inode, struct file * file)
 	return 0;
 }
 
+static int tun_chr_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct tun_file *tfile = file->private_data;
+
+	if (!tfile->ring)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, tfile->ring->base, vma->vm_pgoff);
+}
+
 static int tun_chr_close(struct inode *inode, struct file *file)
 {
 	struct tun_file *tfile = file->private_data;
+	struct tun_ring *ring = tfile->ring;
 
+	/* may free tfile, the device no longer sees the ring afterwards */
 	tun_detach(tfile, true);
+	tun_ring_free(ring);
 
 	return 0;
 }
@@ -2402,6 +2812,7 @@ static const struct file_operations tun_fops = {
 	.read_iter  = tun_chr_read_iter,
 	.write_iter = tun_chr_write_iter,
 	.poll	= tun_chr_poll,
+	.mmap	= tun_chr_mmap,
 	.unlocked_ioctl	= tun_chr_ioctl,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl = tun_chr_compat_ioctl,
@@ -9,14 +9,18 @@
  */
 
 #include <linux/err.h>
+#include <linux/hrtimer.h>
 #include <linux/io.h>
 #include <linux/ioport.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
 #include <linux/pwm.h>
+#include <linux/pwm_mediatek.h>
 #include <linux/slab.h>
+#include <linux/sysfs.h>
 #include <linux/types.h>
 
 #define NUM_PWM		4
@@ -30,15 +34,55 @@
 #define PWMDWIDTH		0x2c
 #define PWMTHRES		0x30
 
+/* shortest step of the waveform sequencer */
+#define MTK_PWM_WAVE_MIN_STEP	(10 * NSEC_PER_USEC)
+
+struct mtk_pwm_chip;
+
+/**
+ * struct mtk_pwm_wave - waveform sequencer state of one channel
+ *
+ * @timer: hrtimer stepping through the duty values
+ * @pc: pwm chip the channel belongs to
+ * @num: hardware channel
+ * @thres: PWMTHRES values, precomputed from the queued duty values
+ * @count: number of values in @thres
+ * @pos: next value to load
+ * @step: time between two values
+ * @repeat: restart from the first value after the last one
+ * @steps: values loaded so far
+ * @missed: values skipped because the timer fired too late
+ */
+struct mtk_pwm_wave {
+	struct hrtimer timer;
+	struct mtk_pwm_chip *pc;
+	unsigned int num;
+	u32 *thres;
+	unsigned int count;
+	unsigned int pos;
+	ktime_t step;
+	bool repeat;
+	u64 steps;
+	u32 missed;
+};
+
 /**
  * struct mtk_pwm_chip - struct representing pwm chip
  *
  * @mmio_base: base address of pwm chip
  * @chip: linux pwm chip representation
+ * @resolution: ns per PWMDWIDTH/PWMTHRES unit, set by config
+ * @period: configured period in ns
+ * @wave: waveform sequencers
+ * @wave_lock: serializes starting and stopping the sequencers
  */
 struct mtk_pwm_chip {
 	void __iomem *mmio_base;
 	struct pwm_chip chip;
+	u32 resolution[NUM_PWM];
+	u32 period[NUM_PWM];
+	struct mtk_pwm_wave wave[NUM_PWM];
+	struct mutex wave_lock;
 };
 
 static inline struct mtk_pwm_chip *to_mtk_pwm_chip(struct pwm_chip *chip)
@@ -59,6 +103,14 @@ static inline void mtk_pwm_writel(struct mtk_pwm_chip *chip,
 	iowrite32(val, chip->mmio_base + 0x10 + (num * 0x40) + offset);
 }
 
+static void mtk_pwm_wave_stop(struct mtk_pwm_wave *wave)
+{
+	hrtimer_cancel(&wave->timer);
+	kfree(wave->thres);
+	wave->thres = NULL;
+	wave->count = 0;
+}
+
 static int mtk_pwm_config(struct pwm_chip *chip, struct pwm_device *pwm,
 			    int duty_ns, int period_ns)
 {
@@ -74,9 +126,15 @@ static int mtk_pwm_config(struct pwm_chip *chip, struct pwm_device *pwm,
 	if (clkdiv > 7)
 		return -1;
 
+	/* a waveform's thresholds were computed for the old resolution */
+	mutex_lock(&pc->wave_lock);
+	mtk_pwm_wave_stop(&pc->wave[pwm->hwpwm]);
 	mtk_pwm_writel(pc, pwm->hwpwm, PWMCON, BIT(15) | BIT(3) | clkdiv);
 	mtk_pwm_writel(pc, pwm->hwpwm, PWMDWIDTH, period_ns / resolution);
 	mtk_pwm_writel(pc, pwm->hwpwm, PWMTHRES, duty_ns / resolution);
+	pc->resolution[pwm->hwpwm] = resolution;
+	pc->period[pwm->hwpwm] = period_ns;
+	mutex_unlock(&pc->wave_lock);
 	return 0;
 }
 
@@ -97,6 +155,10 @@ static void mtk_pwm_disable(struct pwm_chip *chip, struct pwm_device *pwm)
 	struct mtk_pwm_chip *pc = to_mtk_pwm_chip(chip);
 	u32 val;
 
+	mutex_lock(&pc->wave_lock);
+	mtk_pwm_wave_stop(&pc->wave[pwm->hwpwm]);
+	mutex_unlock(&pc->wave_lock);
+
 	val = ioread32(pc->mmio_base);
 	val &= ~BIT(pwm->hwpwm);
 	iowrite32(val, pc->mmio_base);
@@ -109,11 +171,197 @@ static const struct pwm_ops mtk_pwm_ops = {
 	.owner = THIS_MODULE,
 };
 
+/*
+ * Only the duty cycle changes while a waveform plays, and PWMTHRES is
+ * picked up by the hardware at the next period, so a single register
+ * write per step is enough. If the timer runs late, the values that
+ * should have played in the meantime are skipped to stay in time.
+ */
+static enum hrtimer_restart mtk_pwm_wave_timer(struct hrtimer *timer)
+{
+	struct mtk_pwm_wave *wave = container_of(timer, struct mtk_pwm_wave,
+						 timer);
+	u64 overruns;
+
+	mtk_pwm_writel(wave->pc, wave->num, PWMTHRES, wave->thres[wave->pos]);
+	wave->steps++;
+
+	overruns = hrtimer_forward_now(timer, wave->step);
+	if (overruns > 1)
+		wave->missed += overruns - 1;
+
+	wave->pos += overruns;
+	if (wave->pos >= wave->count) {
+		if (!wave->repeat)
+			return HRTIMER_NORESTART;
+		wave->pos %= wave->count;
+	}
+
+	return HRTIMER_RESTART;
+}
+
+static int mtk_pwm_wave_start(struct mtk_pwm_chip *pc, unsigned int num,
+			      const u32 *duty_ns, unsigned int count,
+			      u32 step_ns, u32 flags)
+{
+	struct mtk_pwm_wave *wave = &pc->wave[num];
+	u32 *thres;
+	int i;
+
+	if (!count || count > MTK_PWM_WAVE_MAX ||
+	    step_ns < MTK_PWM_WAVE_MIN_STEP)
+		return -EINVAL;
+
+	thres = kmalloc_array(count, sizeof(*thres), GFP_KERNEL);
+	if (!thres)
+		return -ENOMEM;
+
+	/* the period must not change between scaling and playing */
+	mutex_lock(&pc->wave_lock);
+
+	/* config must have set up the period first */
+	if (!pc->period[num])
+		goto err_inval;
+
+	for (i = 0; i < count; i++) {
+		if (duty_ns[i] > pc->period[num])
+			goto err_inval;
+		thres[i] = duty_ns[i] / pc->resolution[num];
+	}
+
+	mtk_pwm_wave_stop(wave);
+	wave->thres = thres;
+	wave->count = count;
+	wave->pos = 0;
+	wave->step = ns_to_ktime(step_ns);
+	wave->repeat = !!(flags & MTK_PWM_WAVE_REPEAT);
+	hrtimer_start(&wave->timer, 0, HRTIMER_MODE_REL);
+	mutex_unlock(&pc->wave_lock);
+
+	return 0;
+
+err_inval:
+	mutex_unlock(&pc->wave_lock);
+	kfree(thres);
+	return -EINVAL;
+}
+
+/**
+ * mtk_pwm_waveform_start() - play a sequence of duty cycles
+ * @pwm: pwm device, must belong to this driver and be configured
+ * @duty_ns: duty cycle values in ns, at most the configured period
+ * @count: number of values, up to MTK_PWM_WAVE_MAX
+ * @step_ns: time each value is held
+ * @flags: MTK_PWM_WAVE_REPEAT to loop over the values
+ *
+ * Replaces a waveform already playing on the channel. The period stays
+ * as set by pwm_config(). Returns 0 or a negative error.
+ */
+int mtk_pwm_waveform_start(struct pwm_device *pwm, const u32 *duty_ns,
+			   unsigned int count, u32 step_ns, u32 flags)
+{
+	if (pwm->chip->ops != &mtk_pwm_ops)
+		return -ENODEV;
+
+	return mtk_pwm_wave_start(to_mtk_pwm_chip(pwm->chip), pwm->hwpwm,
+				  duty_ns, count, step_ns, flags);
+}
+EXPORT_SYMBOL_GPL(mtk_pwm_waveform_start);
+
+/**
+ * mtk_pwm_waveform_stop() - stop the waveform playing on a channel
+ * @pwm: pwm device
+ *
+ * The duty cycle stays at the last value played.
+ */
+void mtk_pwm_waveform_stop(struct pwm_device *pwm)
+{
+	struct mtk_pwm_chip *pc;
+
+	if (pwm->chip->ops != &mtk_pwm_ops)
+		return;
+
+	pc = to_mtk_pwm_chip(pwm->chip);
+	mutex_lock(&pc->wave_lock);
+	mtk_pwm_wave_stop(&pc->wave[pwm->hwpwm]);
+	mutex_unlock(&pc->wave_lock);
+}
+EXPORT_SYMBOL_GPL(mtk_pwm_waveform_stop);
+
+static ssize_t waveform_write(struct file *filp, struct kobject *kobj,
+			      struct bin_attribute *attr, char *buf,
+			      loff_t off, size_t count)
+{
+	struct device *dev = kobj_to_dev(kobj);
+	struct mtk_pwm_chip *pc = dev_get_drvdata(dev);
+	struct mtk_pwm_waveform *w = (struct mtk_pwm_waveform *)buf;
+	int ret;
+
+	/* the whole request has to come in a single write */
+	if (off || count < sizeof(*w))
+		return -EINVAL;
+	if (w->channel >= NUM_PWM ||
+	    count != sizeof(*w) + w->count * sizeof(w->duty_ns[0]))
+		return -EINVAL;
+
+	if (!w->count) {
+		mutex_lock(&pc->wave_lock);
+		mtk_pwm_wave_stop(&pc->wave[w->channel]);
+		mutex_unlock(&pc->wave_lock);
+		return count;
+	}
+
+	ret = mtk_pwm_wave_start(pc, w->channel, w->duty_ns, w->count,
+				 w->step_ns, w->flags);
+
+	return ret ? ret : count;
+}
+
+static BIN_ATTR(waveform, 0200, NULL, waveform_write,
+		sizeof(struct mtk_pwm_waveform) +
+		MTK_PWM_WAVE_MAX * sizeof(u32));
+
+static ssize_t waveform_stats_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct mtk_pwm_chip *pc = dev_get_drvdata(dev);
+	struct mtk_pwm_wave *wave;
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < NUM_PWM; i++) {
+		wave = &pc->wave[i];
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "pwm%d: %s steps %llu missed %u\n", i,
+				 hrtimer_active(&wave->timer) ?
+				 "running" : "stopped",
+				 wave->steps, wave->missed);
+	}
+
+	return len;
+}
+static DEVICE_ATTR_RO(waveform_stats);
+
+static struct attribute *mtk_pwm_attrs[] = {
+	&dev_attr_waveform_stats.attr,
+	NULL,
+};
+
+static struct bin_attribute *mtk_pwm_bin_attrs[] = {
+	&bin_attr_waveform,
+	NULL,
+};
+
+static const struct attribute_group mtk_pwm_group = {
+	.attrs = mtk_pwm_attrs,
+	.bin_attrs = mtk_pwm_bin_attrs,
+};
+
 static int mtk_pwm_probe(struct platform_device *pdev)
 {
 	struct mtk_pwm_chip *pc;
 	struct resource *r;
-	int ret;
+	int ret, i;
 
 	pc = devm_kzalloc(&pdev->dev, sizeof(*pc), GFP_KERNEL);
 	if (!pc)
@@ -126,16 +374,32 @@ static int mtk_pwm_probe(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, pc);
 
+	mutex_init(&pc->wave_lock);
+	for (i = 0; i < NUM_PWM; i++) {
+		hrtimer_init(&pc->wave[i].timer, CLOCK_MONOTONIC,
+			     HRTIMER_MODE_REL);
+		pc->wave[i].timer.function = mtk_pwm_wave_timer;
+		pc->wave[i].pc = pc;
+		pc->wave[i].num = i;
+	}
+
+	ret = sysfs_create_group(&pdev->dev.kobj, &mtk_pwm_group);
+	if (ret)
+		return ret;
+
 	pc->chip.dev = &pdev->dev;
 	pc->chip.ops = &mtk_pwm_ops;
 	pc->chip.base = -1;
 	pc->chip.npwm = NUM_PWM;
 
 	ret = pwmchip_add(&pc->chip);
-	if (ret < 0)
+	if (ret < 0) {
 		dev_err(&pdev->dev, "pwmchip_add() failed: %d\n", ret);
+		sysfs_remove_group(&pdev->dev.kobj, &mtk_pwm_group);
+		return ret;
+	}
 
-	return ret;
+	return 0;
 }
 
 static int mtk_pwm_remove(struct platform_device *pdev)
@@ -143,8 +407,12 @@ static int mtk_pwm_remove(struct platform_device *pdev)
 	struct mtk_pwm_chip *pc = platform_get_drvdata(pdev);
 	int i;
 
-	for (i = 0; i < NUM_PWM; i++)
+	sysfs_remove_group(&pdev->dev.kobj, &mtk_pwm_group);
+
+	for (i = 0; i < NUM_PWM; i++) {
+		mtk_pwm_wave_stop(&pc->wave[i]);
 		pwm_disable(&pc->chip.pwms[i]);
+	}
 
 	return pwmchip_remove(&pc->chip);
 }
@@ -366,6 +366,15 @@ static int mt7621_spi_setup(struct spi_device *spi)
 {
 	struct mt7621_spi *rs = spidev_to_mt7621_spi(spi);
 
+	/*
+	 * An XIP kernel runs from the flash on CS0, a command mode transfer
+	 * would take the instruction stream away.
+	 */
+	if (IS_ENABLED(CONFIG_XIP_KERNEL) && spi->chip_select == 0) {
+		dev_err(&spi->dev, "CS0 flash is in use by the XIP kernel\n");
+		return -EBUSY;
+	}
+
 	if ((spi->max_speed_hz == 0) ||
 		(spi->max_speed_hz > (rs->sys_freq / 2)))
 		spi->max_speed_hz = (rs->sys_freq / 2);
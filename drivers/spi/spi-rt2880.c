@@ -307,6 +307,15 @@ static int rt2880_spi_setup(struct spi_device *spi)
 	struct rt2880_spi *rs = spi_master_get_devdata(master);
 	u32 reg, old_reg, arbit_off;
 
+	/*
+	 * An XIP kernel runs from the flash on CS0, a command mode transfer
+	 * would take the instruction stream away.
+	 */
+	if (IS_ENABLED(CONFIG_XIP_KERNEL) && spi->chip_select == 0) {
+		dev_err(&spi->dev, "CS0 flash is in use by the XIP kernel\n");
+		return -EBUSY;
+	}
+
 	if ((spi->max_speed_hz > master->max_speed_hz) ||
 			(spi->max_speed_hz < master->min_speed_hz)) {
 		dev_err(&spi->dev, "invalide requested speed %d Hz\n",
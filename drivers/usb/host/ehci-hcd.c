@@ -543,7 +543,9 @@ static int ehci_init(struct usb_hcd *hcd)
 	/* clear interrupt enables, set irq latency */
 	if (log2_irq_thresh < 0 || log2_irq_thresh > 6)
 		log2_irq_thresh = 0;
-	temp = 1 << (16 + log2_irq_thresh);
+	if (!ehci->irq_threshold)
+		ehci->irq_threshold = 1 << log2_irq_thresh;
+	temp = ehci->irq_threshold << 16;
 	if (HCC_PER_PORT_CHANGE_EVENT(hcc_params)) {
 		ehci->has_ppcd = 1;
 		ehci_dbg(ehci, "enable per-port change event\n");
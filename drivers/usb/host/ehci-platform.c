@@ -60,6 +60,8 @@ static int ehci_platform_reset(struct usb_hcd *hcd)
 	int retval;
 
 	ehci->has_synopsys_hc_bug = pdata->has_synopsys_hc_bug;
+	if (pdata->irq_threshold)
+		ehci->irq_threshold = pdata->irq_threshold;
 
 	if (pdata->pre_setup) {
 		retval = pdata->pre_setup(hcd);
@@ -203,6 +205,17 @@ static int ehci_platform_probe(struct platform_device *dev)
 					  "has-transaction-translator"))
 			hcd->has_tt = 1;
 
+		/* batch completions, e.g. for usb modems on slow cpus */
+		of_property_read_u32(dev->dev.of_node, "irq-threshold",
+				     &ehci->irq_threshold);
+		if (ehci->irq_threshold &&
+		    (!is_power_of_2(ehci->irq_threshold) ||
+		     ehci->irq_threshold > 64)) {
+			dev_warn(&dev->dev, "invalid irq-threshold %u\n",
+				 ehci->irq_threshold);
+			ehci->irq_threshold = 0;
+		}
+
 		priv->num_phys = of_count_phandle_with_args(dev->dev.of_node,
 				"phys", "#phy-cells");
 
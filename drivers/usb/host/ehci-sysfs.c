@@ -159,6 +159,51 @@ out_unlock:
 static DEVICE_ATTR(uframe_periodic_max, 0644, show_uframe_periodic_max, store_uframe_periodic_max);
 
 
+/*
+ * Display / Set the interrupt threshold (ITC), in microframes.
+ * Higher values let one interrupt complete more URBs at once.
+ */
+static ssize_t show_irq_threshold(struct device *dev,
+				  struct device_attribute *attr,
+				  char *buf)
+{
+	struct ehci_hcd		*ehci;
+
+	ehci = hcd_to_ehci(dev_get_drvdata(dev));
+	return scnprintf(buf, PAGE_SIZE, "%u\n", ehci->irq_threshold);
+}
+
+static ssize_t store_irq_threshold(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct ehci_hcd		*ehci;
+	unsigned		irq_threshold;
+	unsigned long		flags;
+
+	ehci = hcd_to_ehci(dev_get_drvdata(dev));
+	if (kstrtouint(buf, 0, &irq_threshold) < 0)
+		return -EINVAL;
+
+	if (!is_power_of_2(irq_threshold) || irq_threshold > 64) {
+		ehci_info(ehci, "rejecting invalid request for "
+				"irq_threshold=%u\n", irq_threshold);
+		return -EINVAL;
+	}
+
+	spin_lock_irqsave (&ehci->lock, flags);
+	ehci->irq_threshold = irq_threshold;
+	ehci->command &= ~CMD_ITC;
+	ehci->command |= irq_threshold << 16;
+	if (ehci->rh_state == EHCI_RH_RUNNING)
+		ehci_writel(ehci, ehci->command, &ehci->regs->command);
+	spin_unlock_irqrestore (&ehci->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR(irq_threshold, 0644, show_irq_threshold, store_irq_threshold);
+
+
 static inline int create_sysfs_files(struct ehci_hcd *ehci)
 {
 	struct device	*controller = ehci_to_hcd(ehci)->self.controller;
@@ -171,6 +216,10 @@ static inline int create_sysfs_files(struct ehci_hcd *ehci)
 		goto out;
 
 	i = device_create_file(controller, &dev_attr_uframe_periodic_max);
+	if (i)
+		goto out;
+
+	i = device_create_file(controller, &dev_attr_irq_threshold);
 out:
 	return i;
 }
@@ -184,4 +233,5 @@ static inline void remove_sysfs_files(struct ehci_hcd *ehci)
 		device_remove_file(controller, &dev_attr_companion);
 
 	device_remove_file(controller, &dev_attr_uframe_periodic_max);
+	device_remove_file(controller, &dev_attr_irq_threshold);
 }
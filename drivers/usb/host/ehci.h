@@ -179,6 +179,7 @@ struct ehci_hcd {			/* one per controller */
 	unsigned		isoc_count;	/* isoc activity count */
 	unsigned		periodic_count;	/* periodic activity count */
 	unsigned		uframe_periodic_max; /* max periodic time per uframe */
+	unsigned		irq_threshold;	/* uframes, 0 = module param */
 
 
 	/* list of itds & sitds completed while now_frame was still active */
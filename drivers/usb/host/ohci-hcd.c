@@ -81,6 +81,12 @@ static void ohci_dump(struct ohci_hcd *ohci);
 static void ohci_stop(struct usb_hcd *hcd);
 static void io_watchdog_func(unsigned long _ohci);
 
+/* Let bulk completions share interrupts, at the cost of latency */
+static unsigned bulk_irq_delay;
+module_param (bulk_irq_delay, uint, 0644);
+MODULE_PARM_DESC (bulk_irq_delay,
+	"frames (0-6) the last TD of a bulk urb may delay its interrupt");
+
 #include "ohci-hub.c"
 #include "ohci-dbg.c"
 #include "ohci-mem.c"
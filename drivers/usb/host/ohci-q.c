@@ -537,6 +537,8 @@ td_fill (struct ohci_hcd *ohci, u32 info,
 	if (index != (urb_priv->length - 1)
 			|| (urb->transfer_flags & URB_NO_INTERRUPT))
 		info |= TD_DI_SET (6);
+	else if (usb_pipebulk (urb->pipe))
+		info |= TD_DI_SET (min (bulk_irq_delay, 6U));
 
 	/* use this td as the next dummy */
 	td_pt = urb_priv->td [index];
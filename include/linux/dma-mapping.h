@@ -61,6 +61,13 @@
  * allocation failure reports (similarly to __GFP_NOWARN).
  */
 #define DMA_ATTR_NO_WARN	(1UL << 8)
+/*
+ * DMA_ATTR_CPU_CLEAN: Nothing the CPU may have written to the buffer needs
+ * to reach memory, either because it has not written to it or because the
+ * device overwrites all of it. Platforms with non-coherent caches can skip
+ * the writeback for such buffers.
+ */
+#define DMA_ATTR_CPU_CLEAN	(1UL << 9)
 
 /*
  * A dma_addr_t can hold any valid DMA or bus address for the platform.
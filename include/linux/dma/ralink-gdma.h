@@ -0,0 +1,25 @@
+/*
+ * Ralink/MediaTek GDMA helpers for its clients
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _DMA_RALINK_GDMA_H
+#define _DMA_RALINK_GDMA_H
+
+struct dma_chan;
+struct seq_file;
+
+#if IS_ENABLED(CONFIG_DMA_RALINK) && IS_ENABLED(CONFIG_DEBUG_FS)
+/* Print the cyclic period jitter of a gdma channel, for client debugfs */
+void gdma_dma_jitter_show(struct seq_file *s, struct dma_chan *c);
+#else
+static inline void gdma_dma_jitter_show(struct seq_file *s,
+		struct dma_chan *c)
+{
+}
+#endif
+
+#endif /* _DMA_RALINK_GDMA_H */
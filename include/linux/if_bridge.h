@@ -48,6 +48,7 @@ struct br_ip_list {
 #define BR_MCAST_FLOOD		BIT(11)
 #define BR_MULTICAST_TO_UNICAST	BIT(12)
 #define BR_ISOLATE_MODE		BIT(13)
+#define BR_NF_BYPASS		BIT(14)
 
 #define BR_DEFAULT_AGEING_TIME	(300 * HZ)
 
@@ -18,6 +18,7 @@
 #include <linux/if.h>
 #include <linux/netdevice.h>
 #include <linux/ppp_channel.h>
+#include <linux/rhashtable.h>
 #include <linux/skbuff.h>
 #include <linux/workqueue.h>
 #include <uapi/linux/if_pppox.h>
@@ -27,6 +28,13 @@ static inline struct pppoe_hdr *pppoe_hdr(const struct sk_buff *skb)
 	return (struct pppoe_hdr *)skb_network_header(skb);
 }
 
+/* Session table key, no padding so that it can be hashed as words */
+struct pppoe_key {
+	int			ifindex;
+	__be16			sid;
+	unsigned char		remote[ETH_ALEN];
+};
+
 struct pppoe_opt {
 	struct net_device      *dev;	  /* device associated with socket*/
 	int			ifindex;  /* ifindex of device associated with socket */
@@ -34,6 +42,10 @@ struct pppoe_opt {
 	struct sockaddr_pppox	relay;	  /* what socket data will be
 					     relayed to (PPPoE relaying) */
 	struct work_struct      padt_work;/* Work item for handling PADT */
+	struct pppoe_key	key;	  /* session table key */
+	struct rhash_head	node;	  /* in the session table */
+	struct hlist_node	list;	  /* in the list of sessions */
+	struct pcpu_sw_netstats __percpu *stats; /* session data counters */
 };
 
 struct pptp_opt {
@@ -49,7 +61,6 @@ struct pppox_sock {
 	/* struct sock must be the first member of pppox_sock */
 	struct sock sk;
 	struct ppp_channel chan;
-	struct pppox_sock	*next;	  /* for hash table */
 	union {
 		struct pppoe_opt pppoe;
 		struct pptp_opt  pptp;
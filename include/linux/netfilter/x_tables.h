@@ -233,6 +233,11 @@ struct xt_table_info {
 	unsigned int stacksize;
 	void ***jumpstack;
 
+#ifdef CONFIG_IP_NF_IPTABLES_COMPILE
+	/* ip_tables rule skip steps, NULL when walked linearly */
+	void *compiled;
+#endif
+
 	unsigned char entries[0] __aligned(8);
 };
 
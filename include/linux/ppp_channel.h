@@ -32,6 +32,10 @@ struct ppp_channel_ops {
 	int	(*start_xmit)(struct ppp_channel *, struct sk_buff *);
 	/* Handle an ioctl call that has come in via /dev/ppp. */
 	int	(*ioctl)(struct ppp_channel *, unsigned int, unsigned long);
+	/* Optional. Send a data packet from the fast path, which holds no
+	   lock and may call it on several CPUs at once. It always takes
+	   the packet. */
+	void	(*fast_xmit)(struct ppp_channel *, struct sk_buff *);
 };
 
 struct ppp_channel {
@@ -53,6 +57,11 @@ extern void ppp_output_wakeup(struct ppp_channel *);
    The packet should have just the 2-byte PPP protocol header. */
 extern void ppp_input(struct ppp_channel *, struct sk_buff *);
 
+/* Called by the channel, in BH context, to hand a received packet straight
+   to the network stack when the unit needs nothing else done to it.
+   Returns false if the packet must go through ppp_input instead. */
+extern bool ppp_fast_input(struct ppp_channel *, struct sk_buff *);
+
 /* Called by the channel when an input error occurs, indicating
    that we may have missed a packet. */
 extern void ppp_input_error(struct ppp_channel *, int code);
@@ -82,6 +91,9 @@ extern char *ppp_dev_name(struct ppp_channel *);
  * channel.  The generic layer will ensure that nothing is executing
  * in the start_xmit and ioctl routines for the channel by the time
  * that ppp_unregister_channel returns.
+ * For channels with a fast_xmit routine the same goes for fast_xmit,
+ * and ppp_fast_input may still be running when ppp_unregister_channel
+ * is called: it waits for an RCU grace period before tearing down.
  */
 
 #endif /* __KERNEL__ */
@@ -0,0 +1,28 @@
+#ifndef __LINUX_PWM_MEDIATEK_H
+#define __LINUX_PWM_MEDIATEK_H
+
+#include <linux/errno.h>
+#include <linux/types.h>
+#include <uapi/linux/pwm_mediatek.h>
+
+struct pwm_device;
+
+#if IS_ENABLED(CONFIG_PWM_MEDIATEK)
+int mtk_pwm_waveform_start(struct pwm_device *pwm, const u32 *duty_ns,
+			   unsigned int count, u32 step_ns, u32 flags);
+void mtk_pwm_waveform_stop(struct pwm_device *pwm);
+#else
+static inline int mtk_pwm_waveform_start(struct pwm_device *pwm,
+					 const u32 *duty_ns,
+					 unsigned int count, u32 step_ns,
+					 u32 flags)
+{
+	return -ENODEV;
+}
+
+static inline void mtk_pwm_waveform_stop(struct pwm_device *pwm)
+{
+}
+#endif
+
+#endif
@@ -70,6 +70,8 @@ struct ehci_regs {
 
 /* EHCI 1.1 addendum */
 #define CMD_HIRD	(0xf<<24)	/* host initiated resume duration */
+/* 23:16 is r/w intr rate, in microframes; default "8" == 1/msec */
+#define CMD_ITC		(0xff<<16)	/* interrupt threshold control */
 #define CMD_PPCEE	(1<<15)		/* per port change event enable */
 #define CMD_FSP		(1<<14)		/* fully synchronized prefetch */
 #define CMD_ASPE	(1<<13)		/* async schedule prefetch enable */
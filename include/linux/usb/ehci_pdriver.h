@@ -36,6 +36,8 @@ struct usb_hcd;
  *			watchdog to run.
  * @reset_on_resume:	set to 1 if the controller needs to be reset after
  * 			a suspend / resume cycle (but can't detect that itself).
+ * @irq_threshold:	interrupt threshold in microframes (1, 2, 4, ... 64),
+ *			0 to use the log2_irq_thresh module parameter.
  *
  * These are general configuration options for the EHCI controller. All of
  * these options are activating more or less workarounds for some hardware.
@@ -50,6 +52,7 @@ struct usb_ehci_pdata {
 	unsigned	reset_on_resume:1;
 	unsigned	dma_mask_64:1;
 	unsigned	ignore_oc:1;
+	unsigned	irq_threshold;
 
 	/* Turn on all power and clocks */
 	int (*power_on)(struct platform_device *pdev);
@@ -3,6 +3,13 @@
 
 #include <net/netfilter/nf_nat.h>
 
+struct nf_masq_entry;
+
+/* Links a masqueraded conntrack to its entry in the cleanup index */
+struct nf_conn_masq {
+	struct nf_masq_entry *entry;
+};
+
 unsigned int
 nf_nat_masquerade_ipv4(struct sk_buff *skb, unsigned int hooknum,
 		       const struct nf_nat_range *range,
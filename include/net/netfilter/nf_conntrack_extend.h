@@ -29,6 +29,9 @@ enum nf_ct_ext_id {
 #endif
 #if IS_ENABLED(CONFIG_NF_CONNTRACK_RTCACHE)
 	NF_CT_EXT_RTCACHE,
+#endif
+#if IS_ENABLED(CONFIG_NF_NAT_MASQUERADE_IPV4)
+	NF_CT_EXT_MASQ,
 #endif
 	NF_CT_EXT_NUM,
 };
@@ -43,6 +46,7 @@ enum nf_ct_ext_id {
 #define NF_CT_EXT_LABELS_TYPE struct nf_conn_labels
 #define NF_CT_EXT_SYNPROXY_TYPE struct nf_conn_synproxy
 #define NF_CT_EXT_RTCACHE_TYPE struct nf_conn_rtcache
+#define NF_CT_EXT_MASQ_TYPE struct nf_conn_masq
 
 /* Extensions: optional stuff which isn't permanently in struct. */
 struct nf_ct_ext {
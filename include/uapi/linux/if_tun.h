@@ -56,6 +56,7 @@
  */
 #define TUNSETVNETBE _IOW('T', 222, int)
 #define TUNGETVNETBE _IOR('T', 223, int)
+#define TUNSETRING   _IOW('T', 224, struct tun_ring_req)
 
 /* TUNSETIFF ifr flags */
 #define IFF_TUN		0x0001
@@ -89,6 +90,38 @@ struct tun_pi {
 	__be16 proto;
 };
 
+/*
+ * Shared memory rings (TUNSETRING), set up before TUNSETIFF and mapped with
+ * mmap(2) at offset 0. The first frame_nr frames carry packets from the
+ * device to userspace (RX), the next frame_nr frames the other way (TX).
+ * Each frame starts with a tun_frame_hdr and the packet, in the format
+ * read(2) and write(2) use, follows at TUN_FRAME_HDRLEN. A write(2) of
+ * zero bytes sends the TX frames handed to the kernel, at most frame_nr
+ * of them per call.
+ */
+struct tun_ring_req {
+	__u32	frame_size;	/* multiple of TUN_FRAME_ALIGNMENT */
+	__u32	frame_nr;	/* frames per ring, power of 2 */
+	__s32	eventfd;	/* signalled once per batch, or -1 */
+	__u32	flags;		/* must be zero */
+};
+
+struct tun_frame_hdr {
+	__u32	status;
+	__u32	len;
+};
+
+#define TUN_FRAME_ALIGNMENT	16
+#define TUN_FRAME_ALIGN(x)	(((x) + TUN_FRAME_ALIGNMENT - 1) & \
+				 ~(TUN_FRAME_ALIGNMENT - 1))
+#define TUN_FRAME_HDRLEN	TUN_FRAME_ALIGN(sizeof(struct tun_frame_hdr))
+
+/* tun_frame_hdr status */
+#define TUN_FRAME_KERNEL	0x0000
+#define TUN_FRAME_USER		0x0001	/* owned by userspace */
+#define TUN_FRAME_TRUNC		0x0002	/* RX: packet did not fit */
+#define TUN_FRAME_DROPPED	0x0004	/* TX: packet was rejected */
+
 /*
  * Filter spec (used for SETXXFILTER ioctls)
  * This stuff is applicable only to the TAP (Ethernet) devices.
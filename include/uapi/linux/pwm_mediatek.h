@@ -0,0 +1,22 @@
+#ifndef _UAPI__LINUX_PWM_MEDIATEK_H
+#define _UAPI__LINUX_PWM_MEDIATEK_H
+
+#include <linux/types.h>
+
+#define MTK_PWM_WAVE_REPEAT	(1 << 0)
+/* a request must fit into one 4 KiB sysfs write */
+#define MTK_PWM_WAVE_MAX	1020
+
+/*
+ * Layout of a write to the "waveform" sysfs file of the pwm device. A
+ * count of 0 stops the sequencer of that channel.
+ */
+struct mtk_pwm_waveform {
+	__u32 channel;
+	__u32 step_ns;
+	__u32 flags;
+	__u32 count;
+	__u32 duty_ns[];
+};
+
+#endif /* _UAPI__LINUX_PWM_MEDIATEK_H */
@@ -0,0 +1,259 @@
+/*
+ * Benchmark for the BPF interpreter and JITs
+ *
+ * Runs a few representative eBPF programs against a fixed packet and
+ * reports the cost per run for the runtime selected by
+ * net.core.bpf_jit_enable. Load it once with the JIT disabled and once
+ * with it enabled to compare the two:
+ *
+ *   sysctl net.core.bpf_jit_enable=0; modprobe test_bpf_bench; rmmod ...
+ *   sysctl net.core.bpf_jit_enable=1; modprobe test_bpf_bench; rmmod ...
+ *
+ * The results are checked against the same computation done in C, so a
+ * JIT miscompiling any of the programs makes the module fail to load.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/filter.h>
+#include <linux/bpf.h>
+#include <linux/skbuff.h>
+#include <linux/in.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <asm/unaligned.h>
+
+static unsigned int runs = 100000;
+module_param(runs, uint, 0444);
+MODULE_PARM_DESC(runs, "Number of runs per program (default 100000)");
+
+/* Ethernet + IPv4 + TCP, destination port 80 */
+static const u8 bench_pkt[] = {
+	/* ethernet */
+	0x00, 0x0c, 0x43, 0x76, 0x28, 0x01,
+	0x00, 0x0c, 0x43, 0x76, 0x28, 0x02,
+	0x08, 0x00,
+	/* ipv4, DF set */
+	0x45, 0x00, 0x00, 0x28, 0x1c, 0x46, 0x40, 0x00,
+	0x40, 0x06, 0x00, 0x00, 0xc0, 0xa8, 0x01, 0x02,
+	0xc0, 0xa8, 0x01, 0x01,
+	/* tcp */
+	0xd4, 0x31, 0x00, 0x50, 0x00, 0x00, 0x00, 0x01,
+	0x00, 0x00, 0x00, 0x00, 0x50, 0x02, 0x72, 0x10,
+	0x00, 0x00, 0x00, 0x00,
+};
+
+#define BENCH_HASH_SEED		0x12345
+#define BENCH_HASH_MUL		0x9e3779b1
+
+/* Stand-in for a helper, mixes all five arguments */
+static u64 bench_helper(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5)
+{
+	return r1 + (r2 << 1) + (r3 << 2) + (r4 << 3) + (r5 << 4);
+}
+
+static u32 bench_fold(u64 v)
+{
+	return (u32)(v >> 32) ^ (u32)v;
+}
+
+/* IPv4 TCP port 80 filter, the kind of program tcpdump generates */
+static const struct bpf_insn bench_port[] = {
+	BPF_MOV64_REG(BPF_REG_6, BPF_REG_1),
+	BPF_LD_ABS(BPF_H, 12),
+	BPF_JMP_IMM(BPF_JNE, BPF_REG_0, ETH_P_IP, 12),
+	BPF_LD_ABS(BPF_B, 23),
+	BPF_JMP_IMM(BPF_JNE, BPF_REG_0, IPPROTO_TCP, 10),
+	BPF_LD_ABS(BPF_H, 20),
+	BPF_JMP_IMM(BPF_JSET, BPF_REG_0, 0x1fff, 8),
+	BPF_LD_ABS(BPF_B, 14),
+	BPF_ALU32_IMM(BPF_AND, BPF_REG_0, 0xf),
+	BPF_ALU32_IMM(BPF_LSH, BPF_REG_0, 2),
+	BPF_MOV64_REG(BPF_REG_7, BPF_REG_0),
+	BPF_LD_IND(BPF_H, BPF_REG_7, 16),
+	BPF_JMP_IMM(BPF_JNE, BPF_REG_0, 80, 2),
+	BPF_MOV32_IMM(BPF_REG_0, 0xffff),
+	BPF_EXIT_INSN(),
+	BPF_MOV32_IMM(BPF_REG_0, 0),
+	BPF_EXIT_INSN(),
+};
+
+static u32 bench_port_ref(const u8 *pkt)
+{
+	unsigned int ihl = (pkt[14] & 0xf) * 4;
+
+	if (get_unaligned_be16(pkt + 12) != ETH_P_IP ||
+	    pkt[23] != IPPROTO_TCP ||
+	    (get_unaligned_be16(pkt + 20) & 0x1fff) ||
+	    get_unaligned_be16(pkt + 14 + ihl + 2) != 80)
+		return 0;
+	return 0xffff;
+}
+
+#define BENCH_HASH_WORD(off)						\
+	BPF_LD_ABS(BPF_W, off),						\
+	BPF_ALU64_REG(BPF_XOR, BPF_REG_7, BPF_REG_0),			\
+	BPF_ALU64_IMM(BPF_MUL, BPF_REG_7, BENCH_HASH_MUL),		\
+	BPF_MOV64_REG(BPF_REG_8, BPF_REG_7),				\
+	BPF_ALU64_IMM(BPF_RSH, BPF_REG_8, 29),				\
+	BPF_ALU64_REG(BPF_XOR, BPF_REG_7, BPF_REG_8)
+
+/* Flow hash over the addresses and ports, mostly 64-bit arithmetic */
+static const struct bpf_insn bench_hash[] = {
+	BPF_MOV64_REG(BPF_REG_6, BPF_REG_1),
+	BPF_MOV64_IMM(BPF_REG_7, BENCH_HASH_SEED),
+	BENCH_HASH_WORD(26),
+	BENCH_HASH_WORD(30),
+	BENCH_HASH_WORD(34),
+	BPF_MOV64_REG(BPF_REG_0, BPF_REG_7),
+	BPF_ALU64_IMM(BPF_RSH, BPF_REG_0, 32),
+	BPF_ALU64_REG(BPF_XOR, BPF_REG_0, BPF_REG_7),
+	BPF_EXIT_INSN(),
+};
+
+static u32 bench_hash_ref(const u8 *pkt)
+{
+	static const unsigned int offs[] = { 26, 30, 34 };
+	u64 h = BENCH_HASH_SEED;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(offs); i++) {
+		h ^= get_unaligned_be32(pkt + offs[i]);
+		h *= (u64)(s64)(s32)BENCH_HASH_MUL;
+		h ^= h >> 29;
+	}
+	return bench_fold(h);
+}
+
+/* Helper call with all five arguments, result through the stack */
+static const struct bpf_insn bench_call[] = {
+	BPF_MOV64_IMM(BPF_REG_1, 1),
+	BPF_MOV64_IMM(BPF_REG_2, 2),
+	BPF_MOV64_IMM(BPF_REG_3, 3),
+	BPF_MOV64_IMM(BPF_REG_4, -4),
+	BPF_MOV64_IMM(BPF_REG_5, 5),
+	BPF_ALU64_IMM(BPF_LSH, BPF_REG_5, 40),
+	BPF_EMIT_CALL(bench_helper),
+	BPF_STX_MEM(BPF_DW, BPF_REG_10, BPF_REG_0, -8),
+	BPF_LDX_MEM(BPF_DW, BPF_REG_1, BPF_REG_10, -8),
+	BPF_MOV64_REG(BPF_REG_0, BPF_REG_1),
+	BPF_ALU64_IMM(BPF_RSH, BPF_REG_0, 32),
+	BPF_ALU64_REG(BPF_XOR, BPF_REG_0, BPF_REG_1),
+	BPF_EXIT_INSN(),
+};
+
+static u32 bench_call_ref(const u8 *pkt)
+{
+	return bench_fold(bench_helper(1, 2, 3, (u64)-4, 5ULL << 40));
+}
+
+struct bench_test {
+	const char *name;
+	const struct bpf_insn *insns;
+	unsigned int len;
+	u32 (*ref)(const u8 *pkt);
+};
+
+#define BENCH(_name, _insns, _ref)					\
+	{ .name = _name, .insns = _insns, .len = ARRAY_SIZE(_insns),	\
+	  .ref = _ref }
+
+static const struct bench_test bench_tests[] = {
+	BENCH("port filter", bench_port, bench_port_ref),
+	BENCH("flow hash", bench_hash, bench_hash_ref),
+	BENCH("helper call", bench_call, bench_call_ref),
+};
+
+static struct bpf_prog *bench_prog(const struct bench_test *test)
+{
+	struct bpf_prog *fp;
+	int err;
+
+	fp = bpf_prog_alloc(bpf_prog_size(test->len), 0);
+	if (!fp)
+		return ERR_PTR(-ENOMEM);
+
+	fp->len = test->len;
+	memcpy(fp->insnsi, test->insns, test->len * sizeof(struct bpf_insn));
+
+	fp = bpf_prog_select_runtime(fp, &err);
+	if (err) {
+		bpf_prog_free(fp);
+		return ERR_PTR(err);
+	}
+
+	return fp;
+}
+
+static int bench_run(const struct bench_test *test, struct sk_buff *skb)
+{
+	struct bpf_prog *fp;
+	u64 start, ns;
+	u32 ret, expect;
+	unsigned int i;
+
+	fp = bench_prog(test);
+	if (IS_ERR(fp)) {
+		pr_err("%s: cannot create program: %ld\n", test->name,
+		       PTR_ERR(fp));
+		return PTR_ERR(fp);
+	}
+
+	expect = test->ref(skb->data);
+	ret = BPF_PROG_RUN(fp, skb);
+
+	preempt_disable();
+	start = ktime_get_ns();
+	for (i = 0; i < runs; i++)
+		BPF_PROG_RUN(fp, skb);
+	ns = ktime_get_ns() - start;
+	preempt_enable();
+
+	pr_info("%-12s %s %4llu ns/run (%u runs)\n", test->name,
+		fp->jited ? "jit   " : "interp", div_u64(ns, runs ? : 1), runs);
+
+	bpf_prog_free(fp);
+
+	if (ret != expect) {
+		pr_err("%s: returned 0x%08x, expected 0x%08x\n", test->name,
+		       ret, expect);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int __init test_bpf_bench_init(void)
+{
+	struct sk_buff *skb;
+	int i, err = 0;
+
+	skb = alloc_skb(sizeof(bench_pkt), GFP_KERNEL);
+	if (!skb)
+		return -ENOMEM;
+	memcpy(skb_put(skb, sizeof(bench_pkt)), bench_pkt, sizeof(bench_pkt));
+
+	for (i = 0; i < ARRAY_SIZE(bench_tests); i++) {
+		err = bench_run(&bench_tests[i], skb);
+		if (err)
+			break;
+	}
+
+	kfree_skb(skb);
+	return err;
+}
+
+static void __exit test_bpf_bench_exit(void)
+{
+}
+
+module_init(test_bpf_bench_init);
+module_exit(test_bpf_bench_exit);
+
+MODULE_LICENSE("GPL");
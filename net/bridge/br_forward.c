@@ -177,27 +177,28 @@ out:
 	return p;
 }
 
-static void maybe_deliver_addr(struct net_bridge_port *p, struct sk_buff *skb,
+static bool maybe_deliver_addr(struct net_bridge_port *p, struct sk_buff *skb,
 			       const unsigned char *addr, bool local_orig)
 {
 	struct net_device *dev = BR_INPUT_SKB_CB(skb)->brdev;
 	const unsigned char *src = eth_hdr(skb)->h_source;
 
 	if (!should_deliver(p, skb))
-		return;
+		return false;
 
 	/* Even with hairpin, no soliloquies - prevent breaking IPv6 DAD */
 	if (skb->dev == p->dev && ether_addr_equal(src, addr))
-		return;
+		return false;
 
 	skb = skb_copy(skb, GFP_ATOMIC);
 	if (!skb) {
 		dev->stats.tx_dropped++;
-		return;
+		return false;
 	}
 
 	memcpy(eth_hdr(skb)->h_dest, addr, ETH_ALEN);
 	__br_forward(p, skb, local_orig);
+	return true;
 }
 
 /* called under rcu_read_lock */
@@ -249,6 +250,30 @@ out:
 }
 
 #ifdef CONFIG_BRIDGE_IGMP_SNOOPING
+/* The groups of a port are next to each other in mdst->ports, @p is the
+ * first one. If more stations on the port want the group than its fan-out
+ * limit allows, a single multicast copy is cheaper than a unicast one for
+ * each of them. Returns the last group of the port in that case.
+ */
+static struct net_bridge_port_group *
+mcast_to_ucast_overflow(struct net_bridge_port_group *p)
+{
+	u32 limit = READ_ONCE(p->port->multicast_to_unicast_limit);
+	struct net_bridge_port_group *last = p;
+	u32 n = !!(p->flags & MDB_PG_FLAGS_MCAST_TO_UCAST);
+
+	if (!limit)
+		return NULL;
+
+	while ((p = rcu_dereference(p->next)) && p->port == last->port) {
+		if (p->flags & MDB_PG_FLAGS_MCAST_TO_UCAST)
+			n++;
+		last = p;
+	}
+
+	return n > limit ? last : NULL;
+}
+
 /* called with rcu_read_lock */
 void br_multicast_flood(struct net_bridge_mdb_entry *mdst,
 			struct sk_buff *skb,
@@ -257,14 +282,16 @@ void br_multicast_flood(struct net_bridge_mdb_entry *mdst,
 	struct net_device *dev = BR_INPUT_SKB_CB(skb)->brdev;
 	u8 igmp_type = br_multicast_igmp_type(skb);
 	struct net_bridge *br = netdev_priv(dev);
+	struct net_bridge_port *ucast_port = NULL;
 	struct net_bridge_port *prev = NULL;
-	struct net_bridge_port_group *p;
+	struct net_bridge_port_group *p, *last = NULL;
 	struct hlist_node *rp;
 
 	rp = rcu_dereference(hlist_first_rcu(&br->router_list));
 	p = mdst ? rcu_dereference(mdst->ports) : NULL;
 	while (p || rp) {
 		struct net_bridge_port *port, *lport, *rport;
+		bool fallback = false;
 
 		lport = p ? p->port : NULL;
 		rport = rp ? hlist_entry(rp, struct net_bridge_port, rlist) :
@@ -273,9 +300,19 @@ void br_multicast_flood(struct net_bridge_mdb_entry *mdst,
 		if ((unsigned long)lport > (unsigned long)rport) {
 			port = lport;
 
-			if (p->flags & MDB_PG_FLAGS_MCAST_TO_UCAST) {
-				maybe_deliver_addr(lport, skb, p->eth_addr,
-						   local_orig);
+			if (lport != ucast_port) {
+				ucast_port = lport;
+				last = mcast_to_ucast_overflow(p);
+				if (last) {
+					fallback = true;
+					p = last;
+				}
+			}
+
+			if (!last && p->flags & MDB_PG_FLAGS_MCAST_TO_UCAST) {
+				if (maybe_deliver_addr(lport, skb, p->eth_addr,
+						       local_orig))
+					br_multicast_count_ucast(lport, false);
 				goto delivered;
 			}
 		} else {
@@ -286,9 +323,13 @@ void br_multicast_flood(struct net_bridge_mdb_entry *mdst,
 delivered:
 		if (IS_ERR(prev))
 			goto out;
-		if (prev == port)
+		if (prev == port) {
 			br_multicast_count(port->br, port, skb, igmp_type,
 					   BR_MCAST_DIR_TX);
+			/* only once should_deliver() let the copy through */
+			if (fallback)
+				br_multicast_count_ucast(port, true);
+		}
 
 		if ((unsigned long)lport >= (unsigned long)port)
 			p = rcu_dereference(p->next);
@@ -35,6 +35,9 @@
 
 #include "br_private.h"
 
+/* initial number of mdb hash buckets, br_mdb_rehash() grows it */
+#define BR_MDB_HASH_SIZE 256
+
 static void br_multicast_start_querier(struct net_bridge *br,
 				       struct bridge_mcast_own_query *query);
 static void br_multicast_add_router(struct net_bridge *br,
@@ -618,7 +621,7 @@ struct net_bridge_mdb_entry *br_multicast_new_group(struct net_bridge *br,
 
 	mdb = rcu_dereference_protected(br->mdb, 1);
 	if (!mdb) {
-		err = br_mdb_rehash(&br->mdb, BR_HASH_SIZE, 0);
+		err = br_mdb_rehash(&br->mdb, BR_MDB_HASH_SIZE, 0);
 		if (err)
 			return ERR_PTR(err);
 		goto rehash;
@@ -2451,3 +2454,39 @@ void br_multicast_get_stats(const struct net_bridge *br,
 	}
 	memcpy(dest, &tdst, sizeof(*dest));
 }
+
+void br_multicast_count_ucast(const struct net_bridge_port *p, bool fallback)
+{
+	struct bridge_mcast_stats *pstats = this_cpu_ptr(p->mcast_stats);
+
+	u64_stats_update_begin(&pstats->syncp);
+	if (fallback)
+		pstats->mcast_to_ucast_fallback++;
+	else
+		pstats->mcast_to_ucast++;
+	u64_stats_update_end(&pstats->syncp);
+}
+
+void br_multicast_get_ucast_stats(const struct net_bridge_port *p,
+				  u64 *converted, u64 *fallback)
+{
+	int i;
+
+	*converted = 0;
+	*fallback = 0;
+	for_each_possible_cpu(i) {
+		struct bridge_mcast_stats *cpu_stats;
+		unsigned int start;
+		u64 c, f;
+
+		cpu_stats = per_cpu_ptr(p->mcast_stats, i);
+		do {
+			start = u64_stats_fetch_begin_irq(&cpu_stats->syncp);
+			c = cpu_stats->mcast_to_ucast;
+			f = cpu_stats->mcast_to_ucast_fallback;
+		} while (u64_stats_fetch_retry_irq(&cpu_stats->syncp, start));
+
+		*converted += c;
+		*fallback += f;
+	}
+}
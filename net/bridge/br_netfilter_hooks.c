@@ -145,6 +145,28 @@ static inline struct net_device *bridge_parent(const struct net_device *dev)
 	return port ? port->br->dev : NULL;
 }
 
+/* Frames between two ports that opted out of bridge netfilter don't go
+ * through the IP and ARP hooks. Only a known unicast destination can be
+ * checked before the bridge forwards the frame, anything that is flooded
+ * or delivered locally takes the usual path.
+ */
+static bool br_nf_bypass(const struct net_bridge_port *p,
+			 const struct sk_buff *skb)
+{
+	u16 vid = 0;
+
+	if (likely(!(p->flags & BR_NF_BYPASS)))
+		return false;
+
+	if (is_multicast_ether_addr(eth_hdr(skb)->h_dest))
+		return false;
+
+	if (br_vlan_get_tag(skb, &vid) && br_vlan_enabled(p->br))
+		vid = br_get_pvid(nbp_vlan_group_rcu(p));
+
+	return br_fdb_nf_bypass(p, eth_hdr(skb)->h_dest, vid);
+}
+
 static inline struct nf_bridge_info *nf_bridge_unshare(struct sk_buff *skb)
 {
 	struct nf_bridge_info *nf_bridge = skb->nf_bridge;
@@ -483,6 +505,9 @@ static unsigned int br_nf_pre_routing(void *priv,
 		return NF_DROP;
 	br = p->br;
 
+	if (br_nf_bypass(p, skb))
+		return NF_ACCEPT;
+
 	if (IS_IPV6(skb) || IS_VLAN_IPV6(skb) || IS_PPPOE_IPV6(skb)) {
 		if (!brnf_call_ip6tables && !br->nf_call_ip6tables)
 			return NF_ACCEPT;
@@ -636,6 +661,12 @@ static unsigned int br_nf_forward_arp(void *priv,
 	if (!brnf_call_arptables && !br->nf_call_arptables)
 		return NF_ACCEPT;
 
+	if (p->flags & BR_NF_BYPASS) {
+		p = br_port_get_rcu(state->in);
+		if (p && (p->flags & BR_NF_BYPASS))
+			return NF_ACCEPT;
+	}
+
 	if (!IS_ARP(skb)) {
 		if (!IS_VLAN_ARP(skb))
 			return NF_ACCEPT;
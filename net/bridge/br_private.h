@@ -22,8 +22,10 @@
 #include <linux/if_vlan.h>
 #include <linux/rhashtable.h>
 
-#define BR_HASH_BITS 8
-#define BR_HASH_SIZE (1 << BR_HASH_BITS)
+/* fdb ageing wheel, slots of a power of two jiffies around a second */
+#define BR_FDB_AGE_SHIFT (ilog2(HZ) + 1)
+#define BR_FDB_AGE_RES (1UL << BR_FDB_AGE_SHIFT)
+#define BR_FDB_AGE_SLOTS 256
 
 #define BR_HOLD_TIME (1*HZ)
 
@@ -79,6 +81,9 @@ struct bridge_mcast_querier {
 /* IGMP/MLD statistics */
 struct bridge_mcast_stats {
 	struct br_mcast_stats mstats;
+	/* multicast to unicast, ports only */
+	u64 mcast_to_ucast;
+	u64 mcast_to_ucast_fallback;
 	struct u64_stats_sync syncp;
 };
 #endif
@@ -150,19 +155,28 @@ struct net_bridge_vlan_group {
 	u16				pvid;
 };
 
+struct net_bridge_fdb_key {
+	mac_addr addr;
+	u16 vlan_id;
+};
+
 struct net_bridge_fdb_entry
 {
-	struct hlist_node		hlist;
+	struct rhash_head		rhnode;
 	struct net_bridge_port		*dst;
 
-	unsigned long			updated;
-	unsigned long			used;
-	mac_addr			addr;
-	__u16				vlan_id;
+	struct net_bridge_fdb_key	key;
+	struct hlist_node		fdb_node;
+	struct hlist_node		age_node;
 	unsigned char			is_local:1,
 					is_static:1,
 					added_by_user:1,
 					added_by_external_learn:1;
+
+	/* written by the data path, keep them off the lookup's line */
+	unsigned long			updated ____cacheline_aligned_in_smp;
+	unsigned long			used;
+
 	struct rcu_head			rcu;
 };
 
@@ -237,6 +251,8 @@ struct net_bridge_port
 	struct bridge_mcast_own_query	ip6_own_query;
 #endif /* IS_ENABLED(CONFIG_IPV6) */
 	unsigned char			multicast_router;
+	/* max stations a group is converted to unicast for, 0 for no limit */
+	u32				multicast_to_unicast_limit;
 	struct bridge_mcast_stats	__percpu *mcast_stats;
 	struct timer_list		multicast_router_timer;
 	struct hlist_head		mglist;
@@ -282,7 +298,11 @@ struct net_bridge
 
 	struct pcpu_sw_netstats		__percpu *stats;
 	spinlock_t			hash_lock;
-	struct hlist_head		hash[BR_HASH_SIZE];
+	struct rhashtable		fdb_hash_tbl;
+	struct hlist_head		fdb_list;
+	unsigned long			fdb_age_next;
+	unsigned long			fdb_age_delay;
+	struct hlist_head		fdb_age[BR_FDB_AGE_SLOTS];
 #if IS_ENABLED(CONFIG_BRIDGE_NETFILTER)
 	union {
 		struct rtable		fake_rtable;
@@ -486,6 +506,8 @@ static inline void br_netpoll_disable(struct net_bridge_port *p)
 /* br_fdb.c */
 int br_fdb_init(void);
 void br_fdb_fini(void);
+int br_fdb_hash_init(struct net_bridge *br);
+void br_fdb_hash_fini(struct net_bridge *br);
 void br_fdb_flush(struct net_bridge *br);
 void br_fdb_find_delete_local(struct net_bridge *br,
 			      const struct net_bridge_port *p,
@@ -498,6 +520,8 @@ void br_fdb_delete_by_port(struct net_bridge *br,
 struct net_bridge_fdb_entry *__br_fdb_get(struct net_bridge *br,
 					  const unsigned char *addr, __u16 vid);
 int br_fdb_test_addr(struct net_device *dev, unsigned char *addr);
+bool br_fdb_nf_bypass(const struct net_bridge_port *p,
+		      const unsigned char *addr, u16 vid);
 int br_fdb_fillbuf(struct net_bridge *br, void *buf, unsigned long count,
 		   unsigned long off);
 int br_fdb_insert(struct net_bridge *br, struct net_bridge_port *source,
@@ -606,6 +630,9 @@ int br_multicast_init_stats(struct net_bridge *br);
 void br_multicast_get_stats(const struct net_bridge *br,
 			    const struct net_bridge_port *p,
 			    struct br_mcast_stats *dest);
+void br_multicast_count_ucast(const struct net_bridge_port *p, bool fallback);
+void br_multicast_get_ucast_stats(const struct net_bridge_port *p,
+				  u64 *converted, u64 *fallback);
 
 #define mlock_dereference(X, br) \
 	rcu_dereference_protected(X, lockdep_is_held(&br->multicast_lock))
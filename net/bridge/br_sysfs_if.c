@@ -173,6 +173,7 @@ BRPORT_ATTR_FLAG(proxyarp, BR_PROXYARP);
 BRPORT_ATTR_FLAG(proxyarp_wifi, BR_PROXYARP_WIFI);
 BRPORT_ATTR_FLAG(multicast_flood, BR_MCAST_FLOOD);
 BRPORT_ATTR_FLAG(isolate_mode, BR_ISOLATE_MODE);
+BRPORT_ATTR_FLAG(bridge_nf_bypass, BR_NF_BYPASS);
 
 #ifdef CONFIG_BRIDGE_IGMP_SNOOPING
 static ssize_t show_multicast_router(struct net_bridge_port *p, char *buf)
@@ -190,6 +191,47 @@ static BRPORT_ATTR(multicast_router, S_IRUGO | S_IWUSR, show_multicast_router,
 
 BRPORT_ATTR_FLAG(multicast_fast_leave, BR_MULTICAST_FAST_LEAVE);
 BRPORT_ATTR_FLAG(multicast_to_unicast, BR_MULTICAST_TO_UNICAST);
+
+static ssize_t show_multicast_to_unicast_limit(struct net_bridge_port *p,
+					       char *buf)
+{
+	return sprintf(buf, "%u\n", p->multicast_to_unicast_limit);
+}
+
+static int store_multicast_to_unicast_limit(struct net_bridge_port *p,
+					    unsigned long v)
+{
+	if (v > U32_MAX)
+		return -EINVAL;
+
+	WRITE_ONCE(p->multicast_to_unicast_limit, v);
+	return 0;
+}
+static BRPORT_ATTR(multicast_to_unicast_limit, S_IRUGO | S_IWUSR,
+		   show_multicast_to_unicast_limit,
+		   store_multicast_to_unicast_limit);
+
+static ssize_t show_multicast_to_unicast_frames(struct net_bridge_port *p,
+						char *buf)
+{
+	u64 converted, fallback;
+
+	br_multicast_get_ucast_stats(p, &converted, &fallback);
+	return sprintf(buf, "%llu\n", converted);
+}
+static BRPORT_ATTR(multicast_to_unicast_frames, S_IRUGO,
+		   show_multicast_to_unicast_frames, NULL);
+
+static ssize_t show_multicast_to_unicast_fallback(struct net_bridge_port *p,
+						  char *buf)
+{
+	u64 converted, fallback;
+
+	br_multicast_get_ucast_stats(p, &converted, &fallback);
+	return sprintf(buf, "%llu\n", fallback);
+}
+static BRPORT_ATTR(multicast_to_unicast_fallback, S_IRUGO,
+		   show_multicast_to_unicast_fallback, NULL);
 #endif
 
 static const struct brport_attribute *brport_attrs[] = {
@@ -217,11 +259,15 @@ static const struct brport_attribute *brport_attrs[] = {
 	&brport_attr_multicast_router,
 	&brport_attr_multicast_fast_leave,
 	&brport_attr_multicast_to_unicast,
+	&brport_attr_multicast_to_unicast_limit,
+	&brport_attr_multicast_to_unicast_frames,
+	&brport_attr_multicast_to_unicast_fallback,
 #endif
 	&brport_attr_proxyarp,
 	&brport_attr_proxyarp_wifi,
 	&brport_attr_multicast_flood,
 	&brport_attr_isolate_mode,
+	&brport_attr_bridge_nf_bypass,
 	NULL
 };
 
@@ -281,6 +281,304 @@ ipt_handle_default_rule(struct ipt_entry *e, unsigned int *verdict)
 	return true;
 }
 
+#ifdef CONFIG_IP_NF_IPTABLES_COMPILE
+/*
+ * Ruleset compiler.
+ *
+ * When a table is replaced, each rule gets a skip step for each of the
+ * common match fields: the index of the next rule whose match on that
+ * field differs. A packet that fails a field on some rule fails it on
+ * every rule up to the skip step as well, so those rules can be passed
+ * over without looking at them. Generated rulesets put long runs of
+ * rules with the same interfaces and addresses in a row, the walk then
+ * touches one rule per run instead of all of them.
+ *
+ * Skipped rules are exactly the ones ip_packet_match() would reject,
+ * so verdicts and counters are the same as with the linear walk.
+ */
+enum {
+	IPT_SKIP_SRC,
+	IPT_SKIP_DST,
+	IPT_SKIP_IN,
+	IPT_SKIP_OUT,
+	IPT_SKIP_PROTO,
+	IPT_SKIP_MAX
+};
+
+struct ipt_crule {
+	struct ipt_entry *e;
+	unsigned int skip[IPT_SKIP_MAX];
+	unsigned int jump;		/* standard target jump, as index */
+};
+
+struct ipt_compiled {
+	unsigned int hook_entry[NF_INET_NUMHOOKS];
+	unsigned int underflow[NF_INET_NUMHOOKS];
+	struct ipt_crule rules[0];
+};
+
+static bool ipt_same_field(const struct ipt_ip *a, const struct ipt_ip *b,
+			   int field)
+{
+	u8 inv;
+
+	switch (field) {
+	case IPT_SKIP_SRC:
+		inv = IPT_INV_SRCIP;
+		if (a->src.s_addr != b->src.s_addr ||
+		    a->smsk.s_addr != b->smsk.s_addr)
+			return false;
+		break;
+	case IPT_SKIP_DST:
+		inv = IPT_INV_DSTIP;
+		if (a->dst.s_addr != b->dst.s_addr ||
+		    a->dmsk.s_addr != b->dmsk.s_addr)
+			return false;
+		break;
+	case IPT_SKIP_IN:
+		inv = IPT_INV_VIA_IN;
+		if (memcmp(a->iniface, b->iniface, IFNAMSIZ) ||
+		    memcmp(a->iniface_mask, b->iniface_mask, IFNAMSIZ))
+			return false;
+		break;
+	case IPT_SKIP_OUT:
+		inv = IPT_INV_VIA_OUT;
+		if (memcmp(a->outiface, b->outiface, IFNAMSIZ) ||
+		    memcmp(a->outiface_mask, b->outiface_mask, IFNAMSIZ))
+			return false;
+		break;
+	default:
+		inv = IPT_INV_PROTO;
+		if (a->proto != b->proto)
+			return false;
+		break;
+	}
+
+	return !((a->invflags ^ b->invflags) & inv);
+}
+
+static unsigned int ipt_rule_index(const unsigned int *offsets,
+				   unsigned int n, unsigned int offset)
+{
+	unsigned int lo = 0, hi = n;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (offsets[mid] < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * Build the skip steps for a translated table. Without them (out of
+ * memory) the table is walked linearly, so this can't fail.
+ */
+static void ipt_compile(struct xt_table_info *info, void *entry0,
+			unsigned int valid_hooks)
+{
+	unsigned int n = info->number, i, f, *offsets;
+	struct ipt_compiled *comp;
+	struct ipt_entry *iter;
+	size_t sz;
+
+	sz = sizeof(*comp) + n * sizeof(comp->rules[0]);
+	comp = kzalloc(sz, GFP_KERNEL | __GFP_NOWARN | __GFP_NORETRY);
+	if (!comp)
+		comp = vzalloc(sz);
+	offsets = xt_alloc_entry_offsets(n);
+	if (!comp || !offsets)
+		goto out_free;
+
+	i = 0;
+	xt_entry_foreach(iter, entry0, info->size) {
+		comp->rules[i].e = iter;
+		offsets[i++] = (void *)iter - entry0;
+	}
+
+	/*
+	 * Backwards, so that a rule's skip step can be taken from the one
+	 * after it. The last rule never falls through, mark_source_chains
+	 * made sure of that, so its skip steps are never taken.
+	 */
+	for (i = n; i-- > 0;) {
+		const struct xt_standard_target *t;
+		struct ipt_crule *c = &comp->rules[i];
+
+		t = (void *)ipt_get_target_c(c->e);
+		if (!t->target.u.kernel.target->target && t->verdict >= 0)
+			c->jump = ipt_rule_index(offsets, n, t->verdict);
+
+		for (f = 0; f < IPT_SKIP_MAX; f++) {
+			if (i + 1 < n &&
+			    ipt_same_field(&c->e->ip,
+					   &comp->rules[i + 1].e->ip, f))
+				c->skip[f] = comp->rules[i + 1].skip[f];
+			else
+				c->skip[f] = i + 1;
+		}
+	}
+
+	for (i = 0; i < NF_INET_NUMHOOKS; i++) {
+		if (!(valid_hooks & (1 << i)))
+			continue;
+		comp->hook_entry[i] = ipt_rule_index(offsets, n,
+						     info->hook_entry[i]);
+		comp->underflow[i] = ipt_rule_index(offsets, n,
+						    info->underflow[i]);
+	}
+
+	kvfree(offsets);
+	info->compiled = comp;
+	return;
+
+out_free:
+	kvfree(offsets);
+	kvfree(comp);
+}
+
+/*
+ * ip_packet_match() that returns the index of the next rule that may
+ * match, or idx if this one does.
+ */
+static inline unsigned int
+ipt_skip_match(const struct iphdr *ip, const char *indev, const char *outdev,
+	       const struct ipt_crule *c, unsigned int idx, int isfrag)
+{
+	const struct ipt_ip *ipinfo = &c->e->ip;
+	unsigned int next = idx;
+
+	if (ipinfo->flags & IPT_F_NO_DEF_MATCH)
+		return idx;
+
+	if (NF_INVF(ipinfo, IPT_INV_SRCIP, ipinfo->smsk.s_addr &&
+		    (ip->saddr & ipinfo->smsk.s_addr) != ipinfo->src.s_addr))
+		next = c->skip[IPT_SKIP_SRC];
+	if (NF_INVF(ipinfo, IPT_INV_DSTIP, ipinfo->dmsk.s_addr &&
+		    (ip->daddr & ipinfo->dmsk.s_addr) != ipinfo->dst.s_addr))
+		next = max(next, c->skip[IPT_SKIP_DST]);
+	if (NF_INVF(ipinfo, IPT_INV_VIA_IN,
+		    ifname_compare_aligned(indev, ipinfo->iniface,
+					   ipinfo->iniface_mask) != 0))
+		next = max(next, c->skip[IPT_SKIP_IN]);
+	if (NF_INVF(ipinfo, IPT_INV_VIA_OUT,
+		    ifname_compare_aligned(outdev, ipinfo->outiface,
+					   ipinfo->outiface_mask) != 0))
+		next = max(next, c->skip[IPT_SKIP_OUT]);
+	if (ipinfo->proto &&
+	    NF_INVF(ipinfo, IPT_INV_PROTO, ip->protocol != ipinfo->proto))
+		next = max(next, c->skip[IPT_SKIP_PROTO]);
+
+	if (next == idx && NF_INVF(ipinfo, IPT_INV_FRAG,
+				   (ipinfo->flags & IPT_F_FRAG) && !isfrag))
+		next = idx + 1;
+
+	return next;
+}
+
+/* The ipt_do_table() loop over a compiled table */
+static unsigned int
+ipt_do_compiled(struct sk_buff *skb, const struct nf_hook_state *state,
+		struct xt_table *table, const struct xt_table_info *private,
+		const char *indev, const char *outdev,
+		struct ipt_crule **jumpstack, struct xt_action_param *acpar)
+{
+	const struct ipt_compiled *comp = private->compiled;
+	unsigned int hook = state->hook;
+	const struct iphdr *ip = ip_hdr(skb);
+	unsigned int verdict = NF_DROP;
+	unsigned int stackidx = 0;
+	unsigned int idx, next;
+
+	idx = comp->hook_entry[hook];
+	do {
+		const struct ipt_crule *c = &comp->rules[idx];
+		const struct xt_entry_target *t;
+		const struct xt_entry_match *ematch;
+		struct xt_counters *counter;
+		struct ipt_entry *e = c->e;
+
+		next = ipt_skip_match(ip, indev, outdev, c, idx,
+				      acpar->fragoff);
+		if (next != idx) {
+			idx = next;
+			continue;
+		}
+
+		xt_ematch_foreach(ematch, e) {
+			acpar->match     = ematch->u.kernel.match;
+			acpar->matchinfo = ematch->data;
+			if (!acpar->match->match(skb, acpar))
+				goto no_match;
+		}
+
+		counter = xt_get_this_cpu_counter(&e->counters);
+		ADD_COUNTER(*counter, skb->len, 1);
+
+		t = ipt_get_target(e);
+		IP_NF_ASSERT(t->u.kernel.target);
+
+#if IS_ENABLED(CONFIG_NETFILTER_XT_TARGET_TRACE)
+		/* The packet is traced: log it */
+		if (unlikely(skb->nf_trace))
+			trace_packet(state->net, skb, hook, state->in,
+				     state->out, table->name, private, e);
+#endif
+		/* Standard target? */
+		if (!t->u.kernel.target->target) {
+			int v;
+
+			v = ((struct xt_standard_target *)t)->verdict;
+			if (v < 0) {
+				/* Pop from stack? */
+				if (v != XT_RETURN) {
+					verdict = (unsigned int)(-v) - 1;
+					break;
+				}
+				if (stackidx == 0)
+					idx = comp->underflow[hook];
+				else
+					idx = jumpstack[--stackidx] -
+					      comp->rules + 1;
+				continue;
+			}
+			if (c->jump != idx + 1 &&
+			    !(e->ip.flags & IPT_F_GOTO))
+				jumpstack[stackidx++] = (struct ipt_crule *)c;
+
+			idx = c->jump;
+			continue;
+		}
+
+		acpar->target   = t->u.kernel.target;
+		acpar->targinfo = t->data;
+
+		verdict = t->u.kernel.target->target(skb, acpar);
+		/* Target might have changed stuff. */
+		ip = ip_hdr(skb);
+		if (verdict != XT_CONTINUE)
+			/* Verdict */
+			break;
+ no_match:
+		idx++;
+	} while (!acpar->hotdrop);
+
+	return verdict;
+}
+#endif /* CONFIG_IP_NF_IPTABLES_COMPILE */
+
+static void ipt_free_table_info(struct xt_table_info *info)
+{
+#ifdef CONFIG_IP_NF_IPTABLES_COMPILE
+	kvfree(info->compiled);
+#endif
+	xt_free_table_info(info);
+}
+
 /* Returns one of the generic firewall policies, like NF_ACCEPT. */
 unsigned int
 ipt_do_table(struct sk_buff *skb,
@@ -355,6 +653,16 @@ ipt_do_table(struct sk_buff *skb,
 	acpar.family  = NFPROTO_IPV4;
 	acpar.hooknum = hook;
 
+#ifdef CONFIG_IP_NF_IPTABLES_COMPILE
+	if (private->compiled) {
+		verdict = ipt_do_compiled(skb, state, table, private,
+					  indev, outdev,
+					  (struct ipt_crule **)jumpstack,
+					  &acpar);
+		goto out;
+	}
+#endif
+
 	do {
 		const struct xt_entry_target *t;
 		const struct xt_entry_match *ematch;
@@ -428,6 +736,9 @@ ipt_do_table(struct sk_buff *skb,
 			break;
 	} while (!acpar.hotdrop);
 
+#ifdef CONFIG_IP_NF_IPTABLES_COMPILE
+ out:
+#endif
 	xt_write_recseq_end(addend);
 	local_bh_enable();
 
@@ -822,6 +1133,9 @@ translate_table(struct net *net, struct xt_table_info *newinfo, void *entry0,
 		return ret;
 	}
 
+#ifdef CONFIG_IP_NF_IPTABLES_COMPILE
+	ipt_compile(newinfo, entry0, repl->valid_hooks);
+#endif
 	return ret;
  out_free:
 	kvfree(offsets);
@@ -1172,7 +1486,7 @@ __do_replace(struct net *net, const char *name, unsigned int valid_hooks,
 	xt_entry_foreach(iter, oldinfo->entries, oldinfo->size)
 		cleanup_entry(iter, net);
 
-	xt_free_table_info(oldinfo);
+	ipt_free_table_info(oldinfo);
 	if (copy_to_user(counters_ptr, counters,
 			 sizeof(struct xt_counters) * num_counters) != 0) {
 		/* Silent error, can't fail, new table is already in place */
@@ -1236,7 +1550,7 @@ do_replace(struct net *net, const void __user *user, unsigned int len)
 	xt_entry_foreach(iter, loc_cpu_entry, newinfo->size)
 		cleanup_entry(iter, net);
  free_newinfo:
-	xt_free_table_info(newinfo);
+	ipt_free_table_info(newinfo);
 	return ret;
 }
 
@@ -1560,11 +1874,11 @@ translate_compat_table(struct net *net,
 
 	*pinfo = newinfo;
 	*pentry0 = entry1;
-	xt_free_table_info(info);
+	ipt_free_table_info(info);
 	return 0;
 
 free_newinfo:
-	xt_free_table_info(newinfo);
+	ipt_free_table_info(newinfo);
 	return ret;
 out_unlock:
 	xt_compat_flush_offsets(AF_INET);
@@ -1622,7 +1936,7 @@ compat_do_replace(struct net *net, void __user *user, unsigned int len)
 	xt_entry_foreach(iter, loc_cpu_entry, newinfo->size)
 		cleanup_entry(iter, net);
  free_newinfo:
-	xt_free_table_info(newinfo);
+	ipt_free_table_info(newinfo);
 	return ret;
 }
 
@@ -1841,7 +2155,7 @@ static void __ipt_unregister_table(struct net *net, struct xt_table *table)
 		cleanup_entry(iter, net);
 	if (private->number > private->initial_entries)
 		module_put(table_owner);
-	xt_free_table_info(private);
+	ipt_free_table_info(private);
 }
 
 int ipt_register_table(struct net *net, const struct xt_table *table,
@@ -1883,7 +2197,7 @@ int ipt_register_table(struct net *net, const struct xt_table *table,
 	return ret;
 
 out_free:
-	xt_free_table_info(newinfo);
+	ipt_free_table_info(newinfo);
 	return ret;
 }
 
@@ -1894,6 +2208,153 @@ void ipt_unregister_table(struct net *net, struct xt_table *table,
 	__ipt_unregister_table(net, table);
 }
 
+#ifdef CONFIG_IP_NF_IPTABLES_COMPILE_BENCH
+/*
+ * FORWARD chains of n rules in blocks that share an input interface,
+ * like a firewall generator's per-zone rules, and a packet that matches
+ * none of them.
+ */
+#define IPT_BENCH_BLOCK	16
+#define IPT_BENCH_RUNS	1000
+
+static const unsigned int ipt_bench_rules[] __initconst = {
+	16, 64, 256, 1024
+};
+
+static const struct xt_table ipt_bench_table __initconst = {
+	.name		= "ipt_bench",
+	.valid_hooks	= 1 << NF_INET_FORWARD,
+	.me		= THIS_MODULE,
+	.af		= NFPROTO_IPV4,
+};
+
+static struct ipt_replace * __init ipt_bench_repl(unsigned int n)
+{
+	struct ipt_replace *repl;
+	struct ipt_standard *r;
+	struct ipt_error *err;
+	unsigned int i, size;
+
+	size = (n + 1) * sizeof(*r) + sizeof(*err);
+	repl = vzalloc(sizeof(*repl) + size);
+	if (!repl)
+		return NULL;
+
+	strcpy(repl->name, ipt_bench_table.name);
+	repl->valid_hooks = ipt_bench_table.valid_hooks;
+	repl->num_entries = n + 2;
+	repl->size = size;
+	repl->hook_entry[NF_INET_FORWARD] = 0;
+	repl->underflow[NF_INET_FORWARD] = n * sizeof(*r);
+
+	r = (struct ipt_standard *)repl->entries;
+	for (i = 0; i < n; i++) {
+		struct ipt_ip *ip = &r[i].entry.ip;
+
+		r[i] = (struct ipt_standard)IPT_STANDARD_INIT(NF_DROP);
+		snprintf(ip->iniface, IFNAMSIZ, "eth%u", i / IPT_BENCH_BLOCK);
+		memset(ip->iniface_mask, 0xff, strlen(ip->iniface) + 1);
+		ip->src.s_addr = htonl(0x0a000000 | i << 8);
+		ip->smsk.s_addr = htonl(0xffffff00);
+		ip->proto = IPPROTO_TCP;
+	}
+	r[n] = (struct ipt_standard)IPT_STANDARD_INIT(NF_ACCEPT);
+	err = (struct ipt_error *)&r[n + 1];
+	*err = (struct ipt_error)IPT_ERROR_INIT;
+
+	return repl;
+}
+
+static u64 __init ipt_bench_walk(struct xt_table *table, struct sk_buff *skb)
+{
+	struct nf_hook_state state = {
+		.hook	= NF_INET_FORWARD,
+		.pf	= NFPROTO_IPV4,
+		.net	= &init_net,
+	};
+	u64 start;
+	int i;
+
+	start = ktime_get_ns();
+	for (i = 0; i < IPT_BENCH_RUNS; i++)
+		ipt_do_table(skb, &state, table);
+
+	return div_u64(ktime_get_ns() - start, IPT_BENCH_RUNS);
+}
+
+static void __init ipt_bench(void)
+{
+	struct xt_table_info bootstrap = {0};
+	struct xt_table_info *newinfo;
+	struct ipt_replace *repl;
+	struct xt_table *table;
+	struct ipt_entry *iter;
+	struct sk_buff *skb;
+	struct iphdr *iph;
+	u64 linear, compiled;
+	void *comp;
+	int i;
+
+	skb = alloc_skb(sizeof(*iph), GFP_KERNEL);
+	if (!skb)
+		return;
+
+	skb_reset_network_header(skb);
+	iph = (struct iphdr *)skb_put(skb, sizeof(*iph));
+	memset(iph, 0, sizeof(*iph));
+	iph->version = 4;
+	iph->ihl = 5;
+	iph->protocol = IPPROTO_UDP;
+	iph->saddr = htonl(0xc0a80102);
+	iph->daddr = htonl(0x08080808);
+
+	for (i = 0; i < ARRAY_SIZE(ipt_bench_rules); i++) {
+		repl = ipt_bench_repl(ipt_bench_rules[i]);
+		if (!repl)
+			break;
+
+		newinfo = xt_alloc_table_info(repl->size);
+		if (!newinfo) {
+			vfree(repl);
+			break;
+		}
+		memcpy(newinfo->entries, repl->entries, repl->size);
+
+		if (translate_table(&init_net, newinfo, newinfo->entries,
+				    repl)) {
+			ipt_free_table_info(newinfo);
+			vfree(repl);
+			break;
+		}
+		vfree(repl);
+
+		table = xt_register_table(&init_net, &ipt_bench_table,
+					  &bootstrap, newinfo);
+		if (IS_ERR(table)) {
+			xt_entry_foreach(iter, newinfo->entries, newinfo->size)
+				cleanup_entry(iter, &init_net);
+			ipt_free_table_info(newinfo);
+			break;
+		}
+
+		compiled = ipt_bench_walk(table, skb);
+		comp = newinfo->compiled;
+		newinfo->compiled = NULL;
+		linear = ipt_bench_walk(table, skb);
+		newinfo->compiled = comp;
+
+		__ipt_unregister_table(&init_net, table);
+
+		pr_info("bench: %u rules, %llu ns linear, %llu ns compiled per packet\n",
+			ipt_bench_rules[i], linear, compiled);
+	}
+
+	kfree_skb(skb);
+}
+#else
+static inline void ipt_bench(void) { }
+#endif /* CONFIG_IP_NF_IPTABLES_COMPILE_BENCH */
+
 /* Returns 1 if the type and code is matched by the range, 0 otherwise */
 static inline bool
 icmp_type_code_match(u_int8_t test_type, u_int8_t min_code, u_int8_t max_code,
@@ -2023,6 +2484,8 @@ static int __init ip_tables_init(void)
 	if (ret < 0)
 		goto err5;
 
+	ipt_bench();
+
 	pr_info("(C) 2000-2006 Netfilter Core Team\n");
 	return 0;
 
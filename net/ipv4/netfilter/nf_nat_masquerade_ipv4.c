@@ -9,19 +9,127 @@
 #include <linux/types.h>
 #include <linux/module.h>
 #include <linux/atomic.h>
+#include <linux/hash.h>
 #include <linux/inetdevice.h>
 #include <linux/ip.h>
 #include <linux/timer.h>
+#include <linux/workqueue.h>
 #include <linux/netfilter.h>
 #include <net/protocol.h>
 #include <net/ip.h>
 #include <net/checksum.h>
 #include <net/route.h>
+#include <net/netns/hash.h>
 #include <linux/netfilter_ipv4.h>
 #include <linux/netfilter/x_tables.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_extend.h>
 #include <net/netfilter/nf_nat.h>
 #include <net/netfilter/ipv4/nf_nat_masquerade.h>
 
+/* Masqueraded conntracks are indexed by output device, so that a device
+ * going down or losing an address only has to look at its own entries
+ * instead of the whole conntrack table. The entries live outside of the
+ * conntrack extension area, which can move until the conntrack is
+ * confirmed.
+ */
+struct nf_masq_entry {
+	struct hlist_node	node;
+	struct nf_conn		*ct;
+	struct net		*net;
+	int			ifindex;
+	__be32			addr;
+	u32			gen;
+	bool			dead;
+};
+
+#define MASQ_HASH_BITS	6
+#define MASQ_BATCH	16
+
+static struct hlist_head masq_hash[1 << MASQ_HASH_BITS];
+static DEFINE_SPINLOCK(masq_lock);
+/* bumped by every cleanup, entries created later don't match it */
+static u32 masq_gen;
+
+/* Pending cleanups, a batch of conntracks is killed per work run */
+struct masq_cleanup {
+	struct list_head	list;
+	struct net		*net;
+	int			ifindex;
+	__be32			addr;
+	u32			gen;
+};
+
+static LIST_HEAD(masq_cleanup_list);
+static void masq_cleanup_work(struct work_struct *work);
+static DECLARE_WORK(masq_work, masq_cleanup_work);
+
+static bool defer_cleanup __read_mostly;
+module_param(defer_cleanup, bool, 0644);
+MODULE_PARM_DESC(defer_cleanup,
+		 "Flush conntracks from a workqueue, a batch at a time");
+
+static struct hlist_head *masq_bucket(const struct net *net, int ifindex)
+{
+	return &masq_hash[hash_32(ifindex ^ net_hash_mix(net),
+				  MASQ_HASH_BITS)];
+}
+
+static struct nf_conn_masq *nfct_masq(const struct nf_conn *ct)
+{
+	return nf_ct_ext_find(ct, NF_CT_EXT_MASQ);
+}
+
+static int masq_index_add(struct nf_conn *ct, int ifindex, __be32 addr)
+{
+	struct nf_masq_entry *e;
+	struct nf_conn_masq *masq;
+
+	masq = nf_ct_ext_add(ct, NF_CT_EXT_MASQ, GFP_ATOMIC);
+	if (!masq)
+		return -ENOMEM;
+
+	e = kmalloc(sizeof(*e), GFP_ATOMIC);
+	masq->entry = e;
+	if (!e)
+		return -ENOMEM;
+
+	e->ct = ct;
+	e->net = nf_ct_net(ct);
+	e->ifindex = ifindex;
+	e->addr = addr;
+	e->dead = false;
+
+	spin_lock_bh(&masq_lock);
+	e->gen = masq_gen;
+	hlist_add_head(&e->node, masq_bucket(e->net, ifindex));
+	spin_unlock_bh(&masq_lock);
+
+	return 0;
+}
+
+static void masq_ext_destroy(struct nf_conn *ct)
+{
+	struct nf_conn_masq *masq = nfct_masq(ct);
+	struct nf_masq_entry *e;
+
+	spin_lock_bh(&masq_lock);
+	e = masq->entry;
+	if (e)
+		hlist_del(&e->node);
+	masq->entry = NULL;
+	spin_unlock_bh(&masq_lock);
+
+	kfree(e);
+}
+
+static struct nf_ct_ext_type masq_extend __read_mostly = {
+	.len		= sizeof(struct nf_conn_masq),
+	.align		= __alignof__(struct nf_conn_masq),
+	.destroy	= masq_ext_destroy,
+	.id		= NF_CT_EXT_MASQ,
+};
+
 unsigned int
 nf_nat_masquerade_ipv4(struct sk_buff *skb, unsigned int hooknum,
 		       const struct nf_nat_range *range,
@@ -56,6 +164,9 @@ nf_nat_masquerade_ipv4(struct sk_buff *skb, unsigned int hooknum,
 		return NF_DROP;
 	}
 
+	if (masq_index_add(ct, out->ifindex, newsrc))
+		return NF_DROP;
+
 	nat->masq_index = out->ifindex;
 
 	/* Transfer from original range. */
@@ -72,15 +183,144 @@ nf_nat_masquerade_ipv4(struct sk_buff *skb, unsigned int hooknum,
 }
 EXPORT_SYMBOL_GPL(nf_nat_masquerade_ipv4);
 
-static int device_cmp(struct nf_conn *i, void *ifindex)
+/* Marks an unconfirmed conntrack dying the way a conntrack flush does,
+ * under the lock of the per-cpu list it was put on. __nf_conntrack_confirm
+ * takes it off that list under the same lock and then checks the bit, so
+ * it either sees the bit and drops the conntrack, or has already taken it
+ * off the list, in which case false is returned and it has to be killed
+ * like a confirmed one.
+ */
+static bool masq_kill_unconfirmed(struct nf_conn *ct)
+{
+	struct ct_pcpu *pcpu = per_cpu_ptr(nf_ct_net(ct)->ct.pcpu_lists,
+					   ct->cpu);
+	struct nf_conntrack_tuple_hash *h;
+	struct hlist_nulls_node *n;
+	bool found = false;
+
+	spin_lock(&pcpu->lock);
+	hlist_nulls_for_each_entry(h, n, &pcpu->unconfirmed, hnnode) {
+		if (nf_ct_tuplehash_to_ctrack(h) == ct) {
+			set_bit(IPS_DYING_BIT, &ct->status);
+			found = true;
+			break;
+		}
+	}
+	spin_unlock(&pcpu->lock);
+
+	return found;
+}
+
+/* Kills up to MASQ_BATCH conntracks masqueraded to @ifindex and, unless
+ * it is 0, to @addr, that were set up before the cleanup @gen was taken.
+ * Returns the number of entries it went through, a full batch means
+ * there may be more.
+ */
+static unsigned int masq_cleanup_batch(struct net *net, int ifindex,
+				       __be32 addr, u32 gen)
+{
+	struct nf_conn *batch[MASQ_BATCH];
+	struct nf_masq_entry *e;
+	unsigned int i, n = 0, found = 0;
+
+	spin_lock_bh(&masq_lock);
+	hlist_for_each_entry(e, masq_bucket(net, ifindex), node) {
+		struct nf_conn *ct = e->ct;
+
+		if (e->dead || e->ifindex != ifindex || !net_eq(e->net, net) ||
+		    (addr && e->addr != addr) || (s32)(e->gen - gen) > 0)
+			continue;
+
+		/* never looked at again, even if it stays around */
+		e->dead = true;
+		found++;
+
+		if (!nf_ct_is_confirmed(ct) && masq_kill_unconfirmed(ct))
+			continue;
+
+		if (!nf_ct_is_dying(ct) &&
+		    atomic_inc_not_zero(&ct->ct_general.use))
+			batch[n++] = ct;
+
+		if (found == MASQ_BATCH)
+			break;
+	}
+	spin_unlock_bh(&masq_lock);
+
+	for (i = 0; i < n; i++) {
+		nf_ct_kill(batch[i]);
+		nf_ct_put(batch[i]);
+	}
+
+	return found;
+}
+
+static void masq_cleanup_work(struct work_struct *work)
 {
-	const struct nf_conn_nat *nat = nfct_nat(i);
+	struct masq_cleanup *c;
+	bool more;
+
+	spin_lock_bh(&masq_lock);
+	c = list_first_entry_or_null(&masq_cleanup_list, struct masq_cleanup,
+				     list);
+	spin_unlock_bh(&masq_lock);
+	if (!c)
+		return;
+
+	if (masq_cleanup_batch(c->net, c->ifindex, c->addr,
+			       c->gen) < MASQ_BATCH) {
+		spin_lock_bh(&masq_lock);
+		list_del(&c->list);
+		spin_unlock_bh(&masq_lock);
+		put_net(c->net);
+		kfree(c);
+	}
 
-	if (!nat)
-		return 0;
-	if (nf_ct_l3num(i) != NFPROTO_IPV4)
-		return 0;
-	return nat->masq_index == (int)(long)ifindex;
+	spin_lock_bh(&masq_lock);
+	more = !list_empty(&masq_cleanup_list);
+	spin_unlock_bh(&masq_lock);
+
+	/* one batch per run, the rest of the system gets to go in between */
+	if (more)
+		schedule_work(&masq_work);
+}
+
+static void masq_cleanup(struct net *net, int ifindex, __be32 addr)
+{
+	struct masq_cleanup *c;
+	u32 gen;
+
+	/* conntracks masqueraded after this point, e.g. once the device
+	 * is back up, must survive a cleanup that is still pending then
+	 */
+	spin_lock_bh(&masq_lock);
+	gen = masq_gen++;
+	spin_unlock_bh(&masq_lock);
+
+	if (defer_cleanup) {
+		c = kmalloc(sizeof(*c), GFP_KERNEL);
+		if (c) {
+			c->net = maybe_get_net(net);
+			if (!c->net) {
+				/* netns teardown flushes the table */
+				kfree(c);
+				return;
+			}
+			c->ifindex = ifindex;
+			c->addr = addr;
+			c->gen = gen;
+
+			spin_lock_bh(&masq_lock);
+			list_add_tail(&c->list, &masq_cleanup_list);
+			spin_unlock_bh(&masq_lock);
+
+			schedule_work(&masq_work);
+			return;
+		}
+	}
+
+	while (masq_cleanup_batch(net, ifindex, addr, gen) == MASQ_BATCH)
+		cond_resched();
 }
 
 static int masq_device_event(struct notifier_block *this,
@@ -91,14 +331,12 @@ static int masq_device_event(struct notifier_block *this,
 	struct net *net = dev_net(dev);
 
 	if (event == NETDEV_DOWN) {
-		/* Device was downed.  Search entire table for
-		 * conntracks which were associated with that device,
-		 * and forget them.
+		/* Device was downed.  Forget the conntracks which were
+		 * associated with that device.
 		 */
 		NF_CT_ASSERT(dev->ifindex != 0);
 
-		nf_ct_iterate_cleanup(net, device_cmp,
-				      (void *)(long)dev->ifindex, 0, 0);
+		masq_cleanup(net, dev->ifindex, 0);
 	}
 
 	return NOTIFY_DONE;
@@ -108,19 +346,22 @@ static int masq_inet_event(struct notifier_block *this,
 			   unsigned long event,
 			   void *ptr)
 {
-	struct in_device *idev = ((struct in_ifaddr *)ptr)->ifa_dev;
-	struct netdev_notifier_info info;
+	struct in_ifaddr *ifa = ptr;
+	struct in_device *idev = ifa->ifa_dev;
 
 	/* The masq_dev_notifier will catch the case of the device going
 	 * down.  So if the inetdev is dead and being destroyed we have
 	 * no work to do.  Otherwise this is an individual address removal
-	 * and we have to perform the flush.
+	 * and we have to flush the conntracks masqueraded to it.
 	 */
 	if (idev->dead)
 		return NOTIFY_DONE;
 
-	netdev_notifier_info_init(&info, idev->dev);
-	return masq_device_event(this, event, &info);
+	if (event == NETDEV_DOWN)
+		masq_cleanup(dev_net(idev->dev), idev->dev->ifindex,
+			     ifa->ifa_local);
+
+	return NOTIFY_DONE;
 }
 
 static struct notifier_block masq_dev_notifier = {
@@ -157,5 +398,35 @@ void nf_nat_masquerade_ipv4_unregister_notifier(void)
 }
 EXPORT_SYMBOL_GPL(nf_nat_masquerade_ipv4_unregister_notifier);
 
+static int __init nf_nat_masquerade_ipv4_init(void)
+{
+	return nf_ct_extend_register(&masq_extend);
+}
+
+static void __exit nf_nat_masquerade_ipv4_fini(void)
+{
+	struct masq_cleanup *c, *next;
+	struct nf_masq_entry *e;
+	struct hlist_node *n;
+	int i;
+
+	nf_ct_extend_unregister(&masq_extend);
+	cancel_work_sync(&masq_work);
+
+	list_for_each_entry_safe(c, next, &masq_cleanup_list, list) {
+		put_net(c->net);
+		kfree(c);
+	}
+
+	/* the conntracks outlive us, their extension is no longer looked at */
+	for (i = 0; i < ARRAY_SIZE(masq_hash); i++) {
+		hlist_for_each_entry_safe(e, n, &masq_hash[i], node)
+			kfree(e);
+	}
+}
+
+module_init(nf_nat_masquerade_ipv4_init);
+module_exit(nf_nat_masquerade_ipv4_fini);
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Rusty Russell <rusty@rustcorp.com.au>");
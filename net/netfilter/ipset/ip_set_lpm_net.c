@@ -0,0 +1,811 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/* Kernel module implementing an IP set type: the lpm:net type
+ *
+ * The prefixes are stored in a multibit trie with a stride of four bits.
+ * A node at depth d branches on the d-th nibble of the address and holds
+ * the prefixes which end within that nibble: the ones one to four bits
+ * longer than 4 * d, plus the zero length prefix in the root. The prefixes
+ * of a node are kept in a bitmap indexed tree, so the longest one matching
+ * a nibble is found by masking the bitmap with the nibble's cover and
+ * taking the highest set bit.
+ *
+ * A lookup visits at most one node per nibble, whatever the number of
+ * elements and of the different prefix lengths in the set, where hash:net
+ * probes the hash once for every prefix length present.
+ *
+ * Tests run under RCU, add, del and the garbage collector under the set
+ * lock. Elements and nodes are freed after a grace period.
+ */
+
+#include <linux/module.h>
+#include <linux/ip.h>
+#include <linux/skbuff.h>
+#include <linux/errno.h>
+#include <linux/slab.h>
+#include <linux/timer.h>
+#include <net/ip.h>
+#include <net/ipv6.h>
+#include <net/netlink.h>
+
+#include <linux/netfilter.h>
+#include <linux/netfilter/ipset/pfxlen.h>
+#include <linux/netfilter/ipset/ip_set.h>
+#include <linux/netfilter/ipset/ip_set_hash.h>
+
+#define IPSET_TYPE_REV_MIN	0
+#define IPSET_TYPE_REV_MAX	0
+
+MODULE_LICENSE("GPL");
+IP_SET_MODULE_DESC("lpm:net", IPSET_TYPE_REV_MIN, IPSET_TYPE_REV_MAX);
+MODULE_ALIAS("ip_set_lpm:net");
+
+#define LPM_STRIDE		4
+#define LPM_SLOTS		(1 << LPM_STRIDE)
+/* Prefixes ending in a node: 1 + 2 + 4 + 8 + 16 */
+#define LPM_PREFIXES		(2 * LPM_SLOTS - 1)
+
+#define lpm_dereference_protected(p, set) \
+	rcu_dereference_protected(p, lockdep_is_held(&(set)->lock))
+
+/* Member elements, the extensions follow */
+struct lpm_net_elem {
+	struct rcu_head rcu;
+	union nf_inet_addr ip;
+	u8 nomatch;
+	u8 cidr;
+};
+
+struct lpm_net_node {
+	struct rcu_head rcu;
+	u32 used;			/* bitmap of the prefixes */
+	u32 children;			/* number of child nodes */
+	struct lpm_net_node __rcu *child[LPM_SLOTS];
+	struct lpm_net_elem __rcu *prefix[LPM_PREFIXES];
+};
+
+/* The set header */
+struct lpm_net {
+	struct lpm_net_node __rcu *root;
+	struct timer_list gc;		/* garbage collector */
+	u32 maxelem;			/* max elements in the set */
+	u32 elements;			/* current element number */
+	u32 nodes;			/* current node number */
+};
+
+/* Prefixes of a node matching the nibble */
+static u32 lpm_net_cover[LPM_SLOTS] __read_mostly;
+
+static inline u8
+lpm_net_host_mask(const struct ip_set *set)
+{
+	return set->family == NFPROTO_IPV4 ? 32 : 128;
+}
+
+/* The nibble of the address a node at depth branches on */
+static inline u8
+lpm_net_nibble(const union nf_inet_addr *ip, u8 depth)
+{
+	u8 b = ((const u8 *)ip)[depth / 2];
+
+	return depth & 1 ? b & 0xf : b >> 4;
+}
+
+/* Depth of the node which holds the prefix */
+static inline u8
+lpm_net_depth(u8 cidr)
+{
+	return cidr ? (cidr - 1) / LPM_STRIDE : 0;
+}
+
+/* Position of the prefix in its node */
+static inline u8
+lpm_net_index(const union nf_inet_addr *ip, u8 cidr)
+{
+	u8 depth, len;
+
+	if (!cidr)
+		return 0;
+	depth = lpm_net_depth(cidr);
+	len = cidr - depth * LPM_STRIDE;
+
+	return (1 << len) - 1 +
+	       (lpm_net_nibble(ip, depth) >> (LPM_STRIDE - len));
+}
+
+static inline bool
+lpm_net_expired(const struct ip_set *set, struct lpm_net_elem *e)
+{
+	return SET_WITH_TIMEOUT(set) &&
+	       ip_set_timeout_expired(ext_timeout(e, set));
+}
+
+static size_t
+lpm_net_memsize(const struct ip_set *set, const struct lpm_net *t)
+{
+	return sizeof(*t) + t->nodes * sizeof(struct lpm_net_node) +
+	       t->elements * set->dsize;
+}
+
+/* Longest matching, not timed out prefix of an address */
+static struct lpm_net_elem *
+lpm_net_lookup(const struct ip_set *set, const struct lpm_net *t,
+	       const union nf_inet_addr *ip)
+{
+	struct lpm_net_elem *e, *best = NULL;
+	struct lpm_net_node *n;
+	u8 depth, slot;
+	u32 used;
+	int i;
+
+	n = rcu_dereference_bh(t->root);
+	for (depth = 0; n; depth++) {
+		slot = lpm_net_nibble(ip, depth);
+		used = READ_ONCE(n->used) & lpm_net_cover[slot];
+		while (used) {
+			i = __fls(used);
+			e = rcu_dereference_bh(n->prefix[i]);
+			if (e && !lpm_net_expired(set, e)) {
+				best = e;
+				break;
+			}
+			used &= ~(1U << i);
+		}
+		n = rcu_dereference_bh(n->child[slot]);
+	}
+
+	return best;
+}
+
+/* The element stored exactly with the prefix */
+static struct lpm_net_elem *
+lpm_net_find(const struct ip_set *set, const struct lpm_net *t,
+	     const struct lpm_net_elem *d)
+{
+	struct lpm_net_elem *e;
+	struct lpm_net_node *n;
+	u8 depth;
+
+	n = rcu_dereference_bh(t->root);
+	for (depth = 0; n && depth < lpm_net_depth(d->cidr); depth++)
+		n = rcu_dereference_bh(
+			n->child[lpm_net_nibble(&d->ip, depth)]);
+	if (!n)
+		return NULL;
+	e = rcu_dereference_bh(n->prefix[lpm_net_index(&d->ip, d->cidr)]);
+	if (!e || lpm_net_expired(set, e))
+		return NULL;
+
+	return e;
+}
+
+/* Look up, or create, the nodes from the root down to the one which
+ * holds the prefix. Returns the number of nodes stored into path.
+ */
+static int
+lpm_net_path(struct ip_set *set, struct lpm_net *t,
+	     const struct lpm_net_elem *d, struct lpm_net_node **path,
+	     bool create)
+{
+	struct lpm_net_node __rcu **slot = &t->root;
+	struct lpm_net_node *n;
+	u8 depth;
+
+	for (depth = 0; depth <= lpm_net_depth(d->cidr); depth++) {
+		n = lpm_dereference_protected(*slot, set);
+		if (!n) {
+			if (!create)
+				break;
+			n = kzalloc(sizeof(*n), GFP_ATOMIC);
+			if (!n)
+				break;
+			t->nodes++;
+			if (depth)
+				path[depth - 1]->children++;
+			rcu_assign_pointer(*slot, n);
+		}
+		path[depth] = n;
+		slot = &n->child[lpm_net_nibble(&d->ip, depth)];
+	}
+
+	return depth;
+}
+
+/* Remove the empty nodes at the end of the path */
+static void
+lpm_net_prune(struct ip_set *set, struct lpm_net *t,
+	      const union nf_inet_addr *ip, struct lpm_net_node **path,
+	      int depth)
+{
+	struct lpm_net_node *n;
+
+	while (depth--) {
+		n = path[depth];
+		if (n->used || n->children)
+			break;
+		if (depth) {
+			RCU_INIT_POINTER(path[depth - 1]->child[
+				lpm_net_nibble(ip, depth - 1)], NULL);
+			path[depth - 1]->children--;
+		} else {
+			RCU_INIT_POINTER(t->root, NULL);
+		}
+		t->nodes--;
+		kfree_rcu(n, rcu);
+	}
+}
+
+static void
+lpm_net_free_elem(struct ip_set *set, struct lpm_net *t,
+		  struct lpm_net_node *n, int i)
+{
+	struct lpm_net_elem *e = rcu_dereference_protected(n->prefix[i], 1);
+
+	WRITE_ONCE(n->used, n->used & ~(1U << i));
+	RCU_INIT_POINTER(n->prefix[i], NULL);
+	ip_set_ext_destroy(set, e);
+	kfree_rcu(e, rcu);
+	t->elements--;
+}
+
+static int
+lpm_net_test(struct ip_set *set, void *value, const struct ip_set_ext *ext,
+	     struct ip_set_ext *mext, u32 flags)
+{
+	const struct lpm_net *t = set->data;
+	const struct lpm_net_elem *d = value;
+	struct lpm_net_elem *e;
+
+	/* An address matches the longest prefix, a network only itself */
+	if (d->cidr == lpm_net_host_mask(set))
+		e = lpm_net_lookup(set, t, &d->ip);
+	else
+		e = lpm_net_find(set, t, d);
+	if (!e)
+		return 0;
+
+	if (SET_WITH_COUNTER(set))
+		ip_set_update_counter(ext_counter(e, set), ext, mext, flags);
+	if (SET_WITH_SKBINFO(set))
+		ip_set_get_skbinfo(ext_skbinfo(e, set), ext, mext, flags);
+
+	return e->nomatch ? -ENOTEMPTY : 1;
+}
+
+static int
+lpm_net_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
+	    struct ip_set_ext *mext, u32 flags)
+{
+	struct lpm_net *t = set->data;
+	const struct lpm_net_elem *d = value;
+	struct lpm_net_node *path[128 / LPM_STRIDE];
+	struct lpm_net_node *n;
+	struct lpm_net_elem *e;
+	bool flag_exist = flags & IPSET_FLAG_EXIST;
+	int depth, i, ret = 0;
+
+	depth = lpm_net_path(set, t, d, path, true);
+	if (depth <= lpm_net_depth(d->cidr)) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	n = path[depth - 1];
+	i = lpm_net_index(&d->ip, d->cidr);
+	e = lpm_dereference_protected(n->prefix[i], set);
+	if (e) {
+		if (flag_exist || lpm_net_expired(set, e))
+			/* Just the extensions could be overwritten */
+			goto overwrite_extensions;
+		return -IPSET_ERR_EXIST;
+	}
+	if (t->elements >= t->maxelem) {
+		if (net_ratelimit())
+			pr_warn("Set %s is full, maxelem %u reached\n",
+				set->name, t->maxelem);
+		ret = -IPSET_ERR_HASH_FULL;
+		goto out;
+	}
+	e = kzalloc(set->dsize, GFP_ATOMIC);
+	if (!e) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	e->ip = d->ip;
+	e->cidr = d->cidr;
+	t->elements++;
+
+overwrite_extensions:
+	e->nomatch = (flags >> 16) & IPSET_FLAG_NOMATCH;
+	if (SET_WITH_COUNTER(set))
+		ip_set_init_counter(ext_counter(e, set), ext);
+	if (SET_WITH_COMMENT(set))
+		ip_set_init_comment(ext_comment(e, set), ext);
+	if (SET_WITH_SKBINFO(set))
+		ip_set_init_skbinfo(ext_skbinfo(e, set), ext);
+	/* Must come last for the case when timed out entry is reused */
+	if (SET_WITH_TIMEOUT(set))
+		ip_set_timeout_set(ext_timeout(e, set), ext->timeout);
+	rcu_assign_pointer(n->prefix[i], e);
+	WRITE_ONCE(n->used, n->used | (1U << i));
+
+	return 0;
+out:
+	lpm_net_prune(set, t, &d->ip, path, depth);
+	return ret;
+}
+
+static int
+lpm_net_del(struct ip_set *set, void *value, const struct ip_set_ext *ext,
+	    struct ip_set_ext *mext, u32 flags)
+{
+	struct lpm_net *t = set->data;
+	const struct lpm_net_elem *d = value;
+	struct lpm_net_node *path[128 / LPM_STRIDE];
+	struct lpm_net_node *n;
+	struct lpm_net_elem *e;
+	int depth, i, ret = -IPSET_ERR_EXIST;
+
+	depth = lpm_net_path(set, t, d, path, false);
+	if (depth <= lpm_net_depth(d->cidr))
+		return ret;
+	n = path[depth - 1];
+	i = lpm_net_index(&d->ip, d->cidr);
+	e = lpm_dereference_protected(n->prefix[i], set);
+	if (!e)
+		return ret;
+	if (!lpm_net_expired(set, e))
+		ret = 0;
+	lpm_net_free_elem(set, t, n, i);
+	lpm_net_prune(set, t, &d->ip, path, depth);
+
+	return ret;
+}
+
+/* Free a subtree: the nodes may still be visited by tests */
+static void
+lpm_net_free_node(struct ip_set *set, struct lpm_net *t,
+		  struct lpm_net_node *n)
+{
+	struct lpm_net_node *child;
+	int i;
+
+	for (i = 0; i < LPM_PREFIXES; i++)
+		if (n->used & (1U << i))
+			lpm_net_free_elem(set, t, n, i);
+	for (i = 0; i < LPM_SLOTS; i++) {
+		child = rcu_dereference_protected(n->child[i], 1);
+		if (child)
+			lpm_net_free_node(set, t, child);
+	}
+	t->nodes--;
+	kfree_rcu(n, rcu);
+}
+
+static void
+lpm_net_flush(struct ip_set *set)
+{
+	struct lpm_net *t = set->data;
+	struct lpm_net_node *n = rcu_dereference_protected(t->root, 1);
+
+	RCU_INIT_POINTER(t->root, NULL);
+	if (n)
+		lpm_net_free_node(set, t, n);
+}
+
+static void
+lpm_net_destroy(struct ip_set *set)
+{
+	struct lpm_net *t = set->data;
+
+	if (SET_WITH_TIMEOUT(set))
+		del_timer_sync(&t->gc);
+
+	lpm_net_flush(set);
+	kfree(t);
+
+	set->data = NULL;
+}
+
+/* Delete the expired elements of a subtree, returns true when the node
+ * became empty and can be freed by the caller.
+ */
+static bool
+lpm_net_expire(struct ip_set *set, struct lpm_net *t, struct lpm_net_node *n)
+{
+	struct lpm_net_node *child;
+	struct lpm_net_elem *e;
+	int i;
+
+	for (i = 0; i < LPM_PREFIXES; i++) {
+		if (!(n->used & (1U << i)))
+			continue;
+		e = lpm_dereference_protected(n->prefix[i], set);
+		if (ip_set_timeout_expired(ext_timeout(e, set)))
+			lpm_net_free_elem(set, t, n, i);
+	}
+	for (i = 0; i < LPM_SLOTS; i++) {
+		child = lpm_dereference_protected(n->child[i], set);
+		if (!child || !lpm_net_expire(set, t, child))
+			continue;
+		RCU_INIT_POINTER(n->child[i], NULL);
+		n->children--;
+		t->nodes--;
+		kfree_rcu(child, rcu);
+	}
+
+	return !n->used && !n->children;
+}
+
+static void
+lpm_net_gc(unsigned long ul_set)
+{
+	struct ip_set *set = (struct ip_set *)ul_set;
+	struct lpm_net *t = set->data;
+	struct lpm_net_node *n;
+
+	spin_lock_bh(&set->lock);
+	n = lpm_dereference_protected(t->root, set);
+	if (n && lpm_net_expire(set, t, n)) {
+		RCU_INIT_POINTER(t->root, NULL);
+		t->nodes--;
+		kfree_rcu(n, rcu);
+	}
+	spin_unlock_bh(&set->lock);
+
+	t->gc.expires = jiffies + IPSET_GC_PERIOD(set->timeout) * HZ;
+	add_timer(&t->gc);
+}
+
+static void
+lpm_net_gc_init(struct ip_set *set, void (*gc)(unsigned long ul_set))
+{
+	struct lpm_net *t = set->data;
+
+	init_timer(&t->gc);
+	t->gc.data = (unsigned long)set;
+	t->gc.function = gc;
+	t->gc.expires = jiffies + IPSET_GC_PERIOD(set->timeout) * HZ;
+	add_timer(&t->gc);
+}
+
+static int
+lpm_net_head(struct ip_set *set, struct sk_buff *skb)
+{
+	const struct lpm_net *t = set->data;
+	struct nlattr *nested;
+	size_t memsize;
+
+	spin_lock_bh(&set->lock);
+	memsize = lpm_net_memsize(set, t);
+	spin_unlock_bh(&set->lock);
+
+	nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
+	if (!nested)
+		goto nla_put_failure;
+	if (nla_put_net32(skb, IPSET_ATTR_MAXELEM, htonl(t->maxelem)) ||
+	    nla_put_net32(skb, IPSET_ATTR_REFERENCES, htonl(set->ref)) ||
+	    nla_put_net32(skb, IPSET_ATTR_MEMSIZE, htonl(memsize)))
+		goto nla_put_failure;
+	if (unlikely(ip_set_put_flags(skb, set)))
+		goto nla_put_failure;
+	ipset_nest_end(skb, nested);
+
+	return 0;
+nla_put_failure:
+	return -EMSGSIZE;
+}
+
+static bool
+lpm_net_data_list(struct sk_buff *skb, const struct ip_set *set,
+		  const struct lpm_net_elem *e)
+{
+	u32 flags = e->nomatch ? IPSET_FLAG_NOMATCH : 0;
+
+	if (set->family == NFPROTO_IPV4) {
+		if (nla_put_ipaddr4(skb, IPSET_ATTR_IP, e->ip.ip))
+			return true;
+	} else if (nla_put_ipaddr6(skb, IPSET_ATTR_IP, &e->ip.in6)) {
+		return true;
+	}
+
+	return nla_put_u8(skb, IPSET_ATTR_CIDR, e->cidr) ||
+	       (flags &&
+		nla_put_net32(skb, IPSET_ATTR_CADT_FLAGS, htonl(flags)));
+}
+
+/* List a subtree in prefix order. pos counts the elements walked, the
+ * ones before cb->args[IPSET_CB_ARG0] were sent in a previous message.
+ */
+static int
+lpm_net_list_node(const struct ip_set *set, struct sk_buff *skb,
+		  struct netlink_callback *cb, const struct lpm_net_node *n,
+		  unsigned long *pos)
+{
+	const struct lpm_net_node *child;
+	struct lpm_net_elem *e;
+	struct nlattr *nested;
+	int i, ret;
+
+	for (i = 0; i < LPM_PREFIXES; i++) {
+		e = rcu_dereference_bh(n->prefix[i]);
+		if (!e || lpm_net_expired(set, e))
+			continue;
+		if ((*pos)++ < cb->args[IPSET_CB_ARG0])
+			continue;
+		nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
+		if (!nested)
+			return -EMSGSIZE;
+		if (lpm_net_data_list(skb, set, e) ||
+		    ip_set_put_extensions(skb, set, e, true)) {
+			nla_nest_cancel(skb, nested);
+			return -EMSGSIZE;
+		}
+		ipset_nest_end(skb, nested);
+		cb->args[IPSET_CB_ARG0] = *pos;
+	}
+	for (i = 0; i < LPM_SLOTS; i++) {
+		child = rcu_dereference_bh(n->child[i]);
+		if (!child)
+			continue;
+		ret = lpm_net_list_node(set, skb, cb, child, pos);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int
+lpm_net_list(const struct ip_set *set,
+	     struct sk_buff *skb, struct netlink_callback *cb)
+{
+	const struct lpm_net *t = set->data;
+	const struct lpm_net_node *n;
+	struct nlattr *atd;
+	u32 first = cb->args[IPSET_CB_ARG0];
+	unsigned long pos = 0;
+	int ret = 0;
+
+	atd = ipset_nest_start(skb, IPSET_ATTR_ADT);
+	if (!atd)
+		return -EMSGSIZE;
+
+	n = rcu_dereference_bh(t->root);
+	if (n)
+		ret = lpm_net_list_node(set, skb, cb, n, &pos);
+	if (!ret) {
+		ipset_nest_end(skb, atd);
+		/* Set listing finished */
+		cb->args[IPSET_CB_ARG0] = 0;
+		return 0;
+	}
+	if (unlikely(first == cb->args[IPSET_CB_ARG0])) {
+		/* Not even one element fit into the message */
+		nla_nest_cancel(skb, atd);
+		cb->args[IPSET_CB_ARG0] = 0;
+		return -EMSGSIZE;
+	}
+	ipset_nest_end(skb, atd);
+
+	return 0;
+}
+
+static bool
+lpm_net_same_set(const struct ip_set *a, const struct ip_set *b)
+{
+	const struct lpm_net *x = a->data;
+	const struct lpm_net *y = b->data;
+
+	return x->maxelem == y->maxelem &&
+	       a->timeout == b->timeout &&
+	       a->extensions == b->extensions;
+}
+
+static int
+lpm_net_kadt(struct ip_set *set, const struct sk_buff *skb,
+	     const struct xt_action_param *par,
+	     enum ipset_adt adt, struct ip_set_adt_opt *opt)
+{
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	struct lpm_net_elem e = { .cidr = lpm_net_host_mask(set) };
+	struct ip_set_ext ext = IP_SET_INIT_KEXT(skb, opt, set);
+
+	if (set->family == NFPROTO_IPV4)
+		ip4addrptr(skb, opt->flags & IPSET_DIM_ONE_SRC, &e.ip.ip);
+	else
+		ip6addrptr(skb, opt->flags & IPSET_DIM_ONE_SRC, &e.ip.in6);
+
+	return adtfn(set, &e, &ext, &opt->ext, opt->cmdflags);
+}
+
+static int
+lpm_net_uadt(struct ip_set *set, struct nlattr *tb[],
+	     enum ipset_adt adt, u32 *lineno, u32 flags, bool retried)
+{
+	ipset_adtfn adtfn = set->variant->adt[adt];
+	u8 host_mask = lpm_net_host_mask(set);
+	struct lpm_net_elem e = { .cidr = host_mask };
+	struct ip_set_ext ext = IP_SET_INIT_UEXT(set);
+	u32 ip = 0, ip_to, last;
+	int ret;
+
+	if (tb[IPSET_ATTR_LINENO])
+		*lineno = nla_get_u32(tb[IPSET_ATTR_LINENO]);
+
+	if (unlikely(!tb[IPSET_ATTR_IP] ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_CADT_FLAGS)))
+		return -IPSET_ERR_PROTOCOL;
+	if (unlikely(set->family == NFPROTO_IPV6 && tb[IPSET_ATTR_IP_TO]))
+		return -IPSET_ERR_HASH_RANGE_UNSUPPORTED;
+
+	if (set->family == NFPROTO_IPV4)
+		ret = ip_set_get_hostipaddr4(tb[IPSET_ATTR_IP], &ip);
+	else
+		ret = ip_set_get_ipaddr6(tb[IPSET_ATTR_IP], &e.ip);
+	if (ret)
+		return ret;
+
+	ret = ip_set_get_extensions(set, tb, &ext);
+	if (ret)
+		return ret;
+
+	/* Unlike hash:net, the default route is a valid prefix */
+	if (tb[IPSET_ATTR_CIDR]) {
+		e.cidr = nla_get_u8(tb[IPSET_ATTR_CIDR]);
+		if (e.cidr > host_mask)
+			return -IPSET_ERR_INVALID_CIDR;
+	}
+
+	if (tb[IPSET_ATTR_CADT_FLAGS]) {
+		u32 cadt_flags = ip_set_get_h32(tb[IPSET_ATTR_CADT_FLAGS]);
+
+		if (cadt_flags & IPSET_FLAG_NOMATCH)
+			flags |= (IPSET_FLAG_NOMATCH << 16);
+	}
+
+	if (set->family == NFPROTO_IPV6) {
+		ip6_netmask(&e.ip, e.cidr);
+		ret = adtfn(set, &e, &ext, &ext, flags);
+		return ip_set_enomatch(ret, flags, adt, set) ? -ret :
+		       ip_set_eexist(ret, flags) ? 0 : ret;
+	}
+
+	if (adt == IPSET_TEST || !tb[IPSET_ATTR_IP_TO]) {
+		e.ip.ip = htonl(ip & ip_set_hostmask(e.cidr));
+		ret = adtfn(set, &e, &ext, &ext, flags);
+		return ip_set_enomatch(ret, flags, adt, set) ? -ret :
+		       ip_set_eexist(ret, flags) ? 0 : ret;
+	}
+
+	ret = ip_set_get_hostipaddr4(tb[IPSET_ATTR_IP_TO], &ip_to);
+	if (ret)
+		return ret;
+	if (ip_to < ip)
+		swap(ip, ip_to);
+	if (ip + UINT_MAX == ip_to)
+		return -IPSET_ERR_HASH_RANGE;
+
+	do {
+		e.ip.ip = htonl(ip);
+		last = ip_set_range_to_cidr(ip, ip_to, &e.cidr);
+		ret = adtfn(set, &e, &ext, &ext, flags);
+		if (ret && !ip_set_eexist(ret, flags))
+			return ret;
+
+		ret = 0;
+		ip = last + 1;
+	} while (last != ip_to);
+
+	return ret;
+}
+
+static const struct ip_set_type_variant lpm_net_variant = {
+	.kadt	= lpm_net_kadt,
+	.uadt	= lpm_net_uadt,
+	.adt	= {
+		[IPSET_ADD] = lpm_net_add,
+		[IPSET_DEL] = lpm_net_del,
+		[IPSET_TEST] = lpm_net_test,
+	},
+	.destroy = lpm_net_destroy,
+	.flush	= lpm_net_flush,
+	.head	= lpm_net_head,
+	.list	= lpm_net_list,
+	.same_set = lpm_net_same_set,
+};
+
+static int
+lpm_net_create(struct net *net, struct ip_set *set, struct nlattr *tb[],
+	       u32 flags)
+{
+	u32 maxelem = IPSET_DEFAULT_MAXELEM;
+	struct lpm_net *t;
+
+	if (!(set->family == NFPROTO_IPV4 || set->family == NFPROTO_IPV6))
+		return -IPSET_ERR_INVALID_FAMILY;
+
+	if (unlikely(!ip_set_optattr_netorder(tb, IPSET_ATTR_MAXELEM) ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_TIMEOUT) ||
+		     !ip_set_optattr_netorder(tb, IPSET_ATTR_CADT_FLAGS)))
+		return -IPSET_ERR_PROTOCOL;
+
+	if (tb[IPSET_ATTR_MAXELEM])
+		maxelem = ip_set_get_h32(tb[IPSET_ATTR_MAXELEM]);
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return -ENOMEM;
+	t->maxelem = maxelem;
+
+	set->data = t;
+	set->variant = &lpm_net_variant;
+	set->dsize = ip_set_elem_len(set, tb, sizeof(struct lpm_net_elem),
+				     __alignof__(struct lpm_net_elem));
+	set->timeout = IPSET_NO_TIMEOUT;
+	if (tb[IPSET_ATTR_TIMEOUT]) {
+		set->timeout = ip_set_timeout_uget(tb[IPSET_ATTR_TIMEOUT]);
+		lpm_net_gc_init(set, lpm_net_gc);
+	}
+
+	return 0;
+}
+
+static struct ip_set_type lpm_net_type __read_mostly = {
+	.name		= "lpm:net",
+	.protocol	= IPSET_PROTOCOL,
+	.features	= IPSET_TYPE_IP | IPSET_TYPE_NOMATCH,
+	.dimension	= IPSET_DIM_ONE,
+	.family		= NFPROTO_UNSPEC,
+	.revision_min	= IPSET_TYPE_REV_MIN,
+	.revision_max	= IPSET_TYPE_REV_MAX,
+	.create		= lpm_net_create,
+	.create_policy	= {
+		[IPSET_ATTR_MAXELEM]	= { .type = NLA_U32 },
+		[IPSET_ATTR_TIMEOUT]	= { .type = NLA_U32 },
+		[IPSET_ATTR_CADT_FLAGS]	= { .type = NLA_U32 },
+	},
+	.adt_policy	= {
+		[IPSET_ATTR_IP]		= { .type = NLA_NESTED },
+		[IPSET_ATTR_IP_TO]	= { .type = NLA_NESTED },
+		[IPSET_ATTR_CIDR]	= { .type = NLA_U8 },
+		[IPSET_ATTR_TIMEOUT]	= { .type = NLA_U32 },
+		[IPSET_ATTR_CADT_FLAGS]	= { .type = NLA_U32 },
+		[IPSET_ATTR_BYTES]	= { .type = NLA_U64 },
+		[IPSET_ATTR_PACKETS]	= { .type = NLA_U64 },
+		[IPSET_ATTR_COMMENT]	= { .type = NLA_NUL_STRING,
+					    .len  = IPSET_MAX_COMMENT_SIZE },
+		[IPSET_ATTR_SKBMARK]	= { .type = NLA_U64 },
+		[IPSET_ATTR_SKBPRIO]	= { .type = NLA_U32 },
+		[IPSET_ATTR_SKBQUEUE]	= { .type = NLA_U16 },
+	},
+	.me		= THIS_MODULE,
+};
+
+static int __init
+lpm_net_init(void)
+{
+	union nf_inet_addr ip = { };
+	u8 slot, cidr;
+
+	for (slot = 0; slot < LPM_SLOTS; slot++) {
+		ip.ip = htonl(slot << 28);
+		for (cidr = 0; cidr <= LPM_STRIDE; cidr++)
+			lpm_net_cover[slot] |= 1U << lpm_net_index(&ip, cidr);
+	}
+
+	return ip_set_type_register(&lpm_net_type);
+}
+
+static void __exit
+lpm_net_fini(void)
+{
+	rcu_barrier();
+	ip_set_type_unregister(&lpm_net_type);
+}
+
+module_init(lpm_net_init);
+module_exit(lpm_net_fini);
@@ -37,6 +37,8 @@
 #include <linux/seq_file.h>
 #include <linux/jhash.h>
 #include <linux/random.h>
+#include <linux/seqlock.h>
+#include <linux/sysctl.h>
 
 #include <net/net_namespace.h>
 #include <net/ip_vs.h>
@@ -46,21 +48,20 @@
 #define CONFIG_IP_VS_TAB_BITS	12
 #endif
 
+#define IP_VS_CONN_TAB_MIN_BITS	8
+#define IP_VS_CONN_TAB_MAX_BITS	20
+
 /*
  * Connection hash size. Default is what was selected at compile time.
+ * The table grows beyond it with the number of connections, and shrinks
+ * back to it when they go away.
 */
 static int ip_vs_conn_tab_bits = CONFIG_IP_VS_TAB_BITS;
 module_param_named(conn_tab_bits, ip_vs_conn_tab_bits, int, 0444);
-MODULE_PARM_DESC(conn_tab_bits, "Set connections' hash size");
+MODULE_PARM_DESC(conn_tab_bits, "Set connections' minimum hash size");
 
-/* size and mask values */
+/* current size */
 int ip_vs_conn_tab_size __read_mostly;
-static int ip_vs_conn_tab_mask __read_mostly;
-
-/*
- *  Connection hash table: for input and output packets lookups of IPVS
- */
-static struct hlist_head *ip_vs_conn_tab __read_mostly;
 
 /*  SLAB cache for IPVS connections */
 static struct kmem_cache *ip_vs_conn_cachep __read_mostly;
@@ -78,6 +79,38 @@ static unsigned int ip_vs_conn_rnd __read_mostly;
 #define CT_LOCKARRAY_SIZE  (1<<CT_LOCKARRAY_BITS)
 #define CT_LOCKARRAY_MASK  (CT_LOCKARRAY_SIZE-1)
 
+/*
+ *  Connection hash table: for input and output packets lookups of IPVS.
+ *
+ *  The lock of a connection is picked by the low bits of its hash key,
+ *  the bucket by as many bits as the table has. So all the buckets of a
+ *  lock stripe can be moved to a new table under that lock alone, and
+ *  that's how the table is resized. Until it is done, ->future is the new
+ *  table and ->moved tells which stripes are in it already.
+ */
+struct ip_vs_conn_tab {
+	struct ip_vs_conn_tab __rcu	*future;
+	DECLARE_BITMAP(moved, CT_LOCKARRAY_SIZE);
+	unsigned int			bits;
+	unsigned int			mask;
+	struct hlist_head		buckets[0];
+};
+
+static struct ip_vs_conn_tab __rcu *ip_vs_conn_tab __read_mostly;
+
+/* Changes while a bucket is moved, lookups that miss then look again */
+static seqcount_t ip_vs_conn_tab_seq = SEQCNT_ZERO(ip_vs_conn_tab_seq);
+
+/* Serializes resizes, and keeps the table still for a flush */
+static DEFINE_MUTEX(ip_vs_conn_tab_mutex);
+
+/* Hashed connections of all netns, and completed resizes */
+static atomic_t ip_vs_conn_hashed = ATOMIC_INIT(0);
+static unsigned long ip_vs_conn_tab_resizes;
+
+static void ip_vs_conn_tab_resize(struct work_struct *work);
+static DECLARE_WORK(ip_vs_conn_tab_work, ip_vs_conn_tab_resize);
+
 /* We need an addrstrlen that works with or without v6 */
 #ifdef CONFIG_IP_VS_IPV6
 #define IP_VS_ADDRSTRLEN INET6_ADDRSTRLEN
@@ -115,13 +148,13 @@ static unsigned int ip_vs_conn_hashkey(struct netns_ipvs *ipvs, int af, unsigned
 {
 #ifdef CONFIG_IP_VS_IPV6
 	if (af == AF_INET6)
-		return (jhash_3words(jhash(addr, 16, ip_vs_conn_rnd),
+		return jhash_3words(jhash(addr, 16, ip_vs_conn_rnd),
 				    (__force u32)port, proto, ip_vs_conn_rnd) ^
-			((size_t)ipvs>>8)) & ip_vs_conn_tab_mask;
+			((size_t)ipvs>>8);
 #endif
-	return (jhash_3words((__force u32)addr->ip, (__force u32)port, proto,
+	return jhash_3words((__force u32)addr->ip, (__force u32)port, proto,
 			    ip_vs_conn_rnd) ^
-		((size_t)ipvs>>8)) & ip_vs_conn_tab_mask;
+		((size_t)ipvs>>8);
 }
 
 static unsigned int ip_vs_conn_hashkey_param(const struct ip_vs_conn_param *p,
@@ -131,8 +164,7 @@ static unsigned int ip_vs_conn_hashkey_param(const struct ip_vs_conn_param *p,
 	__be16 port;
 
 	if (p->pe_data && p->pe->hashkey_raw)
-		return p->pe->hashkey_raw(p, ip_vs_conn_rnd, inverse) &
-			ip_vs_conn_tab_mask;
+		return p->pe->hashkey_raw(p, ip_vs_conn_rnd, inverse);
 
 	if (likely(!inverse)) {
 		addr = p->caddr;
@@ -161,6 +193,48 @@ static unsigned int ip_vs_conn_hashkey_conn(const struct ip_vs_conn *cp)
 	return ip_vs_conn_hashkey_param(&p, false);
 }
 
+/*
+ *	Returns the bucket for hash key @hash, in the new table once its lock
+ *	stripe was moved there. Called under rcu_read_lock.
+ */
+static inline struct hlist_head *ip_vs_conn_bucket(unsigned int hash)
+{
+	struct ip_vs_conn_tab *tab = rcu_dereference(ip_vs_conn_tab);
+	struct ip_vs_conn_tab *future = rcu_dereference(tab->future);
+
+	if (unlikely(future) &&
+	    test_bit(hash & CT_LOCKARRAY_MASK, tab->moved)) {
+		/* pairs with write_seqcount_end() in ip_vs_conn_tab_resize */
+		smp_rmb();
+		tab = future;
+	}
+
+	return &tab->buckets[hash & tab->mask];
+}
+
+/*
+ *	A lookup that missed has to look again if a bucket was moved, or
+ *	was being moved, while it walked the chain.
+ */
+static inline bool ip_vs_conn_tab_retry(unsigned int seq)
+{
+	return unlikely((seq & 1) ||
+			read_seqcount_retry(&ip_vs_conn_tab_seq, seq));
+}
+
+/*
+ *	Grow when there are twice as many connections as buckets, shrink
+ *	when no more than an eighth of them would be used.
+ */
+static inline void ip_vs_conn_tab_check(unsigned int count)
+{
+	unsigned int size = READ_ONCE(ip_vs_conn_tab_size);
+
+	if ((count > size * 2 && size < 1U << IP_VS_CONN_TAB_MAX_BITS) ||
+	    (count < size / 8 && size > 1U << ip_vs_conn_tab_bits))
+		schedule_work(&ip_vs_conn_tab_work);
+}
+
 /*
  *	Hashes ip_vs_conn in ip_vs_conn_tab by netns,proto,addr,port.
  *	returns bool success.
@@ -176,13 +250,14 @@ static inline int ip_vs_conn_hash(struct ip_vs_conn *cp)
 	/* Hash by protocol, client address and port */
 	hash = ip_vs_conn_hashkey_conn(cp);
 
+	rcu_read_lock();
 	ct_write_lock_bh(hash);
 	spin_lock(&cp->lock);
 
 	if (!(cp->flags & IP_VS_CONN_F_HASHED)) {
 		cp->flags |= IP_VS_CONN_F_HASHED;
 		atomic_inc(&cp->refcnt);
-		hlist_add_head_rcu(&cp->c_list, &ip_vs_conn_tab[hash]);
+		hlist_add_head_rcu(&cp->c_list, ip_vs_conn_bucket(hash));
 		ret = 1;
 	} else {
 		pr_err("%s(): request for already hashed, called from %pF\n",
@@ -192,6 +267,10 @@ static inline int ip_vs_conn_hash(struct ip_vs_conn *cp)
 
 	spin_unlock(&cp->lock);
 	ct_write_unlock_bh(hash);
+	rcu_read_unlock();
+
+	if (ret)
+		ip_vs_conn_tab_check(atomic_inc_return(&ip_vs_conn_hashed));
 
 	return ret;
 }
@@ -223,6 +302,9 @@ static inline int ip_vs_conn_unhash(struct ip_vs_conn *cp)
 	spin_unlock(&cp->lock);
 	ct_write_unlock_bh(hash);
 
+	if (ret)
+		ip_vs_conn_tab_check(atomic_dec_return(&ip_vs_conn_hashed));
+
 	return ret;
 }
 
@@ -232,7 +314,7 @@ static inline int ip_vs_conn_unhash(struct ip_vs_conn *cp)
 static inline bool ip_vs_conn_unlink(struct ip_vs_conn *cp)
 {
 	unsigned int hash;
-	bool ret;
+	bool ret, unhashed = false;
 
 	hash = ip_vs_conn_hashkey_conn(cp);
 
@@ -245,7 +327,7 @@ static inline bool ip_vs_conn_unlink(struct ip_vs_conn *cp)
 		if (atomic_cmpxchg(&cp->refcnt, 1, 0) == 1) {
 			hlist_del_rcu(&cp->c_list);
 			cp->flags &= ~IP_VS_CONN_F_HASHED;
-			ret = true;
+			ret = unhashed = true;
 		}
 	} else
 		ret = atomic_read(&cp->refcnt) ? false : true;
@@ -253,6 +335,9 @@ static inline bool ip_vs_conn_unlink(struct ip_vs_conn *cp)
 	spin_unlock(&cp->lock);
 	ct_write_unlock_bh(hash);
 
+	if (unhashed)
+		ip_vs_conn_tab_check(atomic_dec_return(&ip_vs_conn_hashed));
+
 	return ret;
 }
 
@@ -266,14 +351,16 @@ static inline bool ip_vs_conn_unlink(struct ip_vs_conn *cp)
 static inline struct ip_vs_conn *
 __ip_vs_conn_in_get(const struct ip_vs_conn_param *p)
 {
-	unsigned int hash;
+	unsigned int hash, seq;
 	struct ip_vs_conn *cp;
 
 	hash = ip_vs_conn_hashkey_param(p, false);
 
 	rcu_read_lock();
 
-	hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
+again:
+	seq = raw_read_seqcount(&ip_vs_conn_tab_seq);
+	hlist_for_each_entry_rcu(cp, ip_vs_conn_bucket(hash), c_list) {
 		if (p->cport == cp->cport && p->vport == cp->vport &&
 		    cp->af == p->af &&
 		    ip_vs_addr_equal(p->af, p->caddr, &cp->caddr) &&
@@ -289,6 +376,9 @@ __ip_vs_conn_in_get(const struct ip_vs_conn_param *p)
 		}
 	}
 
+	if (ip_vs_conn_tab_retry(seq))
+		goto again;
+
 	rcu_read_unlock();
 
 	return NULL;
@@ -352,14 +442,16 @@ EXPORT_SYMBOL_GPL(ip_vs_conn_in_get_proto);
 /* Get reference to connection template */
 struct ip_vs_conn *ip_vs_ct_in_get(const struct ip_vs_conn_param *p)
 {
-	unsigned int hash;
+	unsigned int hash, seq;
 	struct ip_vs_conn *cp;
 
 	hash = ip_vs_conn_hashkey_param(p, false);
 
 	rcu_read_lock();
 
-	hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
+again:
+	seq = raw_read_seqcount(&ip_vs_conn_tab_seq);
+	hlist_for_each_entry_rcu(cp, ip_vs_conn_bucket(hash), c_list) {
 		if (unlikely(p->pe_data && p->pe->ct_match)) {
 			if (cp->ipvs != p->ipvs)
 				continue;
@@ -384,6 +476,8 @@ struct ip_vs_conn *ip_vs_ct_in_get(const struct ip_vs_conn_param *p)
 				goto out;
 		}
 	}
+	if (ip_vs_conn_tab_retry(seq))
+		goto again;
 	cp = NULL;
 
   out:
@@ -404,7 +498,7 @@ struct ip_vs_conn *ip_vs_ct_in_get(const struct ip_vs_conn_param *p)
  *	p->vaddr, p->vport: pkt dest address (foreign host) */
 struct ip_vs_conn *ip_vs_conn_out_get(const struct ip_vs_conn_param *p)
 {
-	unsigned int hash;
+	unsigned int hash, seq;
 	struct ip_vs_conn *cp, *ret=NULL;
 
 	/*
@@ -414,7 +508,9 @@ struct ip_vs_conn *ip_vs_conn_out_get(const struct ip_vs_conn_param *p)
 
 	rcu_read_lock();
 
-	hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
+again:
+	seq = raw_read_seqcount(&ip_vs_conn_tab_seq);
+	hlist_for_each_entry_rcu(cp, ip_vs_conn_bucket(hash), c_list) {
 		if (p->vport == cp->cport && p->cport == cp->dport &&
 		    cp->af == p->af &&
 		    ip_vs_addr_equal(p->af, p->vaddr, &cp->caddr) &&
@@ -429,6 +525,9 @@ struct ip_vs_conn *ip_vs_conn_out_get(const struct ip_vs_conn_param *p)
 		}
 	}
 
+	if (!ret && ip_vs_conn_tab_retry(seq))
+		goto again;
+
 	rcu_read_unlock();
 
 	IP_VS_DBG_BUF(9, "lookup/out %s %s:%d->%s:%d %s\n",
@@ -1001,6 +1100,7 @@ ip_vs_conn_new(const struct ip_vs_conn_param *p, int dest_af,
 #ifdef CONFIG_PROC_FS
 struct ip_vs_iter_state {
 	struct seq_net_private	p;
+	struct ip_vs_conn_tab	*tab;
 	struct hlist_head	*l;
 };
 
@@ -1009,14 +1109,16 @@ static void *ip_vs_conn_array(struct seq_file *seq, loff_t pos)
 	int idx;
 	struct ip_vs_conn *cp;
 	struct ip_vs_iter_state *iter = seq->private;
+	struct ip_vs_conn_tab *tab = rcu_dereference(ip_vs_conn_tab);
 
-	for (idx = 0; idx < ip_vs_conn_tab_size; idx++) {
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[idx], c_list) {
+	iter->tab = tab;
+	for (idx = 0; idx <= tab->mask; idx++) {
+		hlist_for_each_entry_rcu(cp, &tab->buckets[idx], c_list) {
 			/* __ip_vs_conn_get() is not needed by
 			 * ip_vs_conn_seq_show and ip_vs_conn_sync_seq_show
 			 */
 			if (pos-- == 0) {
-				iter->l = &ip_vs_conn_tab[idx];
+				iter->l = &tab->buckets[idx];
 				return cp;
 			}
 		}
@@ -1032,6 +1134,8 @@ static void *ip_vs_conn_seq_start(struct seq_file *seq, loff_t *pos)
 	struct ip_vs_iter_state *iter = seq->private;
 
 	iter->l = NULL;
+	/* keep the table, cond_resched_rcu() lets a resize free it */
+	mutex_lock(&ip_vs_conn_tab_mutex);
 	rcu_read_lock();
 	return *pos ? ip_vs_conn_array(seq, *pos - 1) :SEQ_START_TOKEN;
 }
@@ -1053,10 +1157,10 @@ static void *ip_vs_conn_seq_next(struct seq_file *seq, void *v, loff_t *pos)
 	if (e)
 		return hlist_entry(e, struct ip_vs_conn, c_list);
 
-	idx = l - ip_vs_conn_tab;
-	while (++idx < ip_vs_conn_tab_size) {
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[idx], c_list) {
-			iter->l = &ip_vs_conn_tab[idx];
+	idx = l - iter->tab->buckets;
+	while (++idx <= iter->tab->mask) {
+		hlist_for_each_entry_rcu(cp, &iter->tab->buckets[idx], c_list) {
+			iter->l = &iter->tab->buckets[idx];
 			return cp;
 		}
 		cond_resched_rcu();
@@ -1069,6 +1173,7 @@ static void ip_vs_conn_seq_stop(struct seq_file *seq, void *v)
 	__releases(RCU)
 {
 	rcu_read_unlock();
+	mutex_unlock(&ip_vs_conn_tab_mutex);
 }
 
 static int ip_vs_conn_seq_show(struct seq_file *seq, void *v)
@@ -1283,9 +1388,9 @@ void ip_vs_random_dropentry(struct netns_ipvs *ipvs)
 	 * Randomly scan 1/32 of the whole table every second
 	 */
 	for (idx = 0; idx < (ip_vs_conn_tab_size>>5); idx++) {
-		unsigned int hash = prandom_u32() & ip_vs_conn_tab_mask;
+		unsigned int hash = prandom_u32();
 
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
+		hlist_for_each_entry_rcu(cp, ip_vs_conn_bucket(hash), c_list) {
 			if (cp->ipvs != ipvs)
 				continue;
 			if (cp->flags & IP_VS_CONN_F_TEMPLATE) {
@@ -1351,12 +1456,15 @@ static void ip_vs_conn_flush(struct netns_ipvs *ipvs)
 {
 	int idx;
 	struct ip_vs_conn *cp, *cp_c;
+	struct ip_vs_conn_tab *tab;
 
 flush_again:
+	mutex_lock(&ip_vs_conn_tab_mutex);
 	rcu_read_lock();
-	for (idx = 0; idx < ip_vs_conn_tab_size; idx++) {
+	tab = rcu_dereference(ip_vs_conn_tab);
+	for (idx = 0; idx <= tab->mask; idx++) {
 
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[idx], c_list) {
+		hlist_for_each_entry_rcu(cp, &tab->buckets[idx], c_list) {
 			if (cp->ipvs != ipvs)
 				continue;
 			IP_VS_DBG(4, "del connection\n");
@@ -1372,6 +1480,7 @@ flush_again:
 		cond_resched_rcu();
 	}
 	rcu_read_unlock();
+	mutex_unlock(&ip_vs_conn_tab_mutex);
 
 	/* the counter may be not NULL, because maybe some conn entries
 	   are run by slow timer handler or unhashed but still referred */
@@ -1401,27 +1510,128 @@ void __net_exit ip_vs_conn_net_cleanup(struct netns_ipvs *ipvs)
 	remove_proc_entry("ip_vs_conn_sync", ipvs->net->proc_net);
 }
 
+static struct ip_vs_conn_tab *ip_vs_conn_tab_alloc(unsigned int bits)
+{
+	struct ip_vs_conn_tab *tab;
+	unsigned int idx;
+
+	tab = vmalloc(sizeof(*tab) + (sizeof(struct hlist_head) << bits));
+	if (!tab)
+		return NULL;
+
+	RCU_INIT_POINTER(tab->future, NULL);
+	bitmap_zero(tab->moved, CT_LOCKARRAY_SIZE);
+	tab->bits = bits;
+	tab->mask = (1U << bits) - 1;
+	for (idx = 0; idx <= tab->mask; idx++)
+		INIT_HLIST_HEAD(&tab->buckets[idx]);
+
+	return tab;
+}
+
+/*
+ *	Moves the connections to a table sized for their number, one lock
+ *	stripe at a time, so that the packet path only ever waits for the
+ *	buckets of a single stripe.
+ */
+static void ip_vs_conn_tab_resize(struct work_struct *work)
+{
+	struct ip_vs_conn_tab *old, *new;
+	struct ip_vs_conn *cp;
+	struct hlist_node *n;
+	unsigned int bits, idx, l;
+
+	bits = order_base_2(atomic_read(&ip_vs_conn_hashed));
+	bits = clamp_t(unsigned int, bits, ip_vs_conn_tab_bits,
+		       IP_VS_CONN_TAB_MAX_BITS);
+
+	mutex_lock(&ip_vs_conn_tab_mutex);
+	old = rcu_dereference_protected(ip_vs_conn_tab,
+				lockdep_is_held(&ip_vs_conn_tab_mutex));
+	if (old->bits == bits)
+		goto out;
+
+	new = ip_vs_conn_tab_alloc(bits);
+	if (!new)
+		goto out;
+
+	rcu_assign_pointer(old->future, new);
+	for (l = 0; l < CT_LOCKARRAY_SIZE; l++) {
+		ct_write_lock_bh(l);
+		for (idx = l; idx <= old->mask; idx += CT_LOCKARRAY_SIZE) {
+			if (hlist_empty(&old->buckets[idx]))
+				continue;
+
+			write_seqcount_begin(&ip_vs_conn_tab_seq);
+			hlist_for_each_entry_safe(cp, n, &old->buckets[idx],
+						  c_list) {
+				unsigned int hash = ip_vs_conn_hashkey_conn(cp);
+
+				hlist_del_rcu(&cp->c_list);
+				hlist_add_head_rcu(&cp->c_list,
+					&new->buckets[hash & new->mask]);
+			}
+			write_seqcount_end(&ip_vs_conn_tab_seq);
+		}
+		set_bit(l, old->moved);
+		ct_write_unlock_bh(l);
+		cond_resched();
+	}
+
+	rcu_assign_pointer(ip_vs_conn_tab, new);
+	WRITE_ONCE(ip_vs_conn_tab_size, 1 << bits);
+	ip_vs_conn_tab_resizes++;
+	mutex_unlock(&ip_vs_conn_tab_mutex);
+
+	IP_VS_DBG(2, "Connection hash table resized from %d to %d buckets\n",
+		  old->mask + 1, new->mask + 1);
+
+	synchronize_rcu();
+	vfree(old);
+	return;
+
+out:
+	mutex_unlock(&ip_vs_conn_tab_mutex);
+}
+
+#ifdef CONFIG_SYSCTL
+static struct ctl_table ip_vs_conn_vars[] = {
+	{
+		.procname	= "conn_tab_resizes",
+		.data		= &ip_vs_conn_tab_resizes,
+		.maxlen		= sizeof(unsigned long),
+		.mode		= 0444,
+		.proc_handler	= proc_doulongvec_minmax,
+	},
+	{ }
+};
+
+static struct ctl_table_header *ip_vs_conn_sysctl_hdr;
+#endif
+
 int __init ip_vs_conn_init(void)
 {
+	struct ip_vs_conn_tab *tab;
 	int idx;
 
-	/* Compute size and mask */
-	ip_vs_conn_tab_size = 1 << ip_vs_conn_tab_bits;
-	ip_vs_conn_tab_mask = ip_vs_conn_tab_size - 1;
+	ip_vs_conn_tab_bits = clamp(ip_vs_conn_tab_bits,
+				    IP_VS_CONN_TAB_MIN_BITS,
+				    IP_VS_CONN_TAB_MAX_BITS);
 
 	/*
 	 * Allocate the connection hash table and initialize its list heads
 	 */
-	ip_vs_conn_tab = vmalloc(ip_vs_conn_tab_size * sizeof(*ip_vs_conn_tab));
-	if (!ip_vs_conn_tab)
+	tab = ip_vs_conn_tab_alloc(ip_vs_conn_tab_bits);
+	if (!tab)
 		return -ENOMEM;
+	ip_vs_conn_tab_size = tab->mask + 1;
 
 	/* Allocate ip_vs_conn slab cache */
 	ip_vs_conn_cachep = kmem_cache_create("ip_vs_conn",
 					      sizeof(struct ip_vs_conn), 0,
 					      SLAB_HWCACHE_ALIGN, NULL);
 	if (!ip_vs_conn_cachep) {
-		vfree(ip_vs_conn_tab);
+		vfree(tab);
 		return -ENOMEM;
 	}
 
@@ -1432,9 +1642,6 @@ int __init ip_vs_conn_init(void)
 	IP_VS_DBG(0, "Each connection entry needs %Zd bytes at least\n",
 		  sizeof(struct ip_vs_conn));
 
-	for (idx = 0; idx < ip_vs_conn_tab_size; idx++)
-		INIT_HLIST_HEAD(&ip_vs_conn_tab[idx]);
-
 	for (idx = 0; idx < CT_LOCKARRAY_SIZE; idx++)  {
 		spin_lock_init(&__ip_vs_conntbl_lock_array[idx].l);
 	}
@@ -1442,14 +1649,25 @@ int __init ip_vs_conn_init(void)
 	/* calculate the random value for connection hash */
 	get_random_bytes(&ip_vs_conn_rnd, sizeof(ip_vs_conn_rnd));
 
+	RCU_INIT_POINTER(ip_vs_conn_tab, tab);
+
+#ifdef CONFIG_SYSCTL
+	ip_vs_conn_sysctl_hdr = register_net_sysctl(&init_net, "net/ipv4/vs",
+						    ip_vs_conn_vars);
+#endif
+
 	return 0;
 }
 
 void ip_vs_conn_cleanup(void)
 {
+#ifdef CONFIG_SYSCTL
+	unregister_net_sysctl_table(ip_vs_conn_sysctl_hdr);
+#endif
+	cancel_work_sync(&ip_vs_conn_tab_work);
 	/* Wait all ip_vs_conn_rcu_free() callbacks to complete */
 	rcu_barrier();
 	/* Release the empty cache */
 	kmem_cache_destroy(ip_vs_conn_cachep);
-	vfree(ip_vs_conn_tab);
+	vfree(rcu_dereference_protected(ip_vs_conn_tab, 1));
 }
@@ -14,6 +14,10 @@
  *              Affected data: est_list and est_lock.
  *              estimation_timer() runs with timer per netns.
  *              get_stats()) do the per cpu summing.
+ *
+ *              The per netns est_list, est_lock and estimation_timer()
+ *              have since been replaced by estimator chains shared by
+ *              all netns and walked from a delayed work, see below.
  */
 
 #define KMSG_COMPONENT "IPVS"
@@ -25,6 +29,9 @@
 #include <linux/interrupt.h>
 #include <linux/sysctl.h>
 #include <linux/list.h>
+#include <linux/hash.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
 
 #include <net/ip_vs.h>
 
@@ -34,8 +41,8 @@
   long interval, it is easy to implement a user level daemon which
   periodically reads those statistical counters and measure rate.
 
-  Currently, the measurement is activated by slow timer handler. Hope
-  this measurement will not introduce too much load.
+  The measurement is done from a delayed work. Hope this measurement
+  will not introduce too much load.
 
   We measure rate during the last 8 seconds every 2 seconds:
 
@@ -51,8 +58,39 @@
     to 32-bit values for conns, packets, bps, cps and pps.
 
   * A lot of code is taken from net/core/gen_estimator.c
+
+  * The estimators of all netns are spread over IP_VS_EST_CHAINS chains
+    and one work handles a chain per tick, so that no single run walks
+    all of them. Each chain is still visited every 2 seconds.
+
+  * A run does at most IP_VS_EST_BATCH estimators with the lock held. The
+    rest of a longer chain is left to the runs right after it, which
+    carry on from a cursor parked in the chain.
  */
 
+#define IP_VS_EST_CHAINS_BITS	3
+#define IP_VS_EST_CHAINS	(1 << IP_VS_EST_CHAINS_BITS)
+#define IP_VS_EST_BATCH		64
+
+static struct list_head ip_vs_est_chain[IP_VS_EST_CHAINS];
+static DEFINE_SPINLOCK(ip_vs_est_lock);
+static void ip_vs_est_work_handler(struct work_struct *work);
+static DECLARE_DELAYED_WORK(ip_vs_est_work, ip_vs_est_work_handler);
+static unsigned long ip_vs_est_start;	/* jiffies of the current cycle */
+static int ip_vs_est_next;		/* chain to do next */
+static int ip_vs_est_users;		/* netns, serialized by pernet ops */
+/* where the next run resumes in the current chain, if not at its start */
+static struct ip_vs_estimator ip_vs_est_cursor;
+
+/* Time spent in the estimator work, in microseconds */
+static unsigned long ip_vs_est_runtime;
+static unsigned long ip_vs_est_max_runtime;
+
+static inline int ip_vs_est_chain_of(struct ip_vs_estimator *est)
+{
+	return hash_ptr(est, IP_VS_EST_CHAINS_BITS);
+}
+
 
 /*
  * Make a summary from each cpu
@@ -97,15 +135,31 @@ static void ip_vs_read_cpu_stats(struct ip_vs_kstats *sum,
 }
 
 
-static void estimation_timer(unsigned long arg)
+/*
+ * Estimates up to IP_VS_EST_BATCH entries of a chain, from the cursor on
+ * if it was left in there. Returns false if entries are left, the cursor
+ * then sits in front of them.
+ */
+static bool estimation_chain(struct list_head *chain)
 {
 	struct ip_vs_estimator *e;
 	struct ip_vs_stats *s;
+	int n = 0;
 	u64 rate;
-	struct netns_ipvs *ipvs = (struct netns_ipvs *)arg;
 
-	spin_lock(&ipvs->est_lock);
-	list_for_each_entry(e, &ipvs->est_list, list) {
+	if (list_empty(&ip_vs_est_cursor.list)) {
+		e = list_first_entry(chain, struct ip_vs_estimator, list);
+	} else {
+		e = list_next_entry(&ip_vs_est_cursor, list);
+		list_del_init(&ip_vs_est_cursor.list);
+	}
+
+	list_for_each_entry_from(e, chain, list) {
+		if (n++ == IP_VS_EST_BATCH) {
+			list_add_tail(&ip_vs_est_cursor.list, &e->list);
+			return false;
+		}
+
 		s = container_of(e, struct ip_vs_stats, est);
 
 		spin_lock(&s->lock);
@@ -134,8 +188,47 @@ static void estimation_timer(unsigned long arg)
 		e->outbps += ((s64)rate - (s64)e->outbps) >> 2;
 		spin_unlock(&s->lock);
 	}
-	spin_unlock(&ipvs->est_lock);
-	mod_timer(&ipvs->est_timer, jiffies + 2*HZ);
+
+	return true;
+}
+
+/* Chain c is due at ip_vs_est_start + c * 2*HZ / IP_VS_EST_CHAINS */
+static void ip_vs_est_schedule(void)
+{
+	unsigned long due;
+
+	due = ip_vs_est_start + ip_vs_est_next * 2*HZ / IP_VS_EST_CHAINS;
+	schedule_delayed_work(&ip_vs_est_work,
+			      time_after(due, jiffies) ? due - jiffies : 0);
+}
+
+static void ip_vs_est_work_handler(struct work_struct *work)
+{
+	unsigned long us;
+	ktime_t start;
+	bool done;
+
+	start = ktime_get();
+	spin_lock_bh(&ip_vs_est_lock);
+	done = estimation_chain(&ip_vs_est_chain[ip_vs_est_next]);
+	spin_unlock_bh(&ip_vs_est_lock);
+	us = ktime_us_delta(ktime_get(), start);
+
+	ip_vs_est_runtime += us;
+	if (us > ip_vs_est_max_runtime)
+		ip_vs_est_max_runtime = us;
+
+	/* the rest of the chain right away, others get to run in between */
+	if (!done) {
+		schedule_delayed_work(&ip_vs_est_work, 0);
+		return;
+	}
+
+	if (++ip_vs_est_next == IP_VS_EST_CHAINS) {
+		ip_vs_est_next = 0;
+		ip_vs_est_start += 2*HZ;
+	}
+	ip_vs_est_schedule();
 }
 
 void ip_vs_start_estimator(struct netns_ipvs *ipvs, struct ip_vs_stats *stats)
@@ -144,18 +237,18 @@ void ip_vs_start_estimator(struct netns_ipvs *ipvs, struct ip_vs_stats *stats)
 
 	INIT_LIST_HEAD(&est->list);
 
-	spin_lock_bh(&ipvs->est_lock);
-	list_add(&est->list, &ipvs->est_list);
-	spin_unlock_bh(&ipvs->est_lock);
+	spin_lock_bh(&ip_vs_est_lock);
+	list_add(&est->list, &ip_vs_est_chain[ip_vs_est_chain_of(est)]);
+	spin_unlock_bh(&ip_vs_est_lock);
 }
 
 void ip_vs_stop_estimator(struct netns_ipvs *ipvs, struct ip_vs_stats *stats)
 {
 	struct ip_vs_estimator *est = &stats->est;
 
-	spin_lock_bh(&ipvs->est_lock);
+	spin_lock_bh(&ip_vs_est_lock);
 	list_del(&est->list);
-	spin_unlock_bh(&ipvs->est_lock);
+	spin_unlock_bh(&ip_vs_est_lock);
 }
 
 void ip_vs_zero_estimator(struct ip_vs_stats *stats)
@@ -188,16 +281,55 @@ void ip_vs_read_estimator(struct ip_vs_kstats *dst, struct ip_vs_stats *stats)
 	dst->outbps = (e->outbps + 0xF) >> 5;
 }
 
+#ifdef CONFIG_SYSCTL
+static struct ctl_table ip_vs_est_vars[] = {
+	{
+		.procname	= "est_runtime_us",
+		.data		= &ip_vs_est_runtime,
+		.maxlen		= sizeof(unsigned long),
+		.mode		= 0444,
+		.proc_handler	= proc_doulongvec_minmax,
+	},
+	{
+		.procname	= "est_max_runtime_us",
+		.data		= &ip_vs_est_max_runtime,
+		.maxlen		= sizeof(unsigned long),
+		.mode		= 0444,
+		.proc_handler	= proc_doulongvec_minmax,
+	},
+	{ }
+};
+
+static struct ctl_table_header *ip_vs_est_sysctl_hdr;
+#endif
+
 int __net_init ip_vs_estimator_net_init(struct netns_ipvs *ipvs)
 {
-	INIT_LIST_HEAD(&ipvs->est_list);
-	spin_lock_init(&ipvs->est_lock);
-	setup_timer(&ipvs->est_timer, estimation_timer, (unsigned long)ipvs);
-	mod_timer(&ipvs->est_timer, jiffies + 2 * HZ);
+	int i;
+
+	if (ip_vs_est_users++)
+		return 0;
+
+	for (i = 0; i < IP_VS_EST_CHAINS; i++)
+		INIT_LIST_HEAD(&ip_vs_est_chain[i]);
+	INIT_LIST_HEAD(&ip_vs_est_cursor.list);
+#ifdef CONFIG_SYSCTL
+	ip_vs_est_sysctl_hdr = register_net_sysctl(&init_net, "net/ipv4/vs",
+						   ip_vs_est_vars);
+#endif
+	ip_vs_est_next = 0;
+	ip_vs_est_start = jiffies + 2*HZ;
+	ip_vs_est_schedule();
 	return 0;
 }
 
 void __net_exit ip_vs_estimator_net_cleanup(struct netns_ipvs *ipvs)
 {
-	del_timer_sync(&ipvs->est_timer);
+	if (--ip_vs_est_users)
+		return;
+
+	cancel_delayed_work_sync(&ip_vs_est_work);
+#ifdef CONFIG_SYSCTL
+	unregister_net_sysctl_table(ip_vs_est_sysctl_hdr);
+#endif
 }
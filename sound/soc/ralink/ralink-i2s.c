@@ -20,6 +20,8 @@
 #include <linux/reset.h>
 #include <linux/debugfs.h>
 #include <linux/of_device.h>
+#include <linux/log2.h>
+#include <linux/dma/ralink-gdma.h>
 #include <sound/pcm_params.h>
 #include <sound/dmaengine_pcm.h>
 
@@ -46,10 +48,11 @@
 #define I2S_REG_CFG0_SLAVE	BIT(16)
 #define I2S_REG_CFG0_RX_THRES	12
 #define I2S_REG_CFG0_TX_THRES	4
-#define I2S_REG_CFG0_THRES_MASK	(0xf << I2S_REG_CFG0_RX_THRES) | \
-	(4 << I2S_REG_CFG0_TX_THRES)
-#define I2S_REG_CFG0_DFT_THRES	(4 << I2S_REG_CFG0_RX_THRES) | \
-	(4 << I2S_REG_CFG0_TX_THRES)
+#define I2S_REG_CFG0_THRES_MAX	0xf
+#define I2S_REG_CFG0_THRES_MASK	((0xf << I2S_REG_CFG0_RX_THRES) | \
+	(0xf << I2S_REG_CFG0_TX_THRES))
+#define I2S_REG_CFG0_DFT_THRES	((4 << I2S_REG_CFG0_RX_THRES) | \
+	(4 << I2S_REG_CFG0_TX_THRES))
 /* RT305x */
 #define I2S_REG_CFG0_CLK_DIS	BIT(8)
 #define I2S_REG_CFG0_TXCH_SWAP	BIT(3)
@@ -107,6 +110,10 @@
 
 /* FIFO */
 #define RALINK_I2S_FIFO_SIZE	32
+/* smallest FIFO depth of all variants, in words */
+#define RALINK_I2S_FIFO_WORDS	16
+/* largest DMA burst in words */
+#define RALINK_I2S_BURST_MAX	8
 
 /* feature flags */
 #define RALINK_FLAGS_TXONLY	BIT(0)
@@ -115,13 +122,27 @@
 #define RALINK_FLAGS_ENDIAN	BIT(3)
 #define RALINK_FLAGS_24BIT	BIT(4)
 
-#define RALINK_I2S_INT_EN	0
+/* fifo under/overrun interrupts, used to raise the thresholds */
+static bool fifo_adapt;
+module_param(fifo_adapt, bool, 0444);
+MODULE_PARM_DESC(fifo_adapt, "raise fifo thresholds on under/overrun");
+
+#define I2S_REG_INT_ERR_MASK	(I2S_REG_INT_RX_FAULT | I2S_REG_INT_RX_OVRUN | \
+	I2S_REG_INT_RX_UNRUN | I2S_REG_INT_TX_FAULT | I2S_REG_INT_TX_OVRUN | \
+	I2S_REG_INT_TX_UNRUN)
 
 struct ralink_i2s_stats {
 	u32 dmafault;
 	u32 overrun;
 	u32 underrun;
 	u32 belowthres;
+
+	/* fifo threshold and dma burst in words */
+	u32 thres;
+	u32 burst;
+
+	/* the gdma channel last started, it times the periods */
+	struct dma_chan *chan;
 };
 
 struct ralink_i2s {
@@ -133,6 +154,8 @@ struct ralink_i2s {
 	unsigned int fmt;
 	u16 txdma_req;
 	u16 rxdma_req;
+	u32 tx_thres;
+	u32 rx_thres;
 
 	struct snd_dmaengine_dai_dma_data playback_dma_data;
 	struct snd_dmaengine_dai_dma_data capture_dma_data;
@@ -305,18 +328,16 @@ static int ralink_i2s_startup(struct snd_pcm_substream *substream,
 		return 0;
 
 	/* setup status interrupt */
-#if (RALINK_I2S_INT_EN)
-	regmap_write(i2s->regmap, I2S_REG_INT_EN, 0xff);
-#else
-	regmap_write(i2s->regmap, I2S_REG_INT_EN, 0x0);
-#endif
+	regmap_write(i2s->regmap, I2S_REG_INT_EN,
+			fifo_adapt ? I2S_REG_INT_ERR_MASK : 0);
 
 	/* enable */
 	regmap_update_bits(i2s->regmap, I2S_REG_CFG0,
 			I2S_REG_CFG0_EN | I2S_REG_CFG0_DMA_EN |
 			I2S_REG_CFG0_THRES_MASK,
 			I2S_REG_CFG0_EN | I2S_REG_CFG0_DMA_EN |
-			I2S_REG_CFG0_DFT_THRES);
+			(i2s->rx_thres << I2S_REG_CFG0_RX_THRES) |
+			(i2s->tx_thres << I2S_REG_CFG0_TX_THRES));
 
 	return 0;
 }
@@ -337,6 +358,47 @@ static void ralink_i2s_shutdown(struct snd_pcm_substream *substream,
 	regmap_update_bits(i2s->regmap, I2S_REG_CFG0, I2S_REG_CFG0_EN, 0);
 }
 
+/*
+ * The dma request is raised when the tx fifo drains to the threshold or
+ * the rx fifo fills up to it, so a burst must fit in what is left of the
+ * fifo at that point. It also has to divide the period, otherwise the
+ * last burst of every period runs past the segment.
+ */
+static void ralink_i2s_set_fifo(struct ralink_i2s *i2s, int stream,
+		unsigned int period_bytes)
+{
+	struct snd_dmaengine_dai_dma_data *dma_data;
+	struct ralink_i2s_stats *stats;
+	unsigned int words = period_bytes / 4;
+	u32 limit, burst, shift;
+
+	if (stream == SNDRV_PCM_STREAM_PLAYBACK) {
+		dma_data = &i2s->playback_dma_data;
+		stats = &i2s->txstats;
+		stats->thres = i2s->tx_thres;
+		limit = RALINK_I2S_FIFO_WORDS - stats->thres;
+		shift = I2S_REG_CFG0_TX_THRES;
+	} else {
+		dma_data = &i2s->capture_dma_data;
+		stats = &i2s->rxstats;
+		stats->thres = i2s->rx_thres;
+		limit = stats->thres;
+		shift = I2S_REG_CFG0_RX_THRES;
+	}
+
+	burst = min_t(u32, rounddown_pow_of_two(limit), RALINK_I2S_BURST_MAX);
+	while (burst > 1 && (words % burst))
+		burst >>= 1;
+
+	stats->burst = burst;
+	dma_data->maxburst = burst;
+	regmap_update_bits(i2s->regmap, I2S_REG_CFG0,
+			I2S_REG_CFG0_THRES_MAX << shift, stats->thres << shift);
+
+	dev_dbg(i2s->dev, "period %u bytes, fifo threshold %u, burst %u\n",
+			period_bytes, stats->thres, burst);
+}
+
 static int ralink_i2s_hw_params(struct snd_pcm_substream *substream,
 		struct snd_pcm_hw_params *params, struct snd_soc_dai *dai)
 {
@@ -399,6 +461,9 @@ static int ralink_i2s_hw_params(struct snd_pcm_substream *substream,
 		}
 	}
 
+	ralink_i2s_set_fifo(i2s, substream->stream,
+			params_period_bytes(params));
+
 	/* setup bclk rate */
 	if (i2s->flags & RALINK_FLAGS_TXONLY)
 		ret = ralink_i2s_set_sys_bclk(dai, width, params_rate(params));
@@ -412,15 +477,21 @@ static int ralink_i2s_trigger(struct snd_pcm_substream *substream, int cmd,
 		struct snd_soc_dai *dai)
 {
 	struct ralink_i2s *i2s = snd_soc_dai_get_drvdata(dai);
+	struct ralink_i2s_stats *stats;
 	unsigned int mask, val;
 
-	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
 		mask = I2S_REG_CFG0_TX_EN;
-	else
+		stats = &i2s->txstats;
+	} else {
 		mask = I2S_REG_CFG0_RX_EN;
+		stats = &i2s->rxstats;
+	}
 
 	switch (cmd) {
 	case SNDRV_PCM_TRIGGER_START:
+		stats->chan = snd_dmaengine_pcm_get_chan(substream);
+		/* fall through */
 	case SNDRV_PCM_TRIGGER_RESUME:
 	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
 		val = mask;
@@ -520,11 +591,12 @@ static struct snd_pcm_hardware ralink_pcm_hardware = {
 	.formats = SNDRV_PCM_FMTBIT_S16_LE,
 	.channels_min		= 2,
 	.channels_max		= 2,
-	.period_bytes_min	= PAGE_SIZE,
-	.period_bytes_max	= PAGE_SIZE * 2,
+	/* short periods for low latency, long ones to coalesce interrupts */
+	.period_bytes_min	= 256,
+	.period_bytes_max	= 32 * 1024,
 	.periods_min		= 2,
-	.periods_max		= 128,
-	.buffer_bytes_max	= 128 * 1024,
+	.periods_max		= 1024,
+	.buffer_bytes_max	= 256 * PAGE_SIZE,
 	.fifo_size		= RALINK_I2S_FIFO_SIZE,
 };
 
@@ -573,7 +645,36 @@ static const struct regmap_config ralink_i2s_regmap_config = {
 	.max_register = I2S_REG_DIVINT,
 };
 
-#if (RALINK_I2S_INT_EN)
+/*
+ * A tx underrun means the dma was late refilling the fifo, so request
+ * earlier by raising the tx threshold. An rx overrun means the fifo
+ * filled before being drained, so request earlier by lowering the rx one.
+ * The burst set up in hw_params must still fit.
+ */
+static void ralink_i2s_adapt(struct ralink_i2s *i2s, u32 status)
+{
+	struct ralink_i2s_stats *stats;
+
+	stats = &i2s->txstats;
+	if ((status & I2S_REG_INT_TX_UNRUN) && stats->burst &&
+			stats->thres < I2S_REG_CFG0_THRES_MAX &&
+			stats->thres + stats->burst < RALINK_I2S_FIFO_WORDS) {
+		stats->thres++;
+		regmap_update_bits(i2s->regmap, I2S_REG_CFG0,
+				I2S_REG_CFG0_THRES_MAX << I2S_REG_CFG0_TX_THRES,
+				stats->thres << I2S_REG_CFG0_TX_THRES);
+	}
+
+	stats = &i2s->rxstats;
+	if ((status & I2S_REG_INT_RX_OVRUN) && stats->burst &&
+			stats->thres > stats->burst) {
+		stats->thres--;
+		regmap_update_bits(i2s->regmap, I2S_REG_CFG0,
+				I2S_REG_CFG0_THRES_MAX << I2S_REG_CFG0_RX_THRES,
+				stats->thres << I2S_REG_CFG0_RX_THRES);
+	}
+}
+
 static irqreturn_t ralink_i2s_irq(int irq, void *devid)
 {
 	struct ralink_i2s *i2s = devid;
@@ -607,14 +708,24 @@ static irqreturn_t ralink_i2s_irq(int irq, void *devid)
 			i2s->rxstats.dmafault++;
 	}
 
+	ralink_i2s_adapt(i2s, status);
+
 	/* clean status bits */
 	regmap_write(i2s->regmap, I2S_REG_INT_STATUS, status);
 
 	return IRQ_HANDLED;
 }
-#endif
 
 #if IS_ENABLED(CONFIG_DEBUG_FS)
+static void ralink_i2s_fifo_show(struct seq_file *s,
+		struct ralink_i2s_stats *stats)
+{
+	seq_printf(s, "\tfifo threshold\t%u\n", stats->thres);
+	seq_printf(s, "\tdma burst\t%u\n", stats->burst);
+	if (stats->chan)
+		gdma_dma_jitter_show(s, stats->chan);
+}
+
 static int ralink_i2s_stats_show(struct seq_file *s, void *unused)
 {
         struct ralink_i2s *i2s = s->private;
@@ -624,12 +735,14 @@ static int ralink_i2s_stats_show(struct seq_file *s, void *unused)
 	seq_printf(s, "\tunder run\t%u\n", i2s->txstats.underrun);
 	seq_printf(s, "\tover run\t%u\n", i2s->txstats.overrun);
 	seq_printf(s, "\tdma fault\t%u\n", i2s->txstats.dmafault);
+	ralink_i2s_fifo_show(s, &i2s->txstats);
 
 	seq_printf(s, "rx stats\n");
 	seq_printf(s, "\tbelow threshold\t%u\n", i2s->rxstats.belowthres);
 	seq_printf(s, "\tunder run\t%u\n", i2s->rxstats.underrun);
 	seq_printf(s, "\tover run\t%u\n", i2s->rxstats.overrun);
 	seq_printf(s, "\tdma fault\t%u\n", i2s->rxstats.dmafault);
+	ralink_i2s_fifo_show(s, &i2s->rxstats);
 
 	ralink_i2s_dump_regs(i2s);
 
@@ -675,7 +788,7 @@ static inline int ralink_i2s_debugfs_create(struct ralink_i2s *i2s)
 	return 0;
 }
 
-static inline void ralink_i2s_debugfs_remove(struct fsl_ssi_dbg *ssi_dbg)
+static inline void ralink_i2s_debugfs_remove(struct ralink_i2s *i2s)
 {
 }
 #endif
@@ -842,6 +955,17 @@ static int ralink_i2s_probe(struct platform_device *pdev)
 		i2s->rxdma_req = (u16)dma_req;
 	}
 
+	/* fifo thresholds in words, the dma burst is derived from them */
+	if (of_property_read_u32(np, "ralink,tx-threshold", &i2s->tx_thres))
+		i2s->tx_thres = 4;
+	if (of_property_read_u32(np, "ralink,rx-threshold", &i2s->rx_thres))
+		i2s->rx_thres = 4;
+	if (!i2s->tx_thres || i2s->tx_thres > I2S_REG_CFG0_THRES_MAX ||
+			!i2s->rx_thres || i2s->rx_thres > I2S_REG_CFG0_THRES_MAX) {
+		dev_err(&pdev->dev, "invalid fifo threshold\n");
+		return -EINVAL;
+	}
+
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	i2s->regs = devm_ioremap_resource(&pdev->dev, res);
 	if (IS_ERR(i2s->regs))
@@ -860,14 +984,14 @@ static int ralink_i2s_probe(struct platform_device *pdev)
                 return -EINVAL;
         }
 
-#if (RALINK_I2S_INT_EN)
-	ret = devm_request_irq(&pdev->dev, irq, ralink_i2s_irq,
-			0, dev_name(&pdev->dev), i2s);
-	if (ret) {
-		dev_err(&pdev->dev, "failed to request irq\n");
-		return ret;
+	if (fifo_adapt) {
+		ret = devm_request_irq(&pdev->dev, irq, ralink_i2s_irq,
+				0, dev_name(&pdev->dev), i2s);
+		if (ret) {
+			dev_err(&pdev->dev, "failed to request irq\n");
+			return ret;
+		}
 	}
-#endif
 
 	i2s->clk = devm_clk_get(&pdev->dev, NULL);
 	if (IS_ERR(i2s->clk)) {
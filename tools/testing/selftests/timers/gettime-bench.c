@@ -0,0 +1,114 @@
+/* clock_gettime vdso vs. syscall benchmark
+ *
+ *  Compares the rate of clock_gettime() through libc, which uses the
+ *  vdso when the current clocksource allows it, with the rate of the
+ *  raw system call. The difference is the number of syscalls per second
+ *  the vdso saves a caller that reads the clock in a loop.
+ *
+ *  To build:
+ *	$ gcc gettime-bench.c -o gettime-bench -lrt
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#ifdef KTEST
+#include "../kselftest.h"
+#else
+static inline int ksft_exit_pass(void)
+{
+	exit(0);
+}
+static inline int ksft_exit_fail(void)
+{
+	exit(1);
+}
+#endif
+
+#define NSEC_PER_SEC	1000000000ULL
+#define RUNTIME_NS	(2 * NSEC_PER_SEC)
+#define CALLS_PER_LOOP	64
+
+static unsigned long long ts_ns(struct timespec *ts)
+{
+	return ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static int vdso_gettime(clockid_t clk, struct timespec *ts)
+{
+	return clock_gettime(clk, ts);
+}
+
+static int sys_gettime(clockid_t clk, struct timespec *ts)
+{
+	return syscall(SYS_clock_gettime, clk, ts);
+}
+
+/* calls per second of @gettime on @clk over RUNTIME_NS */
+static double bench(int (*gettime)(clockid_t, struct timespec *),
+		    clockid_t clk)
+{
+	struct timespec start, now, ts;
+	unsigned long long calls = 0, elapsed;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		for (i = 0; i < CALLS_PER_LOOP; i++)
+			if (gettime(clk, &ts))
+				return -1;
+		calls += CALLS_PER_LOOP;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed = ts_ns(&now) - ts_ns(&start);
+	} while (elapsed < RUNTIME_NS);
+
+	return calls * (double)NSEC_PER_SEC / elapsed;
+}
+
+int main(int argc, char **argv)
+{
+	static const struct {
+		clockid_t id;
+		const char *name;
+	} clocks[] = {
+		{ CLOCK_REALTIME, "CLOCK_REALTIME" },
+		{ CLOCK_MONOTONIC, "CLOCK_MONOTONIC" },
+	};
+	double vdso, sys;
+	int i;
+
+	for (i = 0; i < sizeof(clocks) / sizeof(clocks[0]); i++) {
+		vdso = bench(vdso_gettime, clocks[i].id);
+		sys = bench(sys_gettime, clocks[i].id);
+		if (vdso < 0 || sys < 0) {
+			printf("%s: clock_gettime failed\n", clocks[i].name);
+			return ksft_exit_fail();
+		}
+
+		/*
+		 * Without a vdso fast path libc ends up in the syscall as
+		 * well and both rates are about the same.
+		 */
+		printf("%-16s libc %10.0f/s  syscall %10.0f/s  (%.1fx)  %s\n",
+		       clocks[i].name, vdso, sys, vdso / sys,
+		       vdso > 2 * sys ? "vdso" : "no vdso");
+		if (vdso > 2 * sys)
+			printf("%-16s %.0f syscalls/s saved\n",
+			       clocks[i].name, vdso);
+	}
+
+	return ksft_exit_pass();
+}